@@ -0,0 +1,168 @@
+/*
+ * Copyright 2025 wtcat
+ */
+
+#include "base/memory/memory_resource.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "base/check_op.h"
+
+namespace base {
+
+namespace {
+
+constexpr size_t kMinChunkSize = 256;
+
+inline char* AlignUp(char* p, size_t alignment) {
+  uintptr_t v = reinterpret_cast<uintptr_t>(p);
+  return reinterpret_cast<char*>((v + alignment - 1) & ~(alignment - 1));
+}
+
+}  // namespace
+
+// ArenaResource
+
+ArenaResource::ArenaResource(void* buffer,
+                             size_t size,
+                             std::pmr::memory_resource* upstream)
+    : buffer_(static_cast<char*>(buffer)),
+      size_(size),
+      upstream_(upstream),
+      current_(buffer_),
+      end_(buffer_ + size),
+      next_chunk_size_(std::max(size, kMinChunkSize)) {}
+
+ArenaResource::~ArenaResource() {
+  Reset();
+}
+
+void ArenaResource::Reset() {
+  while (chunks_) {
+    Chunk* chunk = chunks_;
+    chunks_ = chunk->next;
+    upstream_->deallocate(chunk, chunk->size, alignof(std::max_align_t));
+  }
+  current_ = buffer_;
+  end_ = buffer_ + size_;
+  next_chunk_size_ = std::max(size_, kMinChunkSize);
+  used_ = 0;
+}
+
+void* ArenaResource::do_allocate(size_t bytes, size_t alignment) {
+  char* p = AlignUp(current_, alignment);
+
+  if (p < end_ && static_cast<size_t>(end_ - p) >= bytes) {
+    current_ = p + bytes;
+    used_ += bytes;
+    peak_ = std::max(peak_, used_);
+    return p;
+  }
+  return AllocateFromUpstream(bytes, alignment);
+}
+
+void* ArenaResource::AllocateFromUpstream(size_t bytes, size_t alignment) {
+  if (!upstream_)
+    return nullptr;
+
+  size_t size = std::max(next_chunk_size_, sizeof(Chunk) + alignment + bytes);
+  void* mem = upstream_->allocate(size, alignof(std::max_align_t));
+  if (!mem)
+    return nullptr;
+
+  Chunk* chunk = static_cast<Chunk*>(mem);
+  chunk->next = chunks_;
+  chunk->size = size;
+  chunks_ = chunk;
+  next_chunk_size_ = size * 2;
+
+  char* p = AlignUp(reinterpret_cast<char*>(chunk + 1), alignment);
+  current_ = p + bytes;
+  end_ = static_cast<char*>(mem) + size;
+  used_ += bytes;
+  peak_ = std::max(peak_, used_);
+  return p;
+}
+
+// ObjectPoolResource
+
+ObjectPoolResource::ObjectPoolResource(void* buffer,
+                                       size_t size,
+                                       size_t block_size,
+                                       std::pmr::memory_resource* upstream)
+    : begin_(static_cast<char*>(buffer)),
+      end_(begin_ + size / rte_roundup(block_size, sizeof(void*)) *
+                        rte_roundup(block_size, sizeof(void*))),
+      block_size_(rte_roundup(block_size, sizeof(void*))),
+      upstream_(upstream) {
+  uintptr_t bits = reinterpret_cast<uintptr_t>(buffer) | block_size_;
+
+  // Every block is aligned to the lowest bit set in base address and size
+  block_align_ = bits & ~(bits - 1);
+  object_pool_initialize(&pool_, buffer, size, block_size_);
+}
+
+void* ObjectPoolResource::do_allocate(size_t bytes, size_t alignment) {
+  if (bytes <= block_size_ && alignment <= block_align_) {
+    void* p = object_allocate(&pool_);
+    if (p)
+      return p;
+  }
+  return upstream_ ? upstream_->allocate(bytes, alignment) : nullptr;
+}
+
+void ObjectPoolResource::do_deallocate(void* p,
+                                       size_t bytes,
+                                       size_t alignment) {
+  char* cp = static_cast<char*>(p);
+
+  if (cp >= begin_ && cp < end_) {
+    object_free(&pool_, p);
+    return;
+  }
+  CHECK_EQ(upstream_ != nullptr, true);
+  upstream_->deallocate(p, bytes, alignment);
+}
+
+#ifdef CONFIG_KMALLOC
+// KmallocResource
+
+namespace {
+
+// kmalloc() only guarantees pointer alignment
+constexpr size_t kKmallocAlign = sizeof(void*);
+
+KmallocResource g_kmalloc_resource;
+
+}  // namespace
+
+KmallocResource* KmallocResource::Get() {
+  return &g_kmalloc_resource;
+}
+
+void* KmallocResource::do_allocate(size_t bytes, size_t alignment) {
+  if (alignment <= kKmallocAlign)
+    return kmalloc(bytes, GMF_KERNEL);
+
+  // Over-allocate and keep the original pointer just below the aligned one
+  char* raw = static_cast<char*>(
+      kmalloc(bytes + alignment + sizeof(void*), GMF_KERNEL));
+  if (!raw)
+    return nullptr;
+
+  char* p = AlignUp(raw + sizeof(void*), alignment);
+  reinterpret_cast<char**>(p)[-1] = raw;
+  return p;
+}
+
+void KmallocResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  if (alignment <= kKmallocAlign) {
+    kfree(p);
+    return;
+  }
+  kfree(reinterpret_cast<char**>(p)[-1]);
+}
+#endif  // CONFIG_KMALLOC
+
+}  // namespace base
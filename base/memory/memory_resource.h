@@ -0,0 +1,149 @@
+/*
+ * Copyright 2025 wtcat
+ */
+#ifndef BASE_MEMORY_MEMORY_RESOURCE_H_
+#define BASE_MEMORY_MEMORY_RESOURCE_H_
+
+#include <cstddef>
+#include <memory_resource>
+
+#include "tx_api.h"
+
+#include "base/base_export.h"
+
+// std::pmr::memory_resource implementations backed by the board memory
+// primitives. The tree is built with -fno-exceptions, so every resource
+// returns nullptr instead of throwing std::bad_alloc when it runs out of
+// memory and has no upstream resource.
+//
+//   static char buffer[4096];
+//   base::ArenaResource arena(buffer, sizeof(buffer));
+//   {
+//     base::ScopedArena scope(&arena);
+//     std::pmr::vector<int> v(&arena);
+//     ...
+//   }  // Everything allocated from |arena| is released here.
+
+namespace base {
+
+// Bump-pointer arena over a caller provided buffer. Deallocation is a no-op,
+// memory is only reclaimed by Reset(). When the buffer is exhausted, chunks
+// are taken from |upstream| (if any) and given back on Reset().
+class BASE_EXPORT ArenaResource : public std::pmr::memory_resource {
+ public:
+  ArenaResource(void* buffer,
+                size_t size,
+                std::pmr::memory_resource* upstream = nullptr);
+  ArenaResource(const ArenaResource&) = delete;
+  ArenaResource& operator=(const ArenaResource&) = delete;
+  ~ArenaResource() override;
+
+  // Release all allocations at once.
+  void Reset();
+
+  size_t used() const { return used_; }
+  size_t peak() const { return peak_; }
+  size_t capacity() const { return size_; }
+
+ private:
+  struct Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  void* AllocateFromUpstream(size_t bytes, size_t alignment);
+
+  char* const buffer_;
+  const size_t size_;
+  std::pmr::memory_resource* const upstream_;
+  char* current_;
+  char* end_;
+  Chunk* chunks_ = nullptr;
+  size_t next_chunk_size_;
+  size_t used_ = 0;
+  size_t peak_ = 0;
+};
+
+// Arena with an inline buffer of |N| bytes.
+template <size_t N>
+class InlineArena : public ArenaResource {
+ public:
+  explicit InlineArena(std::pmr::memory_resource* upstream = nullptr)
+      : ArenaResource(storage_, N, upstream) {}
+
+ private:
+  alignas(std::max_align_t) char storage_[N];
+};
+
+// Resets an arena when it goes out of scope, so that all allocations made
+// while serving one request are freed together.
+class ScopedArena {
+ public:
+  explicit ScopedArena(ArenaResource* arena) : arena_(arena) {}
+  ScopedArena(const ScopedArena&) = delete;
+  ScopedArena& operator=(const ScopedArena&) = delete;
+  ~ScopedArena() { arena_->Reset(); }
+
+  ArenaResource* arena() const { return arena_; }
+
+ private:
+  ArenaResource* const arena_;
+};
+
+// Fixed size blocks from an object_pool. Requests that do not fit a block
+// go to |upstream| (if any).
+class BASE_EXPORT ObjectPoolResource : public std::pmr::memory_resource {
+ public:
+  ObjectPoolResource(void* buffer,
+                     size_t size,
+                     size_t block_size,
+                     std::pmr::memory_resource* upstream = nullptr);
+  ObjectPoolResource(const ObjectPoolResource&) = delete;
+  ObjectPoolResource& operator=(const ObjectPoolResource&) = delete;
+  ~ObjectPoolResource() override = default;
+
+  size_t block_size() const { return block_size_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  struct object_pool pool_;
+  char* const begin_;
+  char* const end_;
+  const size_t block_size_;
+  size_t block_align_;
+  std::pmr::memory_resource* const upstream_;
+};
+
+#ifdef CONFIG_KMALLOC
+// Memory from kmalloc(), small requests are served by the kmalloc slab.
+// Stateless, use KmallocResource::Get() to obtain the shared instance.
+class BASE_EXPORT KmallocResource : public std::pmr::memory_resource {
+ public:
+  static KmallocResource* Get();
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+#endif  // CONFIG_KMALLOC
+
+}  // namespace base
+
+#endif  // BASE_MEMORY_MEMORY_RESOURCE_H_
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2025 wtcat
+ */
+
+#include "base/task/coroutine.h"
+
+#include <errno.h>
+#include <new>
+
+#include "basework/assert.h"
+#include "base/memory/memory_resource.h"
+
+namespace base {
+
+namespace {
+
+alignas(std::max_align_t) char g_frame_buffer[CONFIG_COROUTINE_FRAMES *
+                                              CONFIG_COROUTINE_FRAME_SIZE];
+alignas(ObjectPoolResource) char g_pool_storage[sizeof(ObjectPoolResource)];
+std::pmr::memory_resource* g_frame_resource;
+
+#ifndef TX_DISABLE_NOTIFY_CALLBACKS
+// Coroutines waiting for a semaphore, protected by TX_DISABLE
+LinkedList<SemaphoreAwaiter> g_semaphore_waiters;
+#endif
+
+// Built on first use, frames may be allocated before static constructors
+// of other translation units have run.
+std::pmr::memory_resource* CreateDefaultResource() {
+  std::pmr::memory_resource* upstream = nullptr;
+#ifdef CONFIG_KMALLOC
+  upstream = KmallocResource::Get();
+#endif
+  return new (g_pool_storage)
+      ObjectPoolResource(g_frame_buffer, sizeof(g_frame_buffer),
+                         CONFIG_COROUTINE_FRAME_SIZE, upstream);
+}
+
+}  // namespace
+
+std::pmr::memory_resource* GetCoroutineFrameResource() {
+  TX_INTERRUPT_SAVE_AREA
+
+  TX_DISABLE
+  if (!g_frame_resource)
+    g_frame_resource = CreateDefaultResource();
+  TX_RESTORE
+  return g_frame_resource;
+}
+
+void SetCoroutineFrameResource(std::pmr::memory_resource* resource) {
+  g_frame_resource = resource;
+}
+
+namespace internal {
+
+void* PromiseBase::operator new(size_t size) noexcept {
+  void* p =
+      GetCoroutineFrameResource()->allocate(size, alignof(std::max_align_t));
+
+  // memory_resource::allocate() is declared returns_nonnull, hide the result
+  // from the optimizer so that an exhausted pool still ends up in
+  // get_return_object_on_allocation_failure()
+  __asm__ volatile("" : "+r"(p));
+  return p;
+}
+
+void PromiseBase::operator delete(void* p, size_t size) noexcept {
+  GetCoroutineFrameResource()->deallocate(p, size, alignof(std::max_align_t));
+}
+
+void PromiseBase::unhandled_exception() noexcept {
+  // Built with -fno-exceptions, never reached
+  rte_assert(0);
+}
+
+}  // namespace internal
+
+int Spawn(struct task_runner* runner, Task<void> task) {
+  if (runner == nullptr)
+    return -EINVAL;
+  if (!task)
+    return -ENOMEM;
+
+  Task<void>::Handle handle = task.release();
+  internal::PromiseBase& promise = handle.promise();
+  int err;
+
+  promise.set_runner(runner);
+  promise.starter()->Init(handle);
+  err = promise.starter()->Post(runner);
+  if (err < 0)
+    handle.destroy();
+  return err;
+}
+
+// DelayAwaiter
+
+bool DelayAwaiter::Suspend(struct task_runner* runner,
+                           std::coroutine_handle<> h) {
+  init_delayed_task(&timer_.task, &DelayAwaiter::OnTimeout);
+  timer_.handle = h;
+  status_ = delayed_task_post(runner, &timer_.task, ticks_);
+  return status_ == 0;
+}
+
+void DelayAwaiter::OnTimeout(struct task* task) {
+  // Runs on the runner of the coroutine, resume it in place
+  reinterpret_cast<Timer*>(to_delayedtask(task))->handle.resume();
+}
+
+// SemaphoreAwaiter
+
+bool SemaphoreAwaiter::await_ready() noexcept {
+  status_ = tx_semaphore_get(sem_, TX_NO_WAIT);
+  return status_ == TX_SUCCESS || timeout_ == TX_NO_WAIT;
+}
+
+bool SemaphoreAwaiter::Suspend(struct task_runner* runner,
+                               std::coroutine_handle<> h) {
+  runner_ = runner;
+  resumer_.Init(h);
+  timer_.owner = this;
+  init_delayed_task(&timer_.task, &SemaphoreAwaiter::OnTimer);
+  deadline_ = (ULONG)tx_time_get() + timeout_;
+  waiting_ = true;
+
+#ifndef TX_DISABLE_NOTIFY_CALLBACKS
+  TX_INTERRUPT_SAVE_AREA
+
+  TX_DISABLE
+  g_semaphore_waiters.Append(this);
+  tx_semaphore_put_notify(sem_, &SemaphoreAwaiter::OnNotify);
+
+  // A put may have slipped in before the notify callback was installed
+  if (tx_semaphore_get(sem_, TX_NO_WAIT) == TX_SUCCESS) {
+    RemoveFromList();
+    waiting_ = false;
+    status_ = TX_SUCCESS;
+    TX_RESTORE
+    return false;
+  }
+  TX_RESTORE
+
+  if (timeout_ != TX_WAIT_FOREVER)
+    delayed_task_post(runner, &timer_.task, timeout_);
+#else
+  // No put notification, poll on every tick
+  delayed_task_post_periodic(runner, &timer_.task, 1, 1);
+#endif
+  return true;
+}
+
+void SemaphoreAwaiter::OnTimer(struct task* task) {
+  SemaphoreAwaiter* self =
+      reinterpret_cast<Timer*>(to_delayedtask(task))->owner;
+  TX_INTERRUPT_SAVE_AREA
+
+#ifndef TX_DISABLE_NOTIFY_CALLBACKS
+  TX_DISABLE
+  if (!self->waiting_) {
+    // Lost the race against OnNotify(), the resume task is already posted
+    TX_RESTORE
+    return;
+  }
+  self->RemoveFromList();
+  self->waiting_ = false;
+  self->status_ = TX_NO_INSTANCE;
+  TX_RESTORE
+#else
+  TX_DISABLE
+  self->status_ = tx_semaphore_get(self->sem_, TX_NO_WAIT);
+  if (self->status_ != TX_SUCCESS && self->timeout_ == TX_WAIT_FOREVER) {
+    TX_RESTORE
+    return;
+  }
+  if (self->status_ != TX_SUCCESS &&
+      (LONG)((ULONG)tx_time_get() - self->deadline_) < 0) {
+    TX_RESTORE
+    return;
+  }
+  self->waiting_ = false;
+  TX_RESTORE
+  delayed_task_cancel(&self->timer_.task, false);
+#endif
+
+  // Already running on the runner of the coroutine
+  self->resumer_.handle.resume();
+}
+
+void SemaphoreAwaiter::OnNotify(TX_SEMAPHORE* sem) {
+#ifndef TX_DISABLE_NOTIFY_CALLBACKS
+  SemaphoreAwaiter* woken = nullptr;
+  TX_INTERRUPT_SAVE_AREA
+
+  TX_DISABLE
+  for (LinkNode<SemaphoreAwaiter>* node = g_semaphore_waiters.head();
+       node != g_semaphore_waiters.end(); node = node->next()) {
+    SemaphoreAwaiter* waiter = node->value();
+
+    if (waiter->sem_ != sem)
+      continue;
+    if (tx_semaphore_get(sem, TX_NO_WAIT) == TX_SUCCESS) {
+      waiter->RemoveFromList();
+      waiter->waiting_ = false;
+      waiter->status_ = TX_SUCCESS;
+      woken = waiter;
+    }
+    break;
+  }
+  TX_RESTORE
+
+  if (woken) {
+    // Cancel the timeout before the resume is posted, the awaiter is gone
+    // as soon as the coroutine continues
+    if (woken->timeout_ != TX_WAIT_FOREVER)
+      delayed_task_cancel(&woken->timer_.task, false);
+    woken->resumer_.Post(woken->runner_);
+  }
+#endif
+}
+
+#ifdef CONFIG_HRTIMER
+// HrtimerAwaiter
+
+void HrtimerAwaiter::Suspend(struct task_runner* runner,
+                             std::coroutine_handle<> h) {
+  runner_ = runner;
+  resumer_.Init(h);
+  timer_.owner = this;
+  hrtimer_init(&timer_.timer);
+  timer_.timer.routine = &HrtimerAwaiter::OnExpired;
+  hrtimer_start(&timer_.timer, HRTIMER_US(usec_));
+}
+
+void HrtimerAwaiter::OnExpired(struct hrtimer* timer) {
+  HrtimerAwaiter* self = reinterpret_cast<Timer*>(timer)->owner;
+
+  self->resumer_.Post(self->runner_);
+}
+#endif  // CONFIG_HRTIMER
+
+// Completion
+
+void Completion::Signal(int result) {
+  bool wake;
+  TX_INTERRUPT_SAVE_AREA
+
+  TX_DISABLE
+  result_ = result;
+  signaled_ = true;
+  wake = runner_ != nullptr;
+  TX_RESTORE
+
+  if (wake)
+    resumer_.Post(runner_);
+}
+
+void Completion::Reset() {
+  signaled_ = false;
+  runner_ = nullptr;
+  result_ = 0;
+}
+
+bool Completion::Suspend(struct task_runner* runner,
+                         std::coroutine_handle<> h) {
+  TX_INTERRUPT_SAVE_AREA
+
+  resumer_.Init(h);
+  TX_DISABLE
+  if (signaled_) {
+    TX_RESTORE
+    return false;
+  }
+  runner_ = runner;
+  TX_RESTORE
+  return true;
+}
+
+}  // namespace base
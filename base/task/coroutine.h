@@ -0,0 +1,453 @@
+/*
+ * Copyright 2025 wtcat
+ */
+#ifndef BASE_TASK_COROUTINE_H_
+#define BASE_TASK_COROUTINE_H_
+
+#include <coroutine>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "tx_api.h"
+
+#include "base/base_export.h"
+#include "base/containers/linked_list.h"
+
+// C++20 coroutines scheduled on a task_runner. A coroutine is resumed by a
+// struct task posted to the runner it belongs to, so hundreds of flows can
+// share a few runner threads instead of a thread and stack each. While a
+// coroutine is suspended, the only memory it holds is its frame, which is
+// taken from GetCoroutineFrameResource() (a fixed block pool by default).
+//
+//   base::Task<int> ReadHeader(task_runner* io, fs_file* fp, void* buf) {
+//     ssize_t n = co_await base::Offload(io, [=] {
+//       return fs_read(fp, buf, 512);
+//     });
+//     co_return static_cast<int>(n);
+//   }
+//
+//   base::Task<> Flow(task_runner* io, fs_file* fp) {
+//     co_await base::Delay(TX_MSEC(10));
+//     int n = co_await ReadHeader(io, fp, buffer);
+//     UINT err = co_await base::Wait(&sem, TX_MSEC(100));
+//     ...
+//   }
+//
+//   base::Spawn(&_system_taskrunner, Flow(&io_runner, &file));
+//
+// A coroutine always continues on its own runner (the one it was spawned on,
+// or the one it switched to with SwitchTo()), whatever context completed
+// the operation it was waiting for. The code between two co_await runs as
+// one runner task and must not block.
+
+#ifndef CONFIG_COROUTINE_FRAME_SIZE
+#define CONFIG_COROUTINE_FRAME_SIZE 512
+#endif
+#ifndef CONFIG_COROUTINE_FRAMES
+#define CONFIG_COROUTINE_FRAMES 16
+#endif
+
+namespace base {
+
+// The resource coroutine frames are allocated from. The default is a pool
+// of CONFIG_COROUTINE_FRAMES blocks of CONFIG_COROUTINE_FRAME_SIZE bytes,
+// falling back to kmalloc() (if enabled) for larger frames.
+BASE_EXPORT std::pmr::memory_resource* GetCoroutineFrameResource();
+BASE_EXPORT void SetCoroutineFrameResource(std::pmr::memory_resource* resource);
+
+namespace internal {
+
+// A struct task that resumes a coroutine on the runner it is posted to.
+struct Resumer {
+  struct task task;
+  std::coroutine_handle<> handle;
+
+  void Init(std::coroutine_handle<> h) {
+    init_task(&task, &Resumer::Run);
+    handle = h;
+  }
+  int Post(struct task_runner* runner) { return task_post(runner, &task); }
+
+  static void Run(struct task* t) {
+    reinterpret_cast<Resumer*>(t)->handle.resume();
+  }
+};
+
+class BASE_EXPORT PromiseBase {
+ public:
+  static void* operator new(size_t size) noexcept;
+  static void operator delete(void* p, size_t size) noexcept;
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  void unhandled_exception() noexcept;
+
+  struct task_runner* runner() const { return runner_; }
+  void set_runner(struct task_runner* runner) { runner_ = runner; }
+  void set_continuation(std::coroutine_handle<> h) { continuation_ = h; }
+  // Posted by Spawn() to start the coroutine
+  Resumer* starter() { return &starter_; }
+
+ protected:
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> h) noexcept {
+      PromiseBase& promise = h.promise();
+      if (promise.continuation_)
+        return promise.continuation_;
+      // Detached by Spawn(), nobody will collect the result.
+      h.destroy();
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  struct task_runner* runner_ = nullptr;
+  std::coroutine_handle<> continuation_;
+  Resumer starter_;
+};
+
+template <typename T>
+class Promise : public PromiseBase {
+ public:
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  template <typename U>
+  void return_value(U&& value) {
+    value_.emplace(std::forward<U>(value));
+  }
+  T take() { return std::move(*value_); }
+
+ private:
+  std::optional<T> value_;
+};
+
+template <>
+class Promise<void> : public PromiseBase {
+ public:
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void return_void() noexcept {}
+  void take() {}
+};
+
+// Returns the promise of the awaiting coroutine, every awaitable in this
+// file needs it to find the runner to resume on.
+template <typename P>
+inline PromiseBase& PromiseOf(std::coroutine_handle<P> h) {
+  return h.promise();
+}
+
+}  // namespace internal
+
+// A lazily started coroutine returning T. Either co_await it from another
+// coroutine (it then runs on the awaiter's runner) or hand it to Spawn().
+// When the frame cannot be allocated the Task is empty (operator bool is
+// false), Spawn() then returns -ENOMEM. Awaiting an empty Task completes at
+// once with a value-initialized T.
+template <typename T = void>
+class [[nodiscard]] Task {
+ public:
+  struct promise_type : internal::Promise<T> {
+    Task get_return_object() noexcept {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    static Task get_return_object_on_allocation_failure() noexcept {
+      return Task();
+    }
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  explicit operator bool() const { return static_cast<bool>(handle_); }
+
+  class Awaiter {
+   public:
+    explicit Awaiter(Handle handle) : handle_(handle) {}
+
+    bool await_ready() const noexcept { return !handle_; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<P> caller) noexcept {
+      // Symmetric transfer, the callee starts on the caller's runner
+      handle_.promise().set_runner(internal::PromiseOf(caller).runner());
+      handle_.promise().set_continuation(caller);
+      return handle_;
+    }
+    T await_resume() {
+      if (!handle_)
+        return T();
+      return handle_.promise().take();
+    }
+
+   private:
+    Handle handle_;
+  };
+
+  Awaiter operator co_await() && noexcept { return Awaiter(handle_); }
+
+  Handle release() { return std::exchange(handle_, {}); }
+
+ private:
+  explicit Task(Handle h) : handle_(h) {}
+
+  Handle handle_;
+};
+
+// Start |task| on |runner| and let it run to completion on its own. The
+// frame is freed when the coroutine returns.
+BASE_EXPORT int Spawn(struct task_runner* runner, Task<void> task);
+
+// Suspend for |ticks| system ticks.
+class BASE_EXPORT DelayAwaiter {
+ public:
+  explicit DelayAwaiter(ULONG ticks) : ticks_(ticks) {}
+
+  bool await_ready() const noexcept { return ticks_ == 0; }
+  template <typename P>
+  bool await_suspend(std::coroutine_handle<P> h) noexcept {
+    return Suspend(internal::PromiseOf(h).runner(), h);
+  }
+  // 0 or the error of delayed_task_post()
+  int await_resume() const noexcept { return status_; }
+
+ private:
+  struct Timer {
+    struct delayed_task task;
+    std::coroutine_handle<> handle;
+  };
+
+  bool Suspend(struct task_runner* runner, std::coroutine_handle<> h);
+  static void OnTimeout(struct task* task);
+
+  const ULONG ticks_;
+  int status_ = 0;
+  Timer timer_;
+};
+
+inline DelayAwaiter Delay(ULONG ticks) {
+  return DelayAwaiter(ticks);
+}
+
+// Re-post the coroutine to the end of its runner queue.
+class BASE_EXPORT YieldAwaiter {
+ public:
+  bool await_ready() const noexcept { return false; }
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> h) noexcept {
+    resumer_.Init(h);
+    resumer_.Post(internal::PromiseOf(h).runner());
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  internal::Resumer resumer_;
+};
+
+inline YieldAwaiter Yield() {
+  return YieldAwaiter();
+}
+
+// Move the coroutine to |runner|, it is resumed there from now on.
+class BASE_EXPORT SwitchAwaiter {
+ public:
+  explicit SwitchAwaiter(struct task_runner* runner) : runner_(runner) {}
+
+  bool await_ready() const noexcept { return false; }
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> h) noexcept {
+    internal::PromiseOf(h).set_runner(runner_);
+    resumer_.Init(h);
+    resumer_.Post(runner_);
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  struct task_runner* const runner_;
+  internal::Resumer resumer_;
+};
+
+inline SwitchAwaiter SwitchTo(struct task_runner* runner) {
+  return SwitchAwaiter(runner);
+}
+
+// Take one instance of |sem|, giving up after |timeout| ticks. Resumes with
+// TX_SUCCESS or TX_NO_INSTANCE. With notify callbacks enabled the waiter is
+// woken by the semaphore put notification (which replaces any notify
+// callback the application registered on |sem|), otherwise the semaphore
+// is polled once per tick.
+class BASE_EXPORT SemaphoreAwaiter
+    : public base::LinkNode<SemaphoreAwaiter> {
+ public:
+  SemaphoreAwaiter(TX_SEMAPHORE* sem, ULONG timeout)
+      : sem_(sem), timeout_(timeout) {}
+
+  bool await_ready() noexcept;
+  template <typename P>
+  bool await_suspend(std::coroutine_handle<P> h) noexcept {
+    return Suspend(internal::PromiseOf(h).runner(), h);
+  }
+  UINT await_resume() const noexcept { return status_; }
+
+ private:
+  struct Timer {
+    struct delayed_task task;
+    SemaphoreAwaiter* owner;
+  };
+
+  bool Suspend(struct task_runner* runner, std::coroutine_handle<> h);
+  static void OnTimer(struct task* task);
+  static void OnNotify(TX_SEMAPHORE* sem);
+
+  TX_SEMAPHORE* const sem_;
+  const ULONG timeout_;
+  ULONG deadline_ = 0;
+  UINT status_ = TX_SUCCESS;
+  bool waiting_ = false;
+  struct task_runner* runner_ = nullptr;
+  internal::Resumer resumer_;
+  Timer timer_;
+};
+
+inline SemaphoreAwaiter Wait(TX_SEMAPHORE* sem,
+                             ULONG timeout = TX_WAIT_FOREVER) {
+  return SemaphoreAwaiter(sem, timeout);
+}
+
+#ifdef CONFIG_HRTIMER
+// Suspend for |usec| microseconds on the high resolution timer. The timer
+// expires in interrupt context, the coroutine continues on its runner.
+class BASE_EXPORT HrtimerAwaiter {
+ public:
+  explicit HrtimerAwaiter(uint64_t usec) : usec_(usec) {}
+
+  bool await_ready() const noexcept { return usec_ == 0; }
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> h) noexcept {
+    Suspend(internal::PromiseOf(h).runner(), h);
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  struct Timer {
+    struct hrtimer timer;
+    HrtimerAwaiter* owner;
+  };
+
+  void Suspend(struct task_runner* runner, std::coroutine_handle<> h);
+  static void OnExpired(struct hrtimer* timer);
+
+  const uint64_t usec_;
+  struct task_runner* runner_ = nullptr;
+  internal::Resumer resumer_;
+  Timer timer_;
+};
+
+inline HrtimerAwaiter HrDelay(uint64_t usec) {
+  return HrtimerAwaiter(usec);
+}
+#endif  // CONFIG_HRTIMER
+
+// One-shot completion for callback based drivers (DMA, block device or
+// SDIO request done). Signal() may be called from any thread or interrupt,
+// before or after the coroutine starts waiting. Only one coroutine may wait.
+//
+//   base::Completion done;
+//   start_dma(buf, len, [](void* arg, int err) {
+//     static_cast<base::Completion*>(arg)->Signal(err);
+//   }, &done);
+//   int err = co_await done;
+class BASE_EXPORT Completion {
+ public:
+  Completion() = default;
+  Completion(const Completion&) = delete;
+  Completion& operator=(const Completion&) = delete;
+
+  void Signal(int result);
+  void Reset();
+
+  bool await_ready() const noexcept { return signaled_; }
+  template <typename P>
+  bool await_suspend(std::coroutine_handle<P> h) noexcept {
+    return Suspend(internal::PromiseOf(h).runner(), h);
+  }
+  int await_resume() const noexcept { return result_; }
+
+ private:
+  bool Suspend(struct task_runner* runner, std::coroutine_handle<> h);
+
+  volatile bool signaled_ = false;
+  int result_ = 0;
+  struct task_runner* runner_ = nullptr;
+  internal::Resumer resumer_;
+};
+
+// Run the blocking call |fn| (fs_read(), blkdev_request(), ...) as a task on
+// |io_runner| and resume the coroutine on its own runner with the result.
+// A few I/O runners serve any number of coroutines this way.
+template <typename Fn>
+class OffloadAwaiter {
+ public:
+  using Result = decltype(std::declval<Fn&>()());
+  static_assert(!std::is_void_v<Result>, "the offloaded call must return a status");
+
+  OffloadAwaiter(struct task_runner* io_runner, Fn fn)
+      : io_runner_(io_runner), fn_(std::move(fn)) {}
+
+  bool await_ready() const noexcept { return false; }
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> h) noexcept {
+    runner_ = internal::PromiseOf(h).runner();
+    resumer_.Init(h);
+    work_.owner = this;
+    init_task(&work_.task, &OffloadAwaiter::Run);
+    task_post(io_runner_, &work_.task);
+  }
+  Result await_resume() { return std::move(*result_); }
+
+ private:
+  struct Work {
+    struct task task;
+    OffloadAwaiter* owner;
+  };
+
+  static void Run(struct task* task) {
+    OffloadAwaiter* self = reinterpret_cast<Work*>(task)->owner;
+    self->result_.emplace(self->fn_());
+    self->resumer_.Post(self->runner_);
+  }
+
+  struct task_runner* const io_runner_;
+  Fn fn_;
+  std::optional<Result> result_;
+  struct task_runner* runner_ = nullptr;
+  internal::Resumer resumer_;
+  Work work_;
+};
+
+template <typename Fn>
+inline OffloadAwaiter<Fn> Offload(struct task_runner* io_runner, Fn fn) {
+  return OffloadAwaiter<Fn>(io_runner, std::move(fn));
+}
+
+}  // namespace base
+
+#endif  // BASE_TASK_COROUTINE_H_
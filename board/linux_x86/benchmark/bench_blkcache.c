@@ -0,0 +1,124 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Block cache benchmark: a FAT heavy workload (many small files created,
+ * appended and deleted) on the RAM disk, directly and through the
+ * write-back block cache. A counting device between the file system and
+ * the RAM disk reports the requests the storage device would see.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "subsys/fs/fs.h"
+#include "drivers/blkcache.h"
+#include "benchmark/benchmark.h"
+
+#define BENCH_FILES  32
+#define BENCH_CACHE_BLOCK_SECTORS 1
+
+struct bench_counter {
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long sectors;
+};
+
+static struct bench_counter counter;
+static struct blkcache bench_cache;
+static char bench_cache_memory[32 * 1024] __rte_aligned(RTE_CACHE_LINE_SIZE);
+
+static int cntblk_request(struct device *dev, struct blkdev_req *req) {
+    (void) dev;
+    if (req->op == BLKDEV_REQ_READ)
+        counter.reads++;
+    else if (req->op == BLKDEV_REQ_WRITE)
+        counter.writes++;
+    counter.sectors += req->blkcnt;
+    return blkdev_request(device_find("ramblk"), req);
+}
+
+static int cntblk_control(struct device *dev, unsigned int cmd, void *arg) {
+    (void) dev;
+    return device_control(device_find("ramblk"), cmd, arg);
+}
+
+DEVICE_DEFINE(block_device, cntblk,
+    .name = "cntblk",
+    .request = cntblk_request,
+    .control = cntblk_control
+);
+
+static int bench_workload(const char *devname) {
+    static struct fs_class fs;
+    char path[32];
+    char data[64];
+    int err;
+
+    err = fs_mkfs(FS_EXFATFS, devname, NULL, 0);
+    if (err)
+        return err;
+
+    memset(&fs, 0, sizeof(fs));
+    fs.mnt_point = "/blk";
+    fs.storage_dev = (void *)devname;
+    fs.type = FS_EXFATFS;
+    err = fs_mount(&fs);
+    if (err)
+        return err;
+
+    memset(data, 'a', sizeof(data));
+    memset(&counter, 0, sizeof(counter));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < BENCH_FILES; i++) {
+            struct fs_file fp = {0};
+
+            snprintf(path, sizeof(path), "/blk/f%02d.txt", i);
+            err = fs_open(&fp, path, FS_O_CREATE | FS_O_WRITE | FS_O_APPEND);
+            if (err)
+                goto _unmount;
+            fs_write(&fp, data, sizeof(data));
+            fs_close(&fp);
+        }
+    }
+    for (int i = 0; i < BENCH_FILES; i += 2) {
+        snprintf(path, sizeof(path), "/blk/f%02d.txt", i);
+        fs_unlink(path);
+    }
+
+_unmount:
+    fs_unmount("/blk");
+    return err;
+}
+
+static void bench_blkcache(void) {
+    struct blkcache_stat stat;
+    int err;
+
+    err = bench_workload("cntblk");
+    if (err) {
+        printf("  workload failed (%d)\n", err);
+        return;
+    }
+    printf("  direct:   %5lu reads %5lu writes %6lu sectors\n",
+        counter.reads, counter.writes, counter.sectors);
+
+    err = blkcache_init(&bench_cache, "cacheblk", device_find("cntblk"),
+        bench_cache_memory, sizeof(bench_cache_memory), BENCH_CACHE_BLOCK_SECTORS);
+    if (err) {
+        printf("  blkcache_init failed (%d)\n", err);
+        return;
+    }
+
+    err = bench_workload("cacheblk");
+    if (err)
+        printf("  workload failed (%d)\n", err);
+
+    blkcache_get_stat(&bench_cache, &stat);
+    printf("  cached:   %5lu reads %5lu writes %6lu sectors\n",
+        counter.reads, counter.writes, counter.sectors);
+    printf("  cache:    %5lu hits  %5lu misses %5lu write backs (%lu merged)\n",
+        stat.hits, stat.misses, stat.writebacks, stat.merged);
+    blkcache_deinit(&bench_cache);
+}
+
+BENCHMARK(bench_blkcache, 100);
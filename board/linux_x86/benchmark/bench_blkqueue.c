@@ -0,0 +1,214 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Block request queue benchmark: 4 KB writes submitted with blkdev_submit()
+ * to a simulated disk that takes several commands at once. Every command
+ * pays an access latency, which overlaps between the commands in flight,
+ * and then a per sector transfer time on the shared bus. The disk keeps a
+ * virtual clock, so the throughput is the one of the modelled disk and
+ * not of the RAM disk behind it.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "drivers/blkqueue.h"
+#include "benchmark/benchmark.h"
+
+#define QBLK_SLOTS         4
+#define QBLK_LATENCY_NS    200000
+#define QBLK_SECTOR_NS     2000
+#define QBLK_WORKER_PRIO   10
+#define QBLK_DISK_PRIO     13
+
+#define BENCH_REQ_SECTORS  8
+#define BENCH_REQ_COUNT    2000
+#define BENCH_MAX_DEPTH    8
+#define SECTOR_SIZE        512
+
+struct qblk_cmd {
+    struct blkdev_req *req;
+    uint64_t done_at;
+};
+
+struct bench_io {
+    struct blkdev_areq areq;
+    char buffer[BENCH_REQ_SECTORS * SECTOR_SIZE];
+    int busy;
+};
+
+static struct qblk_cmd qblk_cmds[QBLK_SLOTS];
+static unsigned int qblk_head, qblk_tail;
+static uint64_t qblk_clock, qblk_bus_free;
+static TX_SEMAPHORE qblk_sem;
+static TX_THREAD qblk_thread;
+static ULONG qblk_stack[4096 / sizeof(ULONG)];
+
+static struct blkqueue bench_queue;
+static struct blkqueue_rq bench_slots[QBLK_SLOTS];
+static ULONG bench_queue_stack[4096 / sizeof(ULONG)];
+static struct bench_io bench_ios[BENCH_MAX_DEPTH];
+static TX_SEMAPHORE bench_io_done;
+
+static int qblk_request(struct device *dev, struct blkdev_req *req) {
+    (void) dev;
+    if (req->op == BLKDEV_REQ_SYNC)
+        return 0;
+    return blkdev_request(device_find("ramblk"), req);
+}
+
+static int qblk_control(struct device *dev, unsigned int cmd, void *arg) {
+    (void) dev;
+    return device_control(device_find("ramblk"), cmd, arg);
+}
+
+DEVICE_DEFINE(block_device, qblk,
+    .name = "qblk",
+    .request = qblk_request,
+    .control = qblk_control,
+    .max_segs = CONFIG_BLKQUEUE_MAX_SEGS
+);
+
+/* Called by the queue worker, the disk completes the commands in order */
+static int qblk_transfer(struct device *dev, struct blkdev_req *req) {
+    struct qblk_cmd *cmd = &qblk_cmds[qblk_head % QBLK_SLOTS];
+    uint64_t start = qblk_clock + QBLK_LATENCY_NS;
+
+    (void) dev;
+    if (start < qblk_bus_free)
+        start = qblk_bus_free;
+    qblk_bus_free = start + (uint64_t)req->blkcnt * QBLK_SECTOR_NS;
+
+    cmd->req = req;
+    cmd->done_at = qblk_bus_free;
+    qblk_head++;
+    tx_semaphore_put(&qblk_sem);
+    return 0;
+}
+
+/*
+ * The disk runs below the submitter and the queue worker, so a command
+ * completes only when nothing more can be submitted at the current time
+ */
+static void qblk_disk_thread(void *arg) {
+    (void) arg;
+    for ( ; ; ) {
+        struct qblk_cmd *cmd;
+        int err;
+
+        tx_semaphore_get(&qblk_sem, TX_WAIT_FOREVER);
+        cmd = &qblk_cmds[qblk_tail % QBLK_SLOTS];
+        qblk_clock = cmd->done_at;
+        err = qblk_request(NULL, cmd->req);
+        qblk_tail++;
+        blkqueue_complete(cmd->req, err);
+    }
+}
+
+static void bench_io_complete(struct blkdev_areq *areq, int err) {
+    struct bench_io *io = rte_container_of(areq, struct bench_io, areq);
+
+    (void) err;
+    io->busy = 0;
+    tx_semaphore_put(&bench_io_done);
+}
+
+static void bench_submit(struct device *dev, struct bench_io *io,
+    unsigned long blkno) {
+    io->areq.req.op = BLKDEV_REQ_WRITE;
+    io->areq.req.blkno = blkno;
+    io->areq.req.blkcnt = BENCH_REQ_SECTORS;
+    io->areq.req.buffer = io->buffer;
+    io->areq.req.nsegs = 0;
+    io->areq.done = bench_io_complete;
+    io->busy = 1;
+    blkdev_submit(dev, &io->areq);
+}
+
+static void bench_workload(struct device *dev, unsigned long slots, bool seq,
+    int depth) {
+    struct blkqueue_stat before, after;
+    uint64_t start;
+    int submitted = 0;
+
+    srand(1);
+    blkqueue_get_stat(&bench_queue, &before);
+    start = qblk_clock;
+    for (int n = 0; n < BENCH_REQ_COUNT + depth; n++) {
+        if (n >= depth)
+            tx_semaphore_get(&bench_io_done, TX_WAIT_FOREVER);
+        if (submitted == BENCH_REQ_COUNT)
+            continue;
+
+        for (int i = 0; i < depth; i++) {
+            struct bench_io *io = &bench_ios[i];
+            unsigned long slot;
+
+            if (io->busy)
+                continue;
+            slot = seq? submitted % slots: rand() % slots;
+            bench_submit(dev, io, slot * BENCH_REQ_SECTORS);
+            submitted++;
+            break;
+        }
+    }
+    blkqueue_get_stat(&bench_queue, &after);
+
+    printf("  %-10s depth %d: %7.1f MB/s %5lu commands %5lu merged\n",
+        seq? "sequential": "random", depth,
+        (double)BENCH_REQ_COUNT * BENCH_REQ_SECTORS * SECTOR_SIZE * 1000 /
+        (double)(qblk_clock - start),
+        after.dispatched - before.dispatched, after.merged - before.merged);
+}
+
+static void bench_blkqueue(void) {
+    struct device *dev = device_find("qblk");
+    struct blkqueue_config cfg = {
+        .name = "qblk",
+        .transfer = qblk_transfer,
+        .flags = BLKQUEUE_F_ASYNC,
+        .slots = bench_slots,
+        .nr_slots = QBLK_SLOTS,
+        .max_blocks = CONFIG_BLKQUEUE_MAX_SEGS * BENCH_REQ_SECTORS,
+        .stack = bench_queue_stack,
+        .stack_size = sizeof(bench_queue_stack),
+        .prio = QBLK_WORKER_PRIO
+    };
+    uint32_t blkcnt = 0;
+    int err;
+
+    if (dev == NULL)
+        return;
+
+    device_control(dev, BLKDEV_IOC_GET_BLKCOUNT, &blkcnt);
+    if (blkcnt < BENCH_REQ_SECTORS)
+        return;
+
+    err = blkqueue_init(&bench_queue, dev, &cfg);
+    if (err) {
+        printf("  blkqueue_init failed (%d)\n", err);
+        return;
+    }
+
+    tx_semaphore_create(&bench_io_done, "bench", 0);
+    tx_semaphore_create(&qblk_sem, "qblk", 0);
+    tx_thread_spawn(&qblk_thread, "qblk", qblk_disk_thread, NULL, qblk_stack,
+        sizeof(qblk_stack), QBLK_DISK_PRIO, QBLK_DISK_PRIO, TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+
+    for (int seq = 0; seq < 2; seq++) {
+        for (int depth = 1; depth <= BENCH_MAX_DEPTH; depth *= 2)
+            bench_workload(dev, blkcnt / BENCH_REQ_SECTORS, seq, depth);
+    }
+
+    blkqueue_destroy(&bench_queue);
+    tx_thread_terminate(&qblk_thread);
+    tx_thread_delete(&qblk_thread);
+    tx_semaphore_delete(&qblk_sem);
+    tx_semaphore_delete(&bench_io_done);
+}
+
+BENCHMARK(bench_blkqueue, 110);
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Scatter-gather block request benchmark: a stream of fragmented buffers
+ * (like a chain of packets) written to the RAM disk, gathered into a
+ * staging buffer for one contiguous request and passed as a segment list.
+ * The requests go to the last sectors of the disk, away from the file
+ * system metadata at its start, and their old content is restored.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "drivers/blkdev.h"
+#include "benchmark/benchmark.h"
+
+#define SEG_SECTORS   8
+#define SEG_COUNT     16
+#define SECTOR_SIZE   512
+#define BENCH_LOOPS   20000
+#define BENCH_SECTORS (SEG_COUNT * SEG_SECTORS)
+
+static char fragments[SEG_COUNT][SEG_SECTORS * SECTOR_SIZE + 64];
+static char staging[BENCH_SECTORS * SECTOR_SIZE];
+static char saved[BENCH_SECTORS * SECTOR_SIZE];
+
+static void bench_blkseg(void) {
+    struct device *dev = device_find("ramblk");
+    struct blkdev_seg segs[SEG_COUNT];
+    struct blkdev_req req;
+    uint64_t start, staged, gathered;
+    uint32_t blkcnt = 0;
+    unsigned long blkno;
+
+    if (dev == NULL)
+        return;
+
+    device_control(dev, BLKDEV_IOC_GET_BLKCOUNT, &blkcnt);
+    if (blkcnt < 2 * BENCH_SECTORS)
+        return;
+
+    blkno = blkcnt - BENCH_SECTORS;
+    req.op = BLKDEV_REQ_READ;
+    req.blkno = blkno;
+    req.blkcnt = BENCH_SECTORS;
+    req.buffer = saved;
+    req.nsegs = 0;
+    if (blkdev_request(dev, &req))
+        return;
+
+    /* Fragments are not adjacent in memory */
+    for (int i = 0; i < SEG_COUNT; i++) {
+        memset(fragments[i], i, sizeof(fragments[i]));
+        segs[i].buffer = fragments[i];
+        segs[i].blkcnt = SEG_SECTORS;
+    }
+
+    start = bench_now_ns();
+    for (int n = 0; n < BENCH_LOOPS; n++) {
+        for (int i = 0; i < SEG_COUNT; i++)
+            memcpy(&staging[i * SEG_SECTORS * SECTOR_SIZE], fragments[i],
+                SEG_SECTORS * SECTOR_SIZE);
+        req.op = BLKDEV_REQ_WRITE;
+        req.blkno = blkno;
+        req.blkcnt = BENCH_SECTORS;
+        req.buffer = staging;
+        req.nsegs = 0;
+        blkdev_request(dev, &req);
+    }
+    staged = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int n = 0; n < BENCH_LOOPS; n++) {
+        req.op = BLKDEV_REQ_WRITE;
+        req.blkno = blkno;
+        req.blkcnt = BENCH_SECTORS;
+        req.buffer = NULL;
+        req.segs = segs;
+        req.nsegs = SEG_COUNT;
+        blkdev_request(dev, &req);
+    }
+    gathered = bench_now_ns() - start;
+
+    req.op = BLKDEV_REQ_WRITE;
+    req.blkno = blkno;
+    req.blkcnt = BENCH_SECTORS;
+    req.buffer = saved;
+    req.nsegs = 0;
+    blkdev_request(dev, &req);
+
+    printf("  %d x %d KB fragments: staging copy %6" PRIu64 " ns/req, "
+        "segment list %6" PRIu64 " ns/req\n", SEG_COUNT,
+        SEG_SECTORS * SECTOR_SIZE / 1024, staged / BENCH_LOOPS,
+        gathered / BENCH_LOOPS);
+}
+
+BENCHMARK(bench_blkseg, 105);
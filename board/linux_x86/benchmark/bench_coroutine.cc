@@ -0,0 +1,140 @@
+/*
+ * Copyright 2025 wtcat
+ *
+ * Coroutine benchmark: hundreds of flows on one task runner. Compares the
+ * cost of a co_await round trip with a hand written struct task that
+ * re-posts itself, and the memory held per flow with a thread per flow.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "benchmark/benchmark.h"
+#include "base/memory/memory_resource.h"
+#include "base/task/coroutine.h"
+
+namespace {
+
+constexpr int kFlows = 200;
+constexpr int kSteps = 100;
+constexpr unsigned int kRunnerPrio = 14;
+constexpr size_t kRunnerStack = 8192;
+constexpr size_t kThreadStack = 1024;
+constexpr size_t kFrameSize = 512;
+
+struct CallbackFlow {
+  struct task base;
+  int steps;
+};
+
+struct task_runner runner;
+ULONG runner_stack[kRunnerStack / sizeof(ULONG)];
+CallbackFlow callback_flows[kFlows];
+alignas(std::max_align_t) char frame_buffer[kFlows * kFrameSize];
+int finished;
+size_t frame_bytes;
+
+// Records the frame size while forwarding to the frame pool
+class FrameProbe : public std::pmr::memory_resource {
+ public:
+  explicit FrameProbe(std::pmr::memory_resource* upstream)
+      : upstream_(upstream) {}
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    frame_bytes = bytes;
+    return upstream_->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* const upstream_;
+};
+
+void CallbackStep(struct task* task) {
+  CallbackFlow* flow = reinterpret_cast<CallbackFlow*>(task);
+
+  if (--flow->steps > 0) {
+    task_post(&runner, task);
+    return;
+  }
+  finished++;
+}
+
+base::Task<> YieldFlow() {
+  for (int i = 0; i < kSteps; i++)
+    co_await base::Yield();
+  finished++;
+}
+
+base::Task<> DelayFlow(ULONG ticks) {
+  co_await base::Delay(ticks);
+  finished++;
+}
+
+void WaitFinished(int count) {
+  while (finished < count)
+    tx_thread_sleep(1);
+}
+
+void Report(const char* name, uint64_t ns) {
+  printf("  %-10s %8" PRIu64 " us  %5" PRIu64 " ns/step\n", name, ns / 1000,
+         ns / (static_cast<uint64_t>(kFlows) * kSteps));
+}
+
+void bench_coroutine(void) {
+  base::ObjectPoolResource pool(frame_buffer, sizeof(frame_buffer), kFrameSize);
+  FrameProbe probe(&pool);
+  std::pmr::memory_resource* saved = base::GetCoroutineFrameResource();
+  uint64_t start;
+  int spawned;
+
+  base::SetCoroutineFrameResource(&probe);
+  task_runner_construct(&runner, "bench-co", runner_stack,
+                        sizeof(runner_stack), kRunnerPrio, -1);
+
+  finished = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < kFlows; i++) {
+    init_task(&callback_flows[i].base, CallbackStep);
+    callback_flows[i].steps = kSteps;
+    task_post(&runner, &callback_flows[i].base);
+  }
+  WaitFinished(kFlows);
+  Report("callback", bench_now_ns() - start);
+
+  finished = 0;
+  spawned = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < kFlows; i++)
+    spawned += base::Spawn(&runner, YieldFlow()) == 0;
+  WaitFinished(spawned);
+  Report("coroutine", bench_now_ns() - start);
+  printf("  %d/%d flows spawned, frame %zu bytes per flow,"
+         " thread per flow %zu bytes\n",
+         spawned, kFlows, frame_bytes, sizeof(TX_THREAD) + kThreadStack);
+
+  finished = 0;
+  spawned = 0;
+  for (int i = 0; i < kFlows; i++)
+    spawned += base::Spawn(&runner, DelayFlow(1 + i % 10)) == 0;
+  start = bench_now_ns();
+  WaitFinished(spawned);
+  printf("  %d delayed flows done in %" PRIu64 " us\n", spawned,
+         (bench_now_ns() - start) / 1000);
+
+  tx_thread_terminate(&runner.pid);
+  tx_thread_delete(&runner.pid);
+  tx_timer_delete(&runner.wheel.timer);
+  tx_semaphore_delete(&runner.sem);
+  base::SetCoroutineFrameResource(saved);
+}
+
+}  // namespace
+
+BENCHMARK(bench_coroutine, 65);
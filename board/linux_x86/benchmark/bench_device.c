@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Device lookup benchmark: 200 registered devices looked up by name.
+ * Compares a locked linear walk of the device list (the cost of the
+ * previous registry, measured through device_foreach) with the lock-free
+ * hashed device_find() and a compile-time DEVICE_GET() handle, from one
+ * thread and from several threads at once.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "benchmark/benchmark.h"
+
+#define NR_DEVICES     200
+#define NR_LOOKUPS     200000
+#define NR_THREADS     4
+
+struct bench_device {
+    struct device dev;
+    char name[16];
+};
+
+static struct bench_device devices[NR_DEVICES];
+static volatile uintptr_t lookup_sink;
+
+DEVICE_DECLARE(block_device, ramblk);
+
+static bool match_name(struct device *dev, void *user) {
+    const char **name = user;
+
+    if (!strcmp(dev->name, *name)) {
+        *name = (const char *)dev;
+        return true;
+    }
+    return false;
+}
+
+static struct device *linear_find(const char *name) {
+    const char *key = name;
+
+    device_foreach(match_name, &key);
+    return key != name? (struct device *)key: NULL;
+}
+
+static void lookup_linear(int id, void *arg) {
+    (void) arg;
+    for (int i = 0; i < NR_LOOKUPS / NR_THREADS; i++)
+        lookup_sink = (uintptr_t)linear_find(devices[(i + id) % NR_DEVICES].name);
+}
+
+static void lookup_hashed(int id, void *arg) {
+    (void) arg;
+    for (int i = 0; i < NR_LOOKUPS / NR_THREADS; i++)
+        lookup_sink = (uintptr_t)device_find(devices[(i + id) % NR_DEVICES].name);
+}
+
+static void report(const char *name, uint64_t ns, int lookups) {
+    printf("  %-16s %8" PRIu64 " us  %6" PRIu64 " ns/lookup\n", name, ns / 1000,
+        ns / lookups);
+}
+
+static void bench_device(void) {
+    uint64_t start;
+    int registered = 0;
+
+    for (int i = 0; i < NR_DEVICES; i++) {
+        snprintf(devices[i].name, sizeof(devices[i].name), "bench%03d", i);
+        devices[i].dev.name = devices[i].name;
+        registered += device_register(&devices[i].dev) == 0;
+    }
+    printf("  %d devices registered\n", registered);
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_LOOKUPS; i++)
+        lookup_sink = (uintptr_t)linear_find(devices[i % NR_DEVICES].name);
+    report("linear", bench_now_ns() - start, NR_LOOKUPS);
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_LOOKUPS; i++)
+        lookup_sink = (uintptr_t)device_find(devices[i % NR_DEVICES].name);
+    report("hashed", bench_now_ns() - start, NR_LOOKUPS);
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_LOOKUPS; i++)
+        lookup_sink = (uintptr_t)DEVICE_GET(ramblk);
+    report("static handle", bench_now_ns() - start, NR_LOOKUPS);
+
+    report("linear x4", bench_run_threads(NR_THREADS, lookup_linear, NULL),
+        NR_LOOKUPS);
+    report("hashed x4", bench_run_threads(NR_THREADS, lookup_hashed, NULL),
+        NR_LOOKUPS);
+
+    for (int i = 0; i < NR_DEVICES; i++)
+        device_unregister(&devices[i].dev);
+}
+
+BENCHMARK(bench_device, 75);
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * File system benchmark: the cost of the mount point lookup for a deep
+ * path and the throughput of threads that open files on their own mount
+ * against threads that open files on a shared mount. The open of the
+ * benchmark file system waits one tick like a storage device. The VFS
+ * holds no lock across it, so the threads overlap their waits on a shared
+ * mount as well.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "subsys/fs/fs.h"
+#include "benchmark/benchmark.h"
+
+#define BENCH_FS_TYPE    FS_MAX
+#define BENCH_MOUNTS     4
+#define LOOKUP_LOOPS     100000
+#define OPENS_PER_THREAD 50
+
+static struct fs_class bench_mounts[BENCH_MOUNTS];
+static int bench_mount_data[BENCH_MOUNTS];
+
+static const char *const bench_mount_points[BENCH_MOUNTS] = {
+    "/bench0", "/bench1", "/bench2", "/bench3"
+};
+
+static const char *const bench_files[BENCH_MOUNTS] = {
+    "/bench0/a/file", "/bench1/a/file", "/bench2/a/file", "/bench3/a/file"
+};
+
+static int bench_fs_open(struct fs_file *fp, const char *path, fs_mode_t flags) {
+    (void) fp;
+    (void) path;
+    (void) flags;
+    tx_thread_sleep(1);
+    return 0;
+}
+
+static int bench_fs_close(struct fs_file *fp) {
+    (void) fp;
+    return 0;
+}
+
+static int bench_fs_stat(struct fs_class *fs, const char *path,
+    struct fs_stat *entry) {
+    (void) fs;
+    (void) path;
+    (void) entry;
+    return 0;
+}
+
+static int bench_fs_mount(struct fs_class *fs) {
+    (void) fs;
+    return 0;
+}
+
+static int bench_fs_unmount(struct fs_class *fs) {
+    (void) fs;
+    return 0;
+}
+
+static const struct fs_operations bench_fs_ops = {
+    .open    = bench_fs_open,
+    .close   = bench_fs_close,
+    .stat    = bench_fs_stat,
+    .mount   = bench_fs_mount,
+    .unmount = bench_fs_unmount
+};
+
+static void open_worker(int id, void *arg) {
+    bool shared = arg != NULL;
+    const char *path = bench_files[shared? 0: id % BENCH_MOUNTS];
+
+    for (int i = 0; i < OPENS_PER_THREAD; i++) {
+        struct fs_file fp = {0};
+
+        if (fs_open(&fp, path, FS_O_READ) == 0)
+            fs_close(&fp);
+    }
+}
+
+static void bench_fs_open_threads(bool shared) {
+    uint64_t elapsed;
+
+    elapsed = bench_run_threads(BENCH_MOUNTS, open_worker, shared? (void *)1: NULL);
+    printf("  %d threads %-7s mount: %6" PRIu64 " opens/s\n", BENCH_MOUNTS,
+        shared? "shared": "own",
+        (uint64_t)(BENCH_MOUNTS * OPENS_PER_THREAD * 1000000000ull / elapsed));
+}
+
+static void bench_fs(void) {
+    struct fs_stat stat;
+    uint64_t start, elapsed;
+    int mounted = 0;
+    int err;
+
+    err = fs_register(BENCH_FS_TYPE, &bench_fs_ops);
+    if (err && err != -EALREADY) {
+        printf("  fs_register failed (%d)\n", err);
+        return;
+    }
+
+    for (int i = 0; i < BENCH_MOUNTS; i++, mounted++) {
+        struct fs_class *fs = &bench_mounts[i];
+
+        fs->type = BENCH_FS_TYPE;
+        fs->mnt_point = bench_mount_points[i];
+        fs->storage_dev = "bench";
+        fs->fs_data = &bench_mount_data[i];
+        err = fs_mount(fs);
+        if (err) {
+            printf("  fs_mount %s failed (%d)\n", fs->mnt_point, err);
+            goto _unmount;
+        }
+    }
+
+    start = bench_now_ns();
+    for (int i = 0; i < LOOKUP_LOOPS; i++)
+        fs_stat("/bench2/a/b/c/d/e/f/file.txt", &stat);
+    elapsed = bench_now_ns() - start;
+    printf("  fs_stat lookup (8 components): %" PRIu64 " ns/op\n",
+        elapsed / LOOKUP_LOOPS);
+
+    bench_fs_open_threads(true);
+    bench_fs_open_threads(false);
+
+_unmount:
+    while (mounted-- > 0)
+        fs_unmount(bench_mount_points[mounted]);
+}
+
+BENCHMARK(bench_fs, 95);
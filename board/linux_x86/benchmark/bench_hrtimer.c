@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * High resolution timer benchmark: accuracy of tx_os_nanosleep() on the
+ * simulated hrtimer, the expiry jitter seen by the timer interrupt and
+ * the accuracy of the hybrid tx_os_delay().
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define NR_LOOPS 50
+
+struct accuracy {
+    uint64_t total;
+    uint64_t max;
+};
+
+static void accuracy_add(struct accuracy *acc, uint64_t requested,
+    uint64_t elapsed) {
+    uint64_t error = elapsed > requested? elapsed - requested: 0;
+
+    acc->total += error;
+    if (error > acc->max)
+        acc->max = error;
+}
+
+static void bench_hrtimer(void) {
+    static const uint64_t sleeps[] = {50000, 200000, 1000000};
+    static const uint64_t delays[] = {2000, 20000, 200000, 2000000};
+    struct sim_hrtimer_stat stat;
+
+    printf("  nanosleep (late by, ns)\n");
+    for (size_t i = 0; i < rte_array_size(sleeps); i++) {
+        struct accuracy acc = {0};
+
+        sim_hrtimer_reset_stat();
+        for (int n = 0; n < NR_LOOPS; n++) {
+            uint64_t start = bench_now_ns();
+
+            tx_os_nanosleep(sleeps[i]);
+            accuracy_add(&acc, sleeps[i], bench_now_ns() - start);
+        }
+        sim_hrtimer_get_stat(&stat);
+        printf("  %8" PRIu64 " ns  avg %7" PRIu64 " max %8" PRIu64
+            "  irq jitter min %6llu avg %6llu max %8llu\n", sleeps[i],
+            acc.total / NR_LOOPS, acc.max, stat.min,
+            stat.count? stat.total / stat.count: 0, stat.max);
+    }
+
+    printf("  delay (late by, ns), wakeup latency %u ns\n",
+        (unsigned int)tx_os_delay_latency());
+    for (size_t i = 0; i < rte_array_size(delays); i++) {
+        struct accuracy acc = {0};
+
+        for (int n = 0; n < NR_LOOPS; n++) {
+            uint64_t start = bench_now_ns();
+
+            tx_os_delay(delays[i]);
+            accuracy_add(&acc, delays[i], bench_now_ns() - start);
+        }
+        printf("  %8" PRIu64 " ns  avg %7" PRIu64 " max %8" PRIu64 "\n",
+            delays[i], acc.total / NR_LOOPS, acc.max);
+    }
+}
+
+BENCHMARK(bench_hrtimer, 85);
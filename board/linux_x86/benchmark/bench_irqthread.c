@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Threaded interrupt benchmark: a host thread raises a simulated interrupt
+ * line as fast as it can while the handler does a fixed amount of work.
+ * Compares doing the work in the hard handler with deferring it to the
+ * interrupt task runner, with and without IRQF_ONESHOT. The handler time
+ * covers the work done in the hard handler (the top half when threaded).
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define BENCH_IRQ      5
+#define NR_RAISES      20000
+#define WORK_LOOPS     2000
+
+struct irq_bench {
+    struct irq_thread it;
+    uint64_t isr_cycles;
+    uint64_t isr_max;
+    unsigned long work_done;
+    volatile int generating;
+};
+
+static struct irq_bench bench;
+static volatile uint32_t work_sink;
+
+static void device_work(void) {
+    uint32_t v = work_sink;
+
+    for (int i = 0; i < WORK_LOOPS; i++)
+        v = v * 1664525u + 1013904223u;
+    work_sink = v;
+    bench.work_done++;
+}
+
+static void account_isr(uint64_t start) {
+    uint64_t cycles = bench_cycles() - start;
+
+    bench.isr_cycles += cycles;
+    if (cycles > bench.isr_max)
+        bench.isr_max = cycles;
+}
+
+static void hard_handler(void *arg) {
+    uint64_t start = bench_cycles();
+
+    (void) arg;
+    bench.it.raised++;
+    device_work();
+    account_isr(start);
+}
+
+static int top_half(void *arg) {
+    uint64_t start = bench_cycles();
+
+    (void) arg;
+    /* A real driver reads and clears the device status here */
+    work_sink ^= 1;
+    account_isr(start);
+    return IRQ_WAKE_THREAD;
+}
+
+static void bottom_half(void *arg) {
+    (void) arg;
+    device_work();
+}
+
+static void *storm_thread(void *arg) {
+    (void) arg;
+    for (int i = 0; i < NR_RAISES; i++) {
+        uint64_t until = bench_cycles() + 2000;
+
+        sim_irq_raise(BENCH_IRQ);
+        while (bench_cycles() < until)
+            continue;
+    }
+    bench.generating = 0;
+    return NULL;
+}
+
+static uint64_t run_storm(void) {
+    pthread_t pid;
+    unsigned long last;
+    uint64_t start;
+
+    bench.generating = 1;
+    start = bench_now_ns();
+    pthread_create(&pid, NULL, storm_thread, NULL);
+    while (bench.generating)
+        tx_thread_sleep(1);
+
+    /* Let the bottom halves drain */
+    do {
+        last = bench.work_done;
+        tx_thread_sleep(2);
+    } while (last != bench.work_done);
+    pthread_join(pid, NULL);
+    return bench_now_ns() - start;
+}
+
+static void reset(void) {
+    bench.isr_cycles = 0;
+    bench.isr_max = 0;
+    bench.work_done = 0;
+}
+
+static void report(const char *name, uint64_t ns) {
+    printf("  %-9s %6" PRIu64 " ms  raised %6lu  work %6lu  coalesced %6lu"
+        "  handler avg %6" PRIu64 " max %7" PRIu64 " cycles\n", name, ns / 1000000,
+        bench.it.raised, bench.work_done, bench.it.coalesced,
+        bench.it.raised? bench.isr_cycles / bench.it.raised: 0, bench.isr_max);
+}
+
+static void bench_irqthread(void) {
+    static const struct {
+        const char *name;
+        unsigned int flags;
+    } modes[] = {
+        {"threaded", 0},
+        {"oneshot", IRQF_ONESHOT},
+    };
+    uint64_t ns;
+
+    reset();
+    bench.it.raised = 0;
+    bench.it.coalesced = 0;
+    request_irq(BENCH_IRQ, hard_handler, NULL);
+    ns = run_storm();
+    remove_irq(BENCH_IRQ, hard_handler, NULL);
+    report("hard-irq", ns);
+
+    for (size_t i = 0; i < rte_array_size(modes); i++) {
+        reset();
+        request_threaded_irq(BENCH_IRQ, &bench.it, top_half, bottom_half, NULL,
+            modes[i].flags);
+        ns = run_storm();
+        remove_threaded_irq(BENCH_IRQ, &bench.it);
+        report(modes[i].name, ns);
+    }
+}
+
+BENCHMARK(bench_irqthread, 70);
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * General malloc contention benchmark: plain byte pool (the allocator
+ * without thread cache) vs __general_malloc
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define MALLOC_LOOPS   100000
+#define MALLOC_BATCH   8
+#define MALLOC_HEAP    (256 * 1024)
+
+static const uint16_t malloc_sizes[MALLOC_BATCH] = {
+    16, 24, 40, 64, 96, 128, 200, 256
+};
+
+static char heap_memory[MALLOC_HEAP] __rte_aligned(8);
+static TX_BYTE_POOL byte_pool;
+
+static void byte_pool_worker(int id, void *arg) {
+    void *objs[MALLOC_BATCH];
+
+    for (int i = 0; i < MALLOC_LOOPS; i++) {
+        for (int k = 0; k < MALLOC_BATCH; k++) {
+            if (tx_byte_allocate(&byte_pool, &objs[k], malloc_sizes[k], TX_NO_WAIT))
+                objs[k] = NULL;
+        }
+        for (int k = 0; k < MALLOC_BATCH; k++) {
+            if (objs[k])
+                tx_byte_release(objs[k]);
+        }
+    }
+}
+
+static void general_malloc_worker(int id, void *arg) {
+    void *objs[MALLOC_BATCH];
+
+    for (int i = 0; i < MALLOC_LOOPS; i++) {
+        for (int k = 0; k < MALLOC_BATCH; k++)
+            objs[k] = __general_malloc(malloc_sizes[k]);
+        for (int k = 0; k < MALLOC_BATCH; k++)
+            __general_free(objs[k]);
+    }
+}
+
+static void report(const char *name, int nthreads, uint64_t ns) {
+    uint64_t ops = (uint64_t)nthreads * MALLOC_LOOPS * MALLOC_BATCH * 2;
+    printf("  %-10s threads=%2d  %8" PRIu64 " us  %6" PRIu64 " ns/op  %8" PRIu64 " kops/s\n",
+        name, nthreads, ns / 1000, ns / ops, ops * 1000000 / ns);
+}
+
+static void bench_malloc(void) {
+    static const int threads[] = {1, 8, 16};
+
+    for (size_t i = 0; i < rte_array_size(threads); i++) {
+        tx_byte_pool_create(&byte_pool, "bench", heap_memory, sizeof(heap_memory));
+        report("byte-pool", threads[i],
+            bench_run_threads(threads[i], byte_pool_worker, NULL));
+        tx_byte_pool_delete(&byte_pool);
+
+        report("malloc", threads[i],
+            bench_run_threads(threads[i], general_malloc_worker, NULL));
+    }
+}
+
+BENCHMARK(bench_malloc, 20);
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Object pool contention benchmark: irq-guard pool vs lock-free pool vs
+ * ThreadX block pool
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define POOL_OBJECT_SIZE  64
+#define POOL_OBJECTS      64
+#define POOL_LOOPS        200000
+#define POOL_BATCH        4
+
+static char pool_memory[POOL_OBJECTS * POOL_OBJECT_SIZE] __rte_aligned(8);
+static char block_memory[POOL_OBJECTS * (POOL_OBJECT_SIZE + sizeof(void *))];
+
+static struct object_pool irq_pool;
+static struct lockfree_pool lf_pool;
+static TX_BLOCK_POOL block_pool;
+
+static void irq_pool_worker(int id, void *arg) {
+    void *objs[POOL_BATCH];
+
+    for (int i = 0; i < POOL_LOOPS; i++) {
+        for (int k = 0; k < POOL_BATCH; k++)
+            objs[k] = object_allocate(&irq_pool);
+        for (int k = 0; k < POOL_BATCH; k++)
+            object_free(&irq_pool, objs[k]);
+    }
+}
+
+static void lockfree_pool_worker(int id, void *arg) {
+    void *objs[POOL_BATCH];
+
+    for (int i = 0; i < POOL_LOOPS; i++) {
+        for (int k = 0; k < POOL_BATCH; k++)
+            objs[k] = lockfree_allocate(&lf_pool);
+        for (int k = 0; k < POOL_BATCH; k++)
+            lockfree_free(&lf_pool, objs[k]);
+    }
+}
+
+static void block_pool_worker(int id, void *arg) {
+    void *objs[POOL_BATCH];
+
+    for (int i = 0; i < POOL_LOOPS; i++) {
+        for (int k = 0; k < POOL_BATCH; k++) {
+            if (tx_block_allocate(&block_pool, &objs[k], TX_NO_WAIT))
+                objs[k] = NULL;
+        }
+        for (int k = 0; k < POOL_BATCH; k++) {
+            if (objs[k])
+                tx_block_release(objs[k]);
+        }
+    }
+}
+
+static void report(const char *name, int nthreads, uint64_t ns) {
+    uint64_t ops = (uint64_t)nthreads * POOL_LOOPS * POOL_BATCH * 2;
+    printf("  %-10s threads=%2d  %8" PRIu64 " us  %6" PRIu64 " ns/op\n", 
+        name, nthreads, ns / 1000, ns / ops);
+}
+
+static void bench_object_pool(void) {
+    static const int threads[] = {1, 2, 4, 8};
+    struct object_pool_stat stat;
+
+    for (size_t i = 0; i < rte_array_size(threads); i++) {
+        object_pool_initialize(&irq_pool, pool_memory, sizeof(pool_memory), 
+            POOL_OBJECT_SIZE);
+        report("irq-guard", threads[i], 
+            bench_run_threads(threads[i], irq_pool_worker, NULL));
+
+        lockfree_pool_initialize(&lf_pool, pool_memory, sizeof(pool_memory), 
+            POOL_OBJECT_SIZE);
+        report("lock-free", threads[i], 
+            bench_run_threads(threads[i], lockfree_pool_worker, NULL));
+
+        tx_block_pool_create(&block_pool, "bench", POOL_OBJECT_SIZE, 
+            block_memory, sizeof(block_memory));
+        report("tx-block", threads[i], 
+            bench_run_threads(threads[i], block_pool_worker, NULL));
+        tx_block_pool_delete(&block_pool);
+    }
+
+    lockfree_pool_get_stat(&lf_pool, &stat);
+    printf("  lock-free stat: allocs=%lu frees=%lu failures=%lu inuse=%lu peak=%lu\n",
+        stat.allocs, stat.frees, stat.failures, stat.inuse, stat.peak);
+}
+
+BENCHMARK(bench_object_pool, 10);
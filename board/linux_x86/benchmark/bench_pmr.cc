@@ -0,0 +1,94 @@
+/*
+ * Copyright 2025 wtcat
+ *
+ * C++ allocation benchmark: plain new/delete vs the base::memory resources.
+ * Each "request" allocates a batch of short-lived objects and a vector.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "base/memory/memory_resource.h"
+
+namespace {
+
+constexpr int kRequests = 20000;
+constexpr int kObjects = 32;
+constexpr size_t kObjectSize = 48;
+
+struct Node {
+  char payload[kObjectSize];
+};
+
+alignas(std::max_align_t) char arena_buffer[8 * 1024];
+alignas(std::max_align_t) char pool_buffer[kObjects * kObjectSize];
+
+void Report(const char* name, uint64_t ns) {
+  uint64_t ops = static_cast<uint64_t>(kRequests) * kObjects;
+  printf("  %-10s %8" PRIu64 " us  %6" PRIu64 " ns/object\n", name,
+         ns / 1000, ns / ops);
+}
+
+uint64_t RunNewDelete() {
+  uint64_t start = bench_now_ns();
+
+  for (int r = 0; r < kRequests; r++) {
+    std::vector<Node*> nodes;
+    nodes.reserve(kObjects);
+    for (int i = 0; i < kObjects; i++)
+      nodes.push_back(new Node);
+    for (Node* node : nodes)
+      delete node;
+  }
+  return bench_now_ns() - start;
+}
+
+uint64_t RunResource(std::pmr::memory_resource* resource) {
+  std::pmr::polymorphic_allocator<Node> alloc(resource);
+  uint64_t start = bench_now_ns();
+
+  for (int r = 0; r < kRequests; r++) {
+    std::pmr::vector<Node*> nodes(resource);
+    nodes.reserve(kObjects);
+    for (int i = 0; i < kObjects; i++)
+      nodes.push_back(alloc.allocate(1));
+    for (Node* node : nodes)
+      alloc.deallocate(node, 1);
+  }
+  return bench_now_ns() - start;
+}
+
+uint64_t RunArena(base::ArenaResource* arena) {
+  uint64_t start = bench_now_ns();
+
+  for (int r = 0; r < kRequests; r++) {
+    base::ScopedArena scope(arena);
+    std::pmr::vector<Node*> nodes(arena);
+    std::pmr::polymorphic_allocator<Node> alloc(arena);
+
+    nodes.reserve(kObjects);
+    for (int i = 0; i < kObjects; i++)
+      nodes.push_back(alloc.allocate(1));
+  }
+  return bench_now_ns() - start;
+}
+
+void bench_pmr(void) {
+  base::ArenaResource arena(arena_buffer, sizeof(arena_buffer));
+  base::ObjectPoolResource pool(pool_buffer, sizeof(pool_buffer), kObjectSize,
+                                std::pmr::new_delete_resource());
+
+  Report("new/delete", RunNewDelete());
+  Report("arena", RunArena(&arena));
+  Report("obj-pool", RunResource(&pool));
+#ifdef CONFIG_KMALLOC
+  Report("kmalloc", RunResource(base::KmallocResource::Get()));
+#endif
+  printf("  arena peak: %zu bytes\n", arena.peak());
+}
+
+}  // namespace
+
+BENCHMARK(bench_pmr, 40);
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * printk benchmark: cost of one printk call in cycles with the console
+ * replaced by a sink that spends a fixed time per character, like a UART.
+ * Compares synchronous output with the deferred ring, and reports the
+ * drops of a burst that is larger than the ring. With
+ * CONFIG_PRINTK_DICTIONARY the bytes per record show the saving of the
+ * binary frames over text.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define NR_CALLS       2000
+#define NR_BURST       1000
+#define CHAR_CYCLES    2000
+
+static uint64_t sink_chars;
+
+static void uart_sink(const char *s, size_t len) {
+    uint64_t until = bench_cycles() + len * CHAR_CYCLES;
+
+    (void) s;
+    sink_chars += len;
+    while (bench_cycles() < until)
+        continue;
+}
+
+static void run_calls(const char *name) {
+    uint64_t total = 0, max = 0;
+
+    for (int i = 0; i < NR_CALLS; i++) {
+        uint64_t start = bench_cycles();
+        uint64_t cycles;
+
+        printk("recv: overflow %d (%s)\n", i, "uart1");
+        cycles = bench_cycles() - start;
+        total += cycles;
+        if (cycles > max)
+            max = cycles;
+    }
+    printf("  %-9s avg %8" PRIu64 " max %9" PRIu64 " cycles/call\n", name,
+        total / NR_CALLS, max);
+}
+
+static void bench_printk(void) {
+    console_puts_t saved = __console_puts;
+    struct printk_stat stat;
+    uint64_t sync_chars;
+    bool deferred;
+
+    __console_puts = uart_sink;
+
+    deferred = printk_set_deferred(false);
+    run_calls("sync");
+    sync_chars = sink_chars;
+
+    printk_set_deferred(true);
+    run_calls("deferred");
+    printk_flush();
+
+    for (int i = 0; i < NR_BURST; i++)
+        printk("burst %d\n", i);
+    printk_flush();
+    printk_get_stat(&stat);
+    printk_set_deferred(deferred);
+    __console_puts = saved;
+
+    printf("  ring %u bytes, peak %u bytes, %u records, %u dropped,"
+        " %" PRIu64 " bytes output (%" PRIu64 " per deferred record)\n",
+        (unsigned int)stat.size, (unsigned int)stat.peak,
+        (unsigned int)stat.records, (unsigned int)stat.dropped, sink_chars,
+        stat.records? (sink_chars - sync_chars) / stat.records: 0);
+}
+
+BENCHMARK(bench_printk, 80);
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * System initialize benchmark: boot time with simulated slow drivers.
+ * The drivers sleep like an SD card identification, a USB stack bring-up,
+ * a file system mount that needs the SD card and a network interface.
+ * With CONFIG_SYSINIT_PARALLEL the boot time is close to the critical
+ * path (SD card and mount), otherwise it is the sum of all handlers.
+ */
+
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define SIM_MSEC(ms) ((ULONG)(ms) * TX_TIMER_TICKS_PER_SECOND / 1000)
+
+static int sim_usb_init(void) {
+    tx_thread_sleep(SIM_MSEC(200));
+    return 0;
+}
+
+static int sim_sdcard_init(void) {
+    tx_thread_sleep(SIM_MSEC(300));
+    return 0;
+}
+
+static int sim_sdcard_mount(void) {
+    tx_thread_sleep(SIM_MSEC(100));
+    return 0;
+}
+
+static int sim_netif_init(void) {
+    tx_thread_sleep(SIM_MSEC(250));
+    return 0;
+}
+
+SYSINIT_ASYNC(sim_usb_init, SI_BUSDRIVER_LEVEL, 90);
+SYSINIT_ASYNC(sim_sdcard_init, SI_DRIVER_LEVEL, 90);
+SYSINIT_DEPENDS(sim_sdcard_mount, SI_DRIVER_LEVEL, 91, "sim_sdcard_init");
+SYSINIT_ASYNC(sim_netif_init, SI_DRIVER_LEVEL, 92);
+
+static void bench_sysinit(void) {
+    struct sysinit_stat stat;
+
+    sysinit_get_stat(&stat);
+    printf("  %u items (%u async), boot %u ms, serial %u ms",
+        (unsigned int)stat.items, (unsigned int)stat.async,
+        (unsigned int)stat.boot_ms, (unsigned int)stat.serial_ms);
+    if (stat.boot_ms > 0)
+        printf(", speedup %u.%02ux",
+            (unsigned int)(stat.serial_ms / stat.boot_ms),
+            (unsigned int)(stat.serial_ms * 100 / stat.boot_ms % 100));
+    printf("\n");
+}
+
+BENCHMARK(bench_sysinit, 5);
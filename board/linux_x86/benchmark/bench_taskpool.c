@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Task pool scaling benchmark: checksum of a large buffer split with
+ * task_pool_parallel_for() on 1/2/4/8 workers. The uniprocessor simulator
+ * runs one thread at a time, so real speedup needs the SMP port, there the
+ * numbers show the cost of splitting, posting and stealing.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define POOL_PRIO         14
+#define POOL_STACK        8192
+#define POOL_MAX_WORKERS  8
+#define DATA_SIZE         (4 * 1024 * 1024)
+#define ROUNDS            8
+
+struct checksum_ctx {
+    const uint8_t *data;
+    uint32_t partial[CONFIG_TASK_POOL_MAX_CHUNKS];
+    size_t chunk;
+};
+
+static struct task_pool pool;
+static struct task_pool_worker workers[POOL_MAX_WORKERS];
+static ULONG pool_stack[POOL_MAX_WORKERS][POOL_STACK / sizeof(ULONG)];
+static uint8_t data[DATA_SIZE];
+
+static uint32_t fletcher32(const uint8_t *p, size_t len) {
+    uint32_t a = 0xFFFF, b = 0xFFFF;
+
+    while (len > 0) {
+        size_t n = len > 360? 360: len;
+
+        len -= n;
+        while (n--) {
+            a += *p++;
+            b += a;
+        }
+        a = (a & 0xFFFF) + (a >> 16);
+        b = (b & 0xFFFF) + (b >> 16);
+    }
+    return (b << 16) | a;
+}
+
+static void checksum_range(size_t begin, size_t end, void *arg) {
+    struct checksum_ctx *ctx = arg;
+
+    ctx->partial[begin / ctx->chunk] = fletcher32(ctx->data + begin, end - begin);
+}
+
+static uint32_t checksum_parallel(struct checksum_ctx *ctx) {
+    uint32_t sum = 0;
+
+    task_pool_parallel_for(&pool, 0, DATA_SIZE, ctx->chunk, checksum_range, ctx);
+    for (int i = 0; i < CONFIG_TASK_POOL_MAX_CHUNKS; i++)
+        sum ^= ctx->partial[i];
+    return sum;
+}
+
+static void bench_taskpool(void) {
+    struct checksum_ctx ctx;
+    uint64_t start, base_ns = 0;
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i < DATA_SIZE; i++)
+        data[i] = (uint8_t)(i * 2654435761u >> 24);
+
+    ctx.data = data;
+    ctx.chunk = DATA_SIZE / CONFIG_TASK_POOL_MAX_CHUNKS;
+
+    start = bench_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sum += fletcher32(data, DATA_SIZE);
+    printf("  serial    %8" PRIu64 " us  (sum %08" PRIx32 ")\n",
+        (bench_now_ns() - start) / 1000, sum);
+
+    for (unsigned int n = 1; n <= POOL_MAX_WORKERS; n *= 2) {
+        unsigned long stolen = 0;
+        uint64_t ns;
+
+        for (int i = 0; i < CONFIG_TASK_POOL_MAX_CHUNKS; i++)
+            ctx.partial[i] = 0;
+
+        task_pool_construct(&pool, workers, n, "bench-pool", pool_stack,
+            sizeof(pool_stack[0]), POOL_PRIO, 0);
+
+        sum = 0;
+        start = bench_now_ns();
+        for (int r = 0; r < ROUNDS; r++)
+            sum += checksum_parallel(&ctx);
+        ns = bench_now_ns() - start;
+        if (base_ns == 0)
+            base_ns = ns;
+
+        for (unsigned int i = 0; i < n; i++)
+            stolen += workers[i].stolen;
+        printf("  %u worker%s %8" PRIu64 " us  speedup %.2f  stolen %lu\n",
+            n, n > 1? "s": " ", ns / 1000, (double)base_ns / ns, stolen);
+
+        task_pool_destroy(&pool);
+    }
+}
+
+BENCHMARK(bench_taskpool, 60);
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Task post benchmark: the lock-free submission queue of the task runner
+ * against the previous scheme, where every post appends to the pending
+ * list under the interrupt lock and signals the runner semaphore. The
+ * interrupt-off time of the locked post path is sampled with the TSC.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define RUNNER_PRIO       20
+#define RUNNER_STACK      8192
+#define TASKS_PER_THREAD  256
+#define POSTS_PER_THREAD  20000
+
+struct locked_runner {
+    TX_THREAD pid;
+    TX_SEMAPHORE sem;
+    struct rte_list pending;
+    struct task *curr;
+};
+
+static struct task_runner runner;
+static struct locked_runner locked;
+static ULONG runner_stack[RUNNER_STACK / sizeof(ULONG)];
+static struct task tasks[BENCH_MAX_THREADS][TASKS_PER_THREAD];
+static volatile unsigned long executed;
+static uint64_t irqoff_max;
+
+static void count_handler(struct task *task) {
+    (void) task;
+    executed++;
+}
+
+static void locked_runner_thread(void *arg) {
+    struct locked_runner *lr = arg;
+    struct task *curr;
+
+    for ( ; ; ) {
+        curr = NULL;
+        scoped_guard(os_irq) {
+            if (!rte_list_empty(&lr->pending)) {
+                curr = rte_list_first_entry(&lr->pending, struct task, node);
+                rte_list_del(&curr->node);
+                curr->node.next = NULL;
+            }
+            lr->curr = curr;
+        }
+
+        if (curr == NULL) {
+            tx_semaphore_get(&lr->sem, TX_WAIT_FOREVER);
+            continue;
+        }
+        curr->handler(curr);
+    }
+}
+
+static int locked_post(struct locked_runner *lr, struct task *task) {
+    uint64_t start, cycles;
+
+    scoped_guard(os_irq) {
+        start = bench_cycles();
+        if (task->node.next != NULL)
+            return -EBUSY;
+        rte_list_add_tail(&task->node, &lr->pending);
+        cycles = bench_cycles() - start;
+        if (cycles > irqoff_max)
+            irqoff_max = cycles;
+    }
+    return tx_semaphore_ceiling_put(&lr->sem, 1);
+}
+
+static void locked_producer(int id, void *arg) {
+    (void) arg;
+    for (int i = 0; i < POSTS_PER_THREAD; i++)
+        locked_post(&locked, &tasks[id][i % TASKS_PER_THREAD]);
+}
+
+static void mpsc_producer(int id, void *arg) {
+    (void) arg;
+    for (int i = 0; i < POSTS_PER_THREAD; i++)
+        task_post(&runner, &tasks[id][i % TASKS_PER_THREAD]);
+}
+
+static void init_tasks(void) {
+    for (int i = 0; i < BENCH_MAX_THREADS; i++) {
+        for (int k = 0; k < TASKS_PER_THREAD; k++)
+            init_task(&tasks[i][k], count_handler);
+    }
+}
+
+static void wait_drained(void) {
+    unsigned long last;
+
+    do {
+        last = executed;
+        tx_thread_sleep(2);
+    } while (last != executed);
+}
+
+static void report(const char *name, int nthreads, uint64_t ns) {
+    printf("  %-6s %2d threads  %8" PRIu64 " us  %6.2f Mpost/s  executed %lu",
+        name, nthreads, ns / 1000,
+        (double)nthreads * POSTS_PER_THREAD * 1000 / ns, executed);
+}
+
+static void bench_taskpost(void) {
+    static const int threads[] = {1, 4, 8};
+    uint64_t ns;
+
+    tx_semaphore_create(&locked.sem, "locked", 0);
+    RTE_INIT_LIST(&locked.pending);
+    tx_thread_spawn(&locked.pid, "locked-runner", locked_runner_thread, &locked,
+        runner_stack, sizeof(runner_stack), RUNNER_PRIO, RUNNER_PRIO,
+        TX_NO_TIME_SLICE, TX_AUTO_START);
+
+    for (size_t i = 0; i < rte_array_size(threads); i++) {
+        init_tasks();
+        executed = 0;
+        irqoff_max = 0;
+        ns = bench_run_threads(threads[i], locked_producer, NULL);
+        wait_drained();
+        report("locked", threads[i], ns);
+        printf("  irq-off max %" PRIu64 " cycles\n", irqoff_max);
+    }
+
+    tx_thread_terminate(&locked.pid);
+    tx_thread_delete(&locked.pid);
+    tx_semaphore_delete(&locked.sem);
+
+    task_runner_construct(&runner, "bench-post", runner_stack,
+        sizeof(runner_stack), RUNNER_PRIO, -1);
+
+    for (size_t i = 0; i < rte_array_size(threads); i++) {
+        init_tasks();
+        executed = 0;
+        ns = bench_run_threads(threads[i], mpsc_producer, NULL);
+        wait_drained();
+        report("mpsc", threads[i], ns);
+        printf("  irq-off max 0 cycles (no lock on post)\n");
+    }
+
+    tx_thread_terminate(&runner.pid);
+    tx_thread_delete(&runner.pid);
+    tx_timer_delete(&runner.wheel.timer);
+    tx_semaphore_delete(&runner.sem);
+}
+
+BENCHMARK(bench_taskpost, 52);
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Task runner latency benchmark: queue latency of an urgent task posted
+ * behind a flood of slow low-priority tasks, with the urgent task on the
+ * same level (FIFO) and on the highest level
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark/benchmark.h"
+
+#define RUNNER_PRIO       14
+#define RUNNER_STACK      8192
+#define FLOOD_TASKS       64
+#define FLOOD_WORK_NS     20000
+#define URGENT_SAMPLES    200
+
+struct urgent_task {
+    struct task base;
+    uint64_t post_ns;
+};
+
+static struct task_runner runner;
+static ULONG runner_stack[RUNNER_STACK / sizeof(ULONG)];
+static struct task flood_tasks[FLOOD_TASKS];
+static struct urgent_task urgent;
+static uint64_t latency[URGENT_SAMPLES];
+static volatile int samples;
+static TX_SEMAPHORE urgent_done;
+
+static void flood_handler(struct task *task) {
+    uint64_t end = bench_now_ns() + FLOOD_WORK_NS;
+
+    (void) task;
+    while (bench_now_ns() < end);
+}
+
+static void urgent_handler(struct task *task) {
+    struct urgent_task *ut = (struct urgent_task *)task;
+
+    latency[samples++] = bench_now_ns() - ut->post_ns;
+    tx_semaphore_put(&urgent_done);
+}
+
+static void flood_worker(int id, void *arg) {
+    unsigned int prio = (unsigned int)(uintptr_t)arg;
+
+    (void) id;
+    for (int i = 0; i < URGENT_SAMPLES; i++) {
+        for (int k = 0; k < FLOOD_TASKS; k++)
+            task_post_prio(&runner, &flood_tasks[k], TASK_PRIO_LOWEST);
+
+        urgent.post_ns = bench_now_ns();
+        task_post_prio(&runner, &urgent.base, prio);
+        tx_semaphore_get(&urgent_done, TX_WAIT_FOREVER);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name) {
+    qsort(latency, samples, sizeof(latency[0]), compare_u64);
+    printf("  %-8s p50 %8" PRIu64 " us  p99 %8" PRIu64 " us  max %8" PRIu64 " us\n",
+        name, latency[samples / 2] / 1000, latency[samples * 99 / 100] / 1000,
+        latency[samples - 1] / 1000);
+}
+
+static void bench_taskrunner(void) {
+    struct task_queue_stat stat;
+
+    task_runner_construct(&runner, "bench-runner", runner_stack,
+        sizeof(runner_stack), RUNNER_PRIO, 0);
+    tx_semaphore_create(&urgent_done, "urgent", 0);
+    for (int i = 0; i < FLOOD_TASKS; i++)
+        init_task(&flood_tasks[i], flood_handler);
+    init_task(&urgent.base, urgent_handler);
+
+    samples = 0;
+    bench_run_threads(1, flood_worker, (void *)(uintptr_t)TASK_PRIO_LOWEST);
+    report("fifo");
+
+    samples = 0;
+    bench_run_threads(1, flood_worker, (void *)(uintptr_t)TASK_PRIO_HIGHEST);
+    report("priority");
+
+    for (unsigned int prio = 0; prio < TASK_PRIO_LEVELS; prio++) {
+        task_runner_get_stat(&runner, prio, &stat);
+        if (stat.posted == 0)
+            continue;
+        printf("  level %u: posted=%lu executed=%lu max_depth=%u wait_max=%" PRIu32 "\n",
+            prio, stat.posted, stat.executed, stat.max_depth, stat.wait_max);
+    }
+
+    tx_thread_terminate(&runner.pid);
+    tx_thread_delete(&runner.pid);
+    tx_timer_delete(&runner.wheel.timer);
+    tx_semaphore_delete(&runner.sem);
+    tx_semaphore_delete(&urgent_done);
+}
+
+BENCHMARK(bench_taskrunner, 50);
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Tickless idle benchmark: timer wakeups per second of an idle system with
+ * the periodic tick and with the tickless idle, the accuracy of thread
+ * sleeps and the drift of the ThreadX clock against CLOCK_MONOTONIC.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define IDLE_SECONDS 2
+#define SLEEP_TICKS  10
+#define SLEEP_LOOPS  50
+
+static void bench_tickless_mode(bool enable) {
+    struct tickless_stat before, after;
+    uint64_t start, elapsed, late_total = 0, late_max = 0;
+    uint64_t skipped;
+    ULONG clock, ticks;
+    int64_t drift;
+
+    tickless_enable(enable);
+    tx_thread_sleep(1);
+
+    /* Idle: only this thread sleeping */
+    tickless_get_stat(&before);
+    clock = tx_time_get();
+    start = bench_now_ns();
+    tx_thread_sleep(IDLE_SECONDS * TX_TIMER_TICKS_PER_SECOND);
+    elapsed = bench_now_ns() - start;
+    ticks = tx_time_get() - clock;
+    tickless_get_stat(&after);
+
+    skipped = after.skipped - before.skipped;
+    if (skipped > ticks)
+        skipped = ticks;
+    drift = (int64_t)ticks * (1000000000 / TX_TIMER_TICKS_PER_SECOND) -
+        (int64_t)elapsed;
+
+    /* Short sleeps, late by against the nominal tick time */
+    for (int i = 0; i < SLEEP_LOOPS; i++) {
+        uint64_t late, nominal = SLEEP_TICKS * (1000000000ull / TX_TIMER_TICKS_PER_SECOND);
+
+        start = bench_now_ns();
+        tx_thread_sleep(SLEEP_TICKS);
+        elapsed = bench_now_ns() - start;
+        late = elapsed > nominal? elapsed - nominal: 0;
+        late_total += late;
+        if (late > late_max)
+            late_max = late;
+    }
+
+    printf("  %-9s wakeups/s %6" PRIu64 "  skipped %6" PRIu64
+        "  clock drift %7" PRId64 " us  %d-tick sleep late avg %6" PRIu64
+        " us max %6" PRIu64 " us\n",
+        enable? "tickless": "periodic",
+        ((ticks - skipped) + (after.wakeups - before.wakeups)) / IDLE_SECONDS,
+        skipped, drift / 1000, SLEEP_TICKS,
+        late_total / SLEEP_LOOPS / 1000, late_max / 1000);
+}
+
+static void bench_tickless(void) {
+    struct tickless_stat stat;
+
+    tickless_get_stat(&stat);
+    bench_tickless_mode(false);
+    bench_tickless_mode(true);
+    tickless_enable(stat.enabled);
+}
+
+BENCHMARK(bench_tickless, 90);
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Delayed task benchmark: 10k outstanding delayed tasks on the runner
+ * timer wheel compared with one TX_TIMER per task. Measures arm, re-arm
+ * and cancel cost and the expiry lateness in ticks.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark/benchmark.h"
+
+#define RUNNER_PRIO       14
+#define RUNNER_STACK      8192
+#define NR_TASKS          10000
+#define MAX_DELAY         500
+
+struct wheel_task {
+    struct delayed_task base;
+    uint32_t deadline;
+};
+
+struct timer_task {
+    TX_TIMER timer;
+    uint32_t deadline;
+};
+
+static struct task_runner runner;
+static ULONG runner_stack[RUNNER_STACK / sizeof(ULONG)];
+static struct wheel_task wheel_tasks[NR_TASKS];
+static struct timer_task timer_tasks[NR_TASKS];
+static uint16_t delays[NR_TASKS];
+static volatile unsigned int expired;
+static uint32_t late_max;
+static uint64_t late_total;
+
+static void account_expiry(uint32_t deadline) {
+    uint32_t late = (uint32_t)tx_time_get() - deadline;
+
+    if (late > late_max)
+        late_max = late;
+    late_total += late;
+    expired++;
+}
+
+static void wheel_handler(struct task *task) {
+    struct wheel_task *wt = (struct wheel_task *)to_delayedtask(task);
+    account_expiry(wt->deadline);
+}
+
+static void timer_handler(ULONG arg) {
+    struct timer_task *tt = (struct timer_task *)arg;
+    account_expiry(tt->deadline);
+}
+
+static void report(const char *name, uint64_t arm_ns, uint64_t rearm_ns,
+    uint64_t cancel_ns) {
+    printf("  %-8s arm %5" PRIu64 " ns  re-arm %5" PRIu64 " ns  cancel %5" PRIu64 " ns"
+        "  late max %" PRIu32 " avg %.2f ticks\n", name, arm_ns / NR_TASKS,
+        rearm_ns / NR_TASKS, cancel_ns / NR_TASKS, late_max,
+        (double)late_total / NR_TASKS);
+}
+
+static void wait_expired(void) {
+    while (expired < NR_TASKS)
+        tx_thread_sleep(10);
+}
+
+static void run_wheel(void) {
+    uint64_t start, arm_ns, rearm_ns, cancel_ns;
+    uint32_t now;
+
+    for (int i = 0; i < NR_TASKS; i++)
+        init_delayed_task(&wheel_tasks[i].base, wheel_handler);
+
+    /* Arm and cancel */
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++)
+        delayed_task_post(&runner, &wheel_tasks[i].base, delays[i]);
+    arm_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++)
+        delayed_task_post(&runner, &wheel_tasks[i].base, delays[NR_TASKS - 1 - i]);
+    rearm_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++)
+        delayed_task_cancel(&wheel_tasks[i].base, false);
+    cancel_ns = bench_now_ns() - start;
+
+    /* Expiry */
+    expired = 0;
+    late_max = 0;
+    late_total = 0;
+    now = (uint32_t)tx_time_get();
+    for (int i = 0; i < NR_TASKS; i++) {
+        wheel_tasks[i].deadline = now + delays[i];
+        delayed_task_post(&runner, &wheel_tasks[i].base, delays[i]);
+    }
+    wait_expired();
+    report("wheel", arm_ns, rearm_ns, cancel_ns);
+}
+
+static void run_tx_timer(void) {
+    uint64_t start, arm_ns, rearm_ns, cancel_ns;
+    uint32_t now;
+
+    for (int i = 0; i < NR_TASKS; i++)
+        tx_timer_create(&timer_tasks[i].timer, "bench", timer_handler,
+            (ULONG)&timer_tasks[i], 1, 0, TX_NO_ACTIVATE);
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++)
+        tx_timer_change(&timer_tasks[i].timer, delays[i], 0);
+    for (int i = 0; i < NR_TASKS; i++)
+        tx_timer_activate(&timer_tasks[i].timer);
+    arm_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++) {
+        tx_timer_deactivate(&timer_tasks[i].timer);
+        tx_timer_change(&timer_tasks[i].timer, delays[NR_TASKS - 1 - i], 0);
+        tx_timer_activate(&timer_tasks[i].timer);
+    }
+    rearm_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int i = 0; i < NR_TASKS; i++)
+        tx_timer_deactivate(&timer_tasks[i].timer);
+    cancel_ns = bench_now_ns() - start;
+
+    expired = 0;
+    late_max = 0;
+    late_total = 0;
+    now = (uint32_t)tx_time_get();
+    for (int i = 0; i < NR_TASKS; i++) {
+        timer_tasks[i].deadline = now + delays[i];
+        tx_timer_change(&timer_tasks[i].timer, delays[i], 0);
+        tx_timer_activate(&timer_tasks[i].timer);
+    }
+    wait_expired();
+    report("tx_timer", arm_ns, rearm_ns, cancel_ns);
+
+    for (int i = 0; i < NR_TASKS; i++)
+        tx_timer_delete(&timer_tasks[i].timer);
+}
+
+static void bench_timerwheel(void) {
+    srand(1);
+    for (int i = 0; i < NR_TASKS; i++)
+        delays[i] = (uint16_t)(1 + rand() % MAX_DELAY);
+
+    task_runner_construct(&runner, "bench-wheel", runner_stack,
+        sizeof(runner_stack), RUNNER_PRIO, -1);
+
+    printf("  per task: delayed_task %zu bytes, task + TX_TIMER %zu bytes\n",
+        sizeof(struct delayed_task), sizeof(struct task) + sizeof(TX_TIMER));
+    run_wheel();
+    run_tx_timer();
+
+    tx_thread_terminate(&runner.pid);
+    tx_thread_delete(&runner.pid);
+    tx_timer_delete(&runner.wheel.timer);
+    tx_semaphore_delete(&runner.sem);
+}
+
+BENCHMARK(bench_timerwheel, 55);
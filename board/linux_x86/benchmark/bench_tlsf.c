@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Heap latency benchmark: randomized alloc/free stress on the ThreadX
+ * byte pool and the TLSF allocator, reporting average and worst-case
+ * cycles per operation
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "benchmark/benchmark.h"
+
+#define HEAP_SIZE      (256 * 1024)
+#define HEAP_SLOTS     512
+#define HEAP_OPS       400000
+#define HEAP_MAX_ALLOC 2048
+
+struct heap_ops {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*free)(void *ptr);
+    void (*report)(void);
+};
+
+struct latency {
+    uint64_t total;
+    uint64_t worst;
+    unsigned long count;
+};
+
+static char heap_memory[HEAP_SIZE] __rte_aligned(8);
+static void *heap_slots[HEAP_SLOTS];
+static TX_BYTE_POOL byte_pool;
+static struct tlsf tlsf_heap;
+
+static void *byte_pool_alloc(size_t size) {
+    void *p;
+    if (tx_byte_allocate(&byte_pool, &p, size, TX_NO_WAIT))
+        return NULL;
+    return p;
+}
+
+static void byte_pool_free(void *ptr) {
+    tx_byte_release(ptr);
+}
+
+static void *tlsf_heap_alloc(size_t size) {
+    return tlsf_malloc(&tlsf_heap, size);
+}
+
+static void tlsf_heap_free(void *ptr) {
+    tlsf_free(&tlsf_heap, ptr);
+}
+
+static void tlsf_heap_report(void) {
+    struct heap_stat stat;
+
+    tlsf_get_stat(&tlsf_heap, &stat);
+    printf("  tlsf stat: total=%zu used=%zu free=%zu largest=%zu blocks=%lu frag=%u%%\n",
+        stat.total_size, stat.used_size, stat.free_size, stat.largest_free,
+        stat.free_blocks, stat.frag_percent);
+}
+
+static inline uint32_t bench_random(uint32_t *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+static inline void latency_add(struct latency *lat, uint64_t cycles) {
+    lat->total += cycles;
+    lat->count++;
+    if (cycles > lat->worst)
+        lat->worst = cycles;
+}
+
+static void heap_stress(const struct heap_ops *ops) {
+    struct latency alloc = {0}, release = {0};
+    unsigned long failures = 0;
+    uint32_t seed = 0x5a5a;
+    uint64_t start;
+
+    for (int i = 0; i < HEAP_OPS; i++) {
+        uint32_t rnd = bench_random(&seed);
+        void **slot = &heap_slots[rnd % HEAP_SLOTS];
+
+        if (*slot) {
+            start = bench_cycles();
+            ops->free(*slot);
+            latency_add(&release, bench_cycles() - start);
+            *slot = NULL;
+        } else {
+            size_t size = 8 + (bench_random(&seed) % HEAP_MAX_ALLOC);
+
+            start = bench_cycles();
+            *slot = ops->alloc(size);
+            latency_add(&alloc, bench_cycles() - start);
+            if (*slot == NULL)
+                failures++;
+        }
+    }
+
+    if (ops->report)
+        ops->report();
+
+    for (int i = 0; i < HEAP_SLOTS; i++) {
+        if (heap_slots[i]) {
+            ops->free(heap_slots[i]);
+            heap_slots[i] = NULL;
+        }
+    }
+
+    printf("  %-10s alloc avg %5" PRIu64 " worst %8" PRIu64 " | "
+        "free avg %5" PRIu64 " worst %8" PRIu64 " cycles | failures %lu\n",
+        ops->name,
+        alloc.total / (alloc.count? alloc.count: 1), alloc.worst,
+        release.total / (release.count? release.count: 1), release.worst,
+        failures);
+}
+
+static void bench_tlsf(void) {
+    static const struct heap_ops byte_pool_ops = {
+        "byte-pool", byte_pool_alloc, byte_pool_free, NULL
+    };
+    static const struct heap_ops tlsf_ops = {
+        "tlsf", tlsf_heap_alloc, tlsf_heap_free, tlsf_heap_report
+    };
+
+    tx_byte_pool_create(&byte_pool, "bench", heap_memory, sizeof(heap_memory));
+    heap_stress(&byte_pool_ops);
+    tx_byte_pool_delete(&byte_pool);
+
+    tlsf_init(&tlsf_heap, heap_memory, sizeof(heap_memory));
+    heap_stress(&tlsf_ops);
+}
+
+BENCHMARK(bench_tlsf, 30);
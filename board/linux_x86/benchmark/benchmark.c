@@ -0,0 +1,67 @@
+/*
+ * Copyright 2024 wtcat
+ */
+
+#include <stdio.h>
+#include "benchmark/benchmark.h"
+
+#define BENCH_THREAD_PRIO  12
+#define BENCH_THREAD_STACK 4096
+
+struct bench_worker {
+    TX_THREAD thread;
+    ULONG stack[BENCH_THREAD_STACK / sizeof(ULONG)];
+    void (*fn)(int id, void *arg);
+    void *arg;
+    int id;
+};
+
+LINKER_ROSET(benchmark, struct benchmark_item);
+static struct bench_worker bench_workers[BENCH_MAX_THREADS];
+static TX_SEMAPHORE bench_done;
+
+static void bench_worker_entry(void *arg) {
+    struct bench_worker *w = arg;
+
+    w->fn(w->id, w->arg);
+    tx_semaphore_put(&bench_done);
+}
+
+uint64_t bench_run_threads(int nthreads, void (*fn)(int id, void *arg), void *arg) {
+    uint64_t start;
+
+    if (nthreads > BENCH_MAX_THREADS)
+        nthreads = BENCH_MAX_THREADS;
+
+    tx_semaphore_create(&bench_done, "bench", 0);
+    start = bench_now_ns();
+    for (int i = 0; i < nthreads; i++) {
+        struct bench_worker *w = &bench_workers[i];
+
+        w->fn = fn;
+        w->arg = arg;
+        w->id = i;
+        tx_thread_spawn(&w->thread, "bench", bench_worker_entry, w, w->stack, 
+            sizeof(w->stack), BENCH_THREAD_PRIO, BENCH_THREAD_PRIO, 1, TX_AUTO_START);
+    }
+
+    for (int i = 0; i < nthreads; i++)
+        tx_semaphore_get(&bench_done, TX_WAIT_FOREVER);
+    start = bench_now_ns() - start;
+
+    for (int i = 0; i < nthreads; i++) {
+        tx_thread_terminate(&bench_workers[i].thread);
+        tx_thread_delete(&bench_workers[i].thread);
+    }
+    tx_semaphore_delete(&bench_done);
+
+    return start;
+}
+
+void run_benchmarks(void) {
+    printf("\n*** Benchmark ***\n");
+    LINKER_SET_FOREACH(benchmark, item, struct benchmark_item) {
+        printf("==> %s\n", item->name);
+        item->run();
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Simulator benchmark helper
+ */
+#ifndef LINUX_X86_BENCHMARK_H_
+#define LINUX_X86_BENCHMARK_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "tx_api.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define BENCH_MAX_THREADS 16
+
+struct benchmark_item {
+    void (*run)(void);
+    const char *name;
+};
+
+/*
+ * Define a benchmark, it will be executed by main thread after
+ * system initialized
+ */
+#define BENCHMARK(_fn, _order) \
+    static LINKER_ROSET_ITEM_ORDERED(benchmark, struct benchmark_item, \
+        _fn, _order) = { \
+        .run  = _fn, \
+        .name = #_fn \
+    }
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void) {
+    return __builtin_ia32_rdtsc();
+}
+
+/*
+ * Run @fn on @nthreads threads of the same priority with 1-tick time slice 
+ * and wait for all of them. Return the elapsed time in nanoseconds
+ */
+uint64_t bench_run_threads(int nthreads, void (*fn)(int id, void *arg), void *arg);
+
+void run_benchmarks(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LINUX_X86_BENCHMARK_H_ */
@@ -7,6 +7,9 @@
 
 #include "fx_api.h"
 #include "subsys/fs/fs.h"
+#ifdef CONFIG_BENCHMARK
+#include "benchmark/benchmark.h"
+#endif
 
 #define MAIN_THREAD_PRIO  11
 #define MAIN_THREAD_STACK 4096
@@ -15,6 +18,18 @@
 char _kernel_byte_pool_start[KERNEL_HEAP_SIZE];
 UINT _kernel_byte_pool_size = KERNEL_HEAP_SIZE;
 
+#ifdef CONFIG_MALLOC
+#define APP_HEAP_SIZE 1024*1024
+char _app_pool_byte_start[APP_HEAP_SIZE];
+UINT _app_pool_byte_size = APP_HEAP_SIZE;
+#endif
+
+#ifdef CONFIG_DMA_COHERENT
+#define DMA_COHERENT_SIZE 64*1024
+char _dma_coherent_start[DMA_COHERENT_SIZE] __rte_aligned(RTE_CACHE_LINE_SIZE);
+UINT _dma_coherent_size = DMA_COHERENT_SIZE;
+#endif
+
 static FX_MEDIA fs_media;
 static struct fs_class main_fs = {
     .mnt_point = "/home",
@@ -64,6 +79,9 @@ static void main_thread(void *arg) {
     tx_thread_preemption_change(pid, new, &old);
 
     file_test();
+#ifdef CONFIG_BENCHMARK
+    run_benchmarks();
+#endif
 
     for ( ; ; ) {
         tx_thread_sleep(TX_MSEC(10000));
@@ -13,16 +13,33 @@
 
 static char ram_blk_memory[CONFIG_RAMBLK_MEMORY_SIZE];
 
+static void
+ram_blkdev_copy(enum blkdev_request_op op, unsigned long blkno, void *buffer,
+    unsigned long blkcnt) {
+    char *p = &ram_blk_memory[blkno * CONFIG_RAMBLK_SIZE];
+
+    if (op == BLKDEV_REQ_READ)
+        memcpy(buffer, p, blkcnt * CONFIG_RAMBLK_SIZE);
+    else
+        memcpy(p, buffer, blkcnt * CONFIG_RAMBLK_SIZE);
+}
+
 static int 
 ram_blkdev_request(struct device *dev, struct blkdev_req *req) {
+    unsigned long blkno = req->blkno;
+
     switch (req->op) {
     case BLKDEV_REQ_READ:
-        memcpy(req->buffer, &ram_blk_memory[req->blkno * CONFIG_RAMBLK_SIZE], 
-            req->blkcnt * CONFIG_RAMBLK_SIZE);
-        return 0;
     case BLKDEV_REQ_WRITE:
-        memcpy(&ram_blk_memory[req->blkno * CONFIG_RAMBLK_SIZE], req->buffer, 
-            req->blkcnt * CONFIG_RAMBLK_SIZE);
+        if (req->nsegs == 0) {
+            ram_blkdev_copy(req->op, blkno, req->buffer, req->blkcnt);
+            return 0;
+        }
+        for (unsigned int i = 0; i < req->nsegs; i++) {
+            ram_blkdev_copy(req->op, blkno, req->segs[i].buffer,
+                req->segs[i].blkcnt);
+            blkno += req->segs[i].blkcnt;
+        }
         return 0;
     default:
         break;
@@ -46,21 +63,9 @@ ram_blkdev_control(struct device *dev, unsigned int cmd, void *arg) {
     }
 }
 
-static struct block_device ram_blkdev = {
+DEVICE_DEFINE(block_device, ramblk,
     .name = "ramblk",
     .request = ram_blkdev_request,
-    .control = ram_blkdev_control
-};
-
-static int ram_blkdev_int(void) {
-    int err;
-
-    err = device_register((struct device *)&ram_blkdev);
-    if (!err) {
-        pr_info("%s register success\n", ram_blkdev.name);
-    }
-    
-    return err;
-}
-
-SYSINIT(ram_blkdev_int, SI_DRIVER_LEVEL, 10);
+    .control = ram_blkdev_control,
+    .max_segs = UINT16_MAX
+);
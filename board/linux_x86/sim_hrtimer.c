@@ -0,0 +1,175 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * High resolution timer for the linux port
+ *
+ * One timer cycle is one nanosecond of CLOCK_MONOTONIC. The earliest timer
+ * is armed on a timerfd, a host thread waits on it and raises a simulated
+ * interrupt line, the timers expire in the interrupt handler like they do
+ * on the STM32 TIM2 backend. The lateness of every expiry (timerfd wakeup
+ * plus interrupt delivery) is accounted as the timer jitter.
+ */
+#define HRTIMER_SOURCE_CODE
+#define TX_USE_BOARD_PRIVATE
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tx_api.h"
+#include "basework/hrtimer_.h"
+
+struct sim_hrtimer {
+    struct hrtimer_context base;
+    struct sim_hrtimer_stat stat;
+    pthread_t pid;
+    int fd;
+};
+
+static struct sim_hrtimer sim_hrtimer = {
+    .fd = -1
+};
+
+unsigned long long sim_hrtimer_jiffies(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void load_next_event(struct sim_hrtimer *ctx, uint64_t expire) {
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    /* An all zero it_value disarms the timer */
+    if (expire == 0)
+        expire = 1;
+    its.it_value.tv_sec = expire / 1000000000ull;
+    its.it_value.tv_nsec = expire % 1000000000ull;
+    timerfd_settime(ctx->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void load_next_timer(struct sim_hrtimer *ctx, struct hrtimer *next_timer) {
+    struct itimerspec its;
+
+    if (next_timer) {
+        load_next_event(ctx, next_timer->expire);
+        return;
+    }
+
+    memset(&its, 0, sizeof(its));
+    timerfd_settime(ctx->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void sim_hrtimer_account(struct sim_hrtimer *ctx, uint64_t late) {
+    struct sim_hrtimer_stat *stat = &ctx->stat;
+
+    if (stat->count == 0 || late < stat->min)
+        stat->min = late;
+    if (late > stat->max)
+        stat->max = late;
+    stat->total += late;
+    stat->count++;
+}
+
+static void sim_hrtimer_isr(void *arg) {
+    TX_INTERRUPT_SAVE_AREA
+    struct sim_hrtimer *ctx = arg;
+    struct hrtimer *timer;
+    uint64_t now;
+
+    TX_DISABLE
+    timer = _hrtimer_first(&ctx->base);
+    if (timer) {
+        now = sim_hrtimer_jiffies();
+        if (timer->expire <= now)
+            sim_hrtimer_account(ctx, now - timer->expire);
+        _hrtimer_expire((&ctx->base), timer, now,
+            TX_RESTORE
+            routine(timer);
+            TX_DISABLE
+        );
+        load_next_timer(ctx, timer);
+    }
+    TX_RESTORE
+}
+
+static void *sim_hrtimer_thread(void *arg) {
+    struct sim_hrtimer *ctx = arg;
+    uint64_t expirations;
+
+    for ( ; ; ) {
+        if (read(ctx->fd, &expirations, sizeof(expirations)) > 0)
+            sim_irq_raise(SIM_HRTIMER_IRQ);
+    }
+    return NULL;
+}
+
+void hrtimer_init(struct hrtimer *timer) {
+    memset(timer, 0, sizeof(*timer));
+    _hrtimer_set_state(timer, HRTIMER_INACTIVE);
+}
+
+int hrtimer_start(struct hrtimer *timer, uint64_t expire) {
+    struct sim_hrtimer *ctx = &sim_hrtimer;
+    scoped_guard(os_irq) {
+        uint64_t next = sim_hrtimer_jiffies() + expire;
+        if (_hrtimer_insert(&ctx->base, timer, next))
+            load_next_event(ctx, next);
+    }
+    return 0;
+}
+
+int hrtimer_stop(struct hrtimer *timer) {
+    struct sim_hrtimer *ctx = &sim_hrtimer;
+    scoped_guard(os_irq) {
+        if (_hrtimer_remove(&ctx->base, timer))
+            load_next_timer(ctx, _hrtimer_first(&ctx->base));
+    }
+    return 0;
+}
+
+void sim_hrtimer_get_stat(struct sim_hrtimer_stat *stat) {
+    scoped_guard(os_irq) {
+        *stat = sim_hrtimer.stat;
+    }
+}
+
+void sim_hrtimer_reset_stat(void) {
+    scoped_guard(os_irq) {
+        memset(&sim_hrtimer.stat, 0, sizeof(sim_hrtimer.stat));
+    }
+}
+
+static int sim_hrtimer_init(void) {
+    struct sim_hrtimer *ctx = &sim_hrtimer;
+    int err;
+
+    ctx->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (ctx->fd < 0)
+        return -errno;
+
+    err = request_irq(SIM_HRTIMER_IRQ, sim_hrtimer_isr, ctx);
+    if (err)
+        goto _close;
+
+    if (pthread_create(&ctx->pid, NULL, sim_hrtimer_thread, ctx)) {
+        err = -ENOMEM;
+        goto _remove;
+    }
+
+    return 0;
+
+_remove:
+    remove_irq(SIM_HRTIMER_IRQ, sim_hrtimer_isr, ctx);
+_close:
+    close(ctx->fd);
+    ctx->fd = -1;
+    return err;
+}
+
+SYSINIT(sim_hrtimer_init, SI_PREDRIVER_LEVEL, 10);
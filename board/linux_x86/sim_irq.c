@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Simulated interrupt controller for the linux port
+ *
+ * Host threads (or the application) raise a line with sim_irq_raise(). The
+ * line is latched as pending and delivered by the controller thread, which
+ * enters interrupt context the same way as the port timer interrupt does.
+ * A pending line stays latched while it is disabled and is delivered once
+ * enable_irq() unmasks it, like an NVIC.
+ */
+#define TX_USE_BOARD_PRIVATE
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "tx_api.h"
+
+extern void _tx_thread_context_save(void);
+extern void _tx_thread_context_restore(void);
+
+volatile int _sim_irq_vector = -1;
+static uint8_t sim_irq_enabled[BOARD_IRQ_MAX];
+static uint8_t sim_irq_pending[BOARD_IRQ_MAX];
+static pthread_t sim_irq_pid;
+static sem_t sim_irq_sem;
+
+static void sim_irq_deliver(int irq) {
+	_tx_thread_context_save();
+	_sim_irq_vector = irq;
+	dispatch_irq();
+	_sim_irq_vector = -1;
+	_tx_thread_context_restore();
+}
+
+static void *sim_irq_thread(void *arg) {
+	(void) arg;
+
+	for ( ; ; ) {
+		while (sem_wait(&sim_irq_sem) != 0)
+			continue;
+
+		for (int irq = 0; irq < BOARD_IRQ_MAX; irq++) {
+			if (!__atomic_load_n(&sim_irq_enabled[irq], __ATOMIC_ACQUIRE))
+				continue;
+			if (__atomic_exchange_n(&sim_irq_pending[irq], 0, __ATOMIC_ACQ_REL))
+				sim_irq_deliver(irq);
+		}
+	}
+	return NULL;
+}
+
+unsigned int sim_irq_clock(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+int sim_irq_raise(int irq) {
+	if (irq < 0 || irq >= BOARD_IRQ_MAX)
+		return -EINVAL;
+
+	/* Raising a line that is already pending is a no-op, like hardware */
+	if (__atomic_exchange_n(&sim_irq_pending[irq], 1, __ATOMIC_ACQ_REL))
+		return 0;
+	if (__atomic_load_n(&sim_irq_enabled[irq], __ATOMIC_ACQUIRE))
+		sem_post(&sim_irq_sem);
+	return 0;
+}
+
+int enable_irq(int irq) {
+	if (irq < 0 || irq >= BOARD_IRQ_MAX)
+		return -EINVAL;
+
+	__atomic_store_n(&sim_irq_enabled[irq], 1, __ATOMIC_RELEASE);
+	if (__atomic_load_n(&sim_irq_pending[irq], __ATOMIC_ACQUIRE))
+		sem_post(&sim_irq_sem);
+	return 0;
+}
+
+int disable_irq(int irq) {
+	if (irq < 0 || irq >= BOARD_IRQ_MAX)
+		return -EINVAL;
+
+	__atomic_store_n(&sim_irq_enabled[irq], 0, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int sim_irq_init(void) {
+	init_irq();
+	sem_init(&sim_irq_sem, 0, 0);
+	if (pthread_create(&sim_irq_pid, NULL, sim_irq_thread, NULL))
+		return -ENOMEM;
+	return 0;
+}
+
+SYSINIT(sim_irq_init, SI_EARLY_LEVEL, 10);
@@ -46,7 +46,12 @@
 
 #define TX_MAX_PRIORITIES                       32
 #define TX_MINIMUM_STACK                        1024
+#ifdef CONFIG_MALLOC_TCACHE
+#define TX_THREAD_USER_EXTENSION                VOID *tx_thread_tcache;
+#define TX_THREAD_DELETE_EXTENSION(thread_ptr)  __general_tcache_drain(thread_ptr);
+#else
 #define TX_THREAD_USER_EXTENSION                
+#endif
 #define TX_TIMER_THREAD_STACK_SIZE              4096
 #define TX_TIMER_THREAD_PRIORITY                10
 
@@ -260,8 +265,64 @@
 #define TX_TASK_RUNNER_STACK_SIZE 1024
 #define TX_TASK_RUNNER_PRIO 12
 
+/* Threaded interrupt */
+#define TX_IRQ_THREAD_STACK_SIZE 1024
+#define TX_IRQ_THREAD_PRIO 1
+
 #define __fastcode
 #define __fastbss
 #define __fastdata
 
+/* Simulated interrupt controller (sim_irq.c) */
+int sim_irq_raise(int irq);
+unsigned int sim_irq_clock(void);
+
+/* High resolution timer (sim_hrtimer.c), one cycle is one nanosecond */
+struct sim_hrtimer_stat {
+    unsigned long long count;
+    unsigned long long min;   /* Expiry lateness in nanoseconds */
+    unsigned long long max;
+    unsigned long long total;
+};
+
+unsigned long long sim_hrtimer_jiffies(void);
+void sim_hrtimer_get_stat(struct sim_hrtimer_stat *stat);
+void sim_hrtimer_reset_stat(void);
+
+#define HRTIMER_US(n) ((n) * 1000)
+#define HRTIMER_JIFFIES sim_hrtimer_jiffies()
+#define HRTIMER_CYCLE_TO_US(n) ((n) / 1000)
+
+/*
+ * Tickless idle, the idle loop of the port stops the tick thread and
+ * sleeps until the next ThreadX timer expiry (tickless.c)
+ */
+#ifdef CONFIG_TICKLESS
+#define TX_LOW_POWER
+#define TX_LOW_POWER_TIMER_SETUP(_ticks) tickless_enter(_ticks)
+#define TX_LOW_POWER_USER_TIMER_ADJUST   tickless_exit()
+#define TX_LOW_POWER_WAKEUP_PENDING()    tickless_wakeup_pending()
+#endif
+
+/*
+ * Board private
+ */
+#ifdef TX_USE_BOARD_PRIVATE
+#define BOARD_IRQ_MAX 32
+
+extern volatile int _sim_irq_vector;
+#define IRQ_VECTOR_GET() _sim_irq_vector
+#define SIM_HRTIMER_IRQ 1
+
+/* Interrupt accounting (CLOCK_MONOTONIC nanoseconds) */
+#define IRQ_STAT_CYCLES() sim_irq_clock()
+#define IRQ_STAT_CYCLES_PER_US 1000
+
+/* Tick control for the tickless idle, the phase is in nanoseconds */
+unsigned int _tx_linux_tick_stop(void);
+void _tx_linux_tick_start(void);
+#define TICKLESS_TICK_STOP()  _tx_linux_tick_stop()
+#define TICKLESS_TICK_START() _tx_linux_tick_start()
+#endif /* TX_USE_BOARD_PRIVATE */
+
 #endif /* TX_USER_H_ */
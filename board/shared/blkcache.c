@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2024 wtcat
+ *
+ * Write-back block cache
+ *
+ * The cache blocks are kept on an LRU list and indexed by a hash table of
+ * block numbers. A write only updates the cached block and extends its
+ * dirty sector extent. A block that is not written entirely is read first,
+ * so every cached block is fully valid. Dirty blocks are written back when
+ * they are evicted or synchronized, the run of adjacent dirty blocks around
+ * them is written with one request: as a segment list when the backing
+ * device takes one, otherwise gathered into the merge buffer.
+ *
+ * Requests of two cache blocks or more bypass the cache. The cached blocks
+ * may be newer than the backing device, so they are copied over the data
+ * of a bypassed read and updated by a bypassed write.
+ */
+
+#define pr_fmt(fmt) "[blkcache]: " fmt "\n"
+#include <limits.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "drivers/blkcache.h"
+#include "basework/log.h"
+
+#define BLKCACHE_BYPASS_BLOCKS 2
+
+static inline bool blkcache_dirty(const struct blkcache_block *blk) {
+    return blk->dirty_end > blk->dirty_start;
+}
+
+/* The last cache block is short when the device size is not a multiple */
+static unsigned int blkcache_block_sectors(struct blkcache *cache,
+    unsigned long blkno) {
+    unsigned long first = blkno * cache->block_sectors;
+
+    if (cache->dev_blkcnt - first < cache->block_sectors)
+        return (unsigned int)(cache->dev_blkcnt - first);
+    return cache->block_sectors;
+}
+
+static int blkcache_dev_request(struct blkcache *cache,
+    enum blkdev_request_op op, unsigned long sector, unsigned long count,
+    void *buffer) {
+    struct blkdev_req req;
+
+    req.op     = op;
+    req.blkno  = sector;
+    req.blkcnt = count;
+    req.buffer = buffer;
+    req.nsegs  = 0;
+    if (op == BLKDEV_REQ_READ)
+        cache->stat.dev_reads++;
+    else
+        cache->stat.dev_writes++;
+    return blkdev_request(cache->backing, &req);
+}
+
+static struct blkcache_block *blkcache_lookup(struct blkcache *cache,
+    unsigned long blkno) {
+    struct blkcache_block *blk = cache->hash[blkno & cache->hash_mask];
+
+    while (blk != NULL && blk->blkno != blkno)
+        blk = blk->hnext;
+    return blk;
+}
+
+static void blkcache_hash_add(struct blkcache *cache,
+    struct blkcache_block *blk) {
+    struct blkcache_block **head = &cache->hash[blk->blkno & cache->hash_mask];
+
+    blk->hnext = *head;
+    *head = blk;
+}
+
+static void blkcache_hash_del(struct blkcache *cache,
+    struct blkcache_block *blk) {
+    struct blkcache_block **pprev = &cache->hash[blk->blkno & cache->hash_mask];
+
+    while (*pprev != blk)
+        pprev = &(*pprev)->hnext;
+    *pprev = blk->hnext;
+}
+
+/*
+ * Write back the run of adjacent dirty blocks around @blk. Blocks join the
+ * run when their dirty extents meet at the block boundary.
+ */
+static int blkcache_writeback(struct blkcache *cache,
+    struct blkcache_block *blk) {
+    struct blkdev_seg *segs = cache->segs;
+    struct blkcache_block *first = blk, *last = blk, *b;
+    struct blkdev_req req;
+    unsigned int n = 1;
+    int err;
+
+    while (n < cache->merge_max && first->dirty_start == 0 && first->blkno > 0) {
+        b = blkcache_lookup(cache, first->blkno - 1);
+        if (b == NULL || !blkcache_dirty(b) || b->dirty_end != cache->block_sectors)
+            break;
+        first = b;
+        n++;
+    }
+    while (n < cache->merge_max && last->dirty_end == cache->block_sectors) {
+        b = blkcache_lookup(cache, last->blkno + 1);
+        if (b == NULL || !blkcache_dirty(b) || b->dirty_start != 0)
+            break;
+        last = b;
+        n++;
+    }
+
+    req.op = BLKDEV_REQ_WRITE;
+    req.blkno = first->blkno * cache->block_sectors + first->dirty_start;
+    req.blkcnt = 0;
+    req.buffer = NULL;
+    req.nsegs = 0;
+    if (n == 1) {
+        req.buffer = blk->data + blk->dirty_start * cache->sector_size;
+        req.blkcnt = blk->dirty_end - blk->dirty_start;
+    } else if (n <= ((struct block_device *)cache->backing)->max_segs) {
+        /* The backing device takes the dirty extents as a segment list */
+        for (unsigned long blkno = first->blkno; blkno <= last->blkno; blkno++) {
+            b = blkcache_lookup(cache, blkno);
+            segs[req.nsegs].buffer = b->data + b->dirty_start * cache->sector_size;
+            segs[req.nsegs].blkcnt = b->dirty_end - b->dirty_start;
+            req.blkcnt += segs[req.nsegs].blkcnt;
+            req.nsegs++;
+        }
+        req.segs = segs;
+    } else {
+        req.buffer = cache->merge_buffer;
+        for (unsigned long blkno = first->blkno; blkno <= last->blkno; blkno++) {
+            b = blkcache_lookup(cache, blkno);
+            memcpy(cache->merge_buffer + req.blkcnt * cache->sector_size,
+                b->data + b->dirty_start * cache->sector_size,
+                (b->dirty_end - b->dirty_start) * cache->sector_size);
+            req.blkcnt += b->dirty_end - b->dirty_start;
+        }
+    }
+
+    cache->stat.dev_writes++;
+    err = blkdev_request(cache->backing, &req);
+    if (err) {
+        pr_err("write back sector %lu (%lu) failed (%d)", req.blkno, req.blkcnt, err);
+        return err;
+    }
+
+    for (unsigned long blkno = first->blkno; blkno <= last->blkno; blkno++) {
+        b = blkcache_lookup(cache, blkno);
+        b->dirty_start = b->dirty_end = 0;
+    }
+    cache->stat.writebacks += n;
+    cache->stat.merged += n - 1;
+    return 0;
+}
+
+static void blkcache_touch(struct blkcache *cache, struct blkcache_block *blk) {
+    rte_list_del(&blk->lru);
+    rte_list_add(&blk->lru, &cache->lru);
+}
+
+/*
+ * Take the least recently used block for reuse. A dirty block that fails
+ * to be written back stays cached and moves to the head of the LRU, so one
+ * bad sector does not fail every later miss.
+ */
+static int blkcache_evict(struct blkcache *cache,
+    struct blkcache_block **pblk) {
+    int err = 0;
+
+    for (unsigned int i = 0; i < cache->nr_blocks; i++) {
+        struct blkcache_block *blk = rte_container_of(cache->lru.prev,
+            struct blkcache_block, lru);
+
+        if (blkcache_dirty(blk)) {
+            err = blkcache_writeback(cache, blk);
+            if (err) {
+                blkcache_touch(cache, blk);
+                continue;
+            }
+        }
+        if (blk->valid) {
+            blkcache_hash_del(cache, blk);
+            blk->valid = false;
+        }
+        *pblk = blk;
+        return 0;
+    }
+    return err;
+}
+
+/*
+ * Get cache block @blkno, the least recently used block is reused on a
+ * miss. Its data is read from the device when @fill is set.
+ */
+static int blkcache_get(struct blkcache *cache, unsigned long blkno,
+    bool fill, struct blkcache_block **pblk) {
+    struct blkcache_block *blk;
+    int err;
+
+    blk = blkcache_lookup(cache, blkno);
+    if (blk != NULL) {
+        cache->stat.hits++;
+        blkcache_touch(cache, blk);
+        *pblk = blk;
+        return 0;
+    }
+
+    cache->stat.misses++;
+    err = blkcache_evict(cache, &blk);
+    if (err)
+        return err;
+
+    if (fill) {
+        err = blkcache_dev_request(cache, BLKDEV_REQ_READ,
+            blkno * cache->block_sectors, blkcache_block_sectors(cache, blkno),
+            blk->data);
+        if (err)
+            return err;
+    }
+
+    blk->blkno = blkno;
+    blk->valid = true;
+    blkcache_hash_add(cache, blk);
+    blkcache_touch(cache, blk);
+    *pblk = blk;
+    return 0;
+}
+
+/*
+ * Copy the cached blocks over the data of a bypassed read, or update them
+ * with the data of a bypassed write.
+ */
+static void blkcache_bypass_sync(struct blkcache *cache, unsigned long sector,
+    unsigned long count, uint8_t *buffer, bool write) {
+    unsigned long end = sector + count;
+
+    while (sector < end) {
+        unsigned long blkno = sector / cache->block_sectors;
+        unsigned int offset = sector % cache->block_sectors;
+        unsigned int n = cache->block_sectors - offset;
+        struct blkcache_block *blk;
+
+        if (n > end - sector)
+            n = (unsigned int)(end - sector);
+
+        blk = blkcache_lookup(cache, blkno);
+        if (blk != NULL) {
+            uint8_t *data = blk->data + offset * cache->sector_size;
+
+            if (!write) {
+                memcpy(buffer, data, n * cache->sector_size);
+            } else {
+                memcpy(data, buffer, n * cache->sector_size);
+                /* The device is up to date when the block was overwritten */
+                if (offset == 0 && n == blkcache_block_sectors(cache, blkno))
+                    blk->dirty_start = blk->dirty_end = 0;
+            }
+        }
+
+        buffer += n * cache->sector_size;
+        sector += n;
+    }
+}
+
+static int blkcache_read(struct blkcache *cache, unsigned long sector,
+    unsigned long count, uint8_t *buffer) {
+    unsigned long end = sector + count;
+    int err;
+
+    if (count >= BLKCACHE_BYPASS_BLOCKS * cache->block_sectors) {
+        err = blkcache_dev_request(cache, BLKDEV_REQ_READ, sector, count, buffer);
+        if (!err)
+            blkcache_bypass_sync(cache, sector, count, buffer, false);
+        return err;
+    }
+
+    while (sector < end) {
+        unsigned long blkno = sector / cache->block_sectors;
+        unsigned int offset = sector % cache->block_sectors;
+        unsigned int n = cache->block_sectors - offset;
+        struct blkcache_block *blk;
+
+        if (n > end - sector)
+            n = (unsigned int)(end - sector);
+
+        err = blkcache_get(cache, blkno, true, &blk);
+        if (err)
+            return err;
+
+        memcpy(buffer, blk->data + offset * cache->sector_size,
+            n * cache->sector_size);
+        buffer += n * cache->sector_size;
+        sector += n;
+    }
+    return 0;
+}
+
+static int blkcache_write(struct blkcache *cache, unsigned long sector,
+    unsigned long count, uint8_t *buffer) {
+    unsigned long end = sector + count;
+    int err;
+
+    if (count >= BLKCACHE_BYPASS_BLOCKS * cache->block_sectors) {
+        err = blkcache_dev_request(cache, BLKDEV_REQ_WRITE, sector, count, buffer);
+        if (!err)
+            blkcache_bypass_sync(cache, sector, count, buffer, true);
+        return err;
+    }
+
+    while (sector < end) {
+        unsigned long blkno = sector / cache->block_sectors;
+        unsigned int offset = sector % cache->block_sectors;
+        unsigned int n = cache->block_sectors - offset;
+        struct blkcache_block *blk;
+        bool fill;
+
+        if (n > end - sector)
+            n = (unsigned int)(end - sector);
+
+        fill = offset != 0 || n != blkcache_block_sectors(cache, blkno);
+        err = blkcache_get(cache, blkno, fill, &blk);
+        if (err)
+            return err;
+
+        memcpy(blk->data + offset * cache->sector_size, buffer,
+            n * cache->sector_size);
+        if (!blkcache_dirty(blk)) {
+            blk->dirty_start = offset;
+            blk->dirty_end = offset + n;
+        } else {
+            if (offset < blk->dirty_start)
+                blk->dirty_start = offset;
+            if (offset + n > blk->dirty_end)
+                blk->dirty_end = offset + n;
+        }
+
+        buffer += n * cache->sector_size;
+        sector += n;
+    }
+    return 0;
+}
+
+static int blkcache_flush_locked(struct blkcache *cache) {
+    int ret = 0;
+
+    for (unsigned int i = 0; i < cache->nr_blocks; i++) {
+        struct blkcache_block *blk = &cache->blocks[i];
+
+        if (blkcache_dirty(blk)) {
+            int err = blkcache_writeback(cache, blk);
+            if (err)
+                ret = err;
+        }
+    }
+    return ret;
+}
+
+int blkcache_flush(struct blkcache *cache) {
+    guard(os_mutex)(&cache->mtx);
+    return blkcache_flush_locked(cache);
+}
+
+static int blkcache_sync(struct blkcache *cache) {
+    int err;
+
+    err = blkcache_flush(cache);
+    if (err)
+        return err;
+
+    /* Backing devices without a write cache do not implement it */
+    err = device_control(cache->backing, BLKDEV_IOC_SYNC, NULL);
+    if (err == -ENOTSUP || err == -ENOSYS || err == -EINVAL)
+        err = 0;
+    return err;
+}
+
+static int blkcache_request(struct device *dev, struct blkdev_req *req) {
+    struct blkcache *cache = dev_get_private(dev);
+
+    if (req->op == BLKDEV_REQ_SYNC)
+        return blkcache_sync(cache);
+
+    if (req->blkcnt == 0 || req->blkno >= cache->dev_blkcnt ||
+        req->blkcnt > cache->dev_blkcnt - req->blkno)
+        return -EINVAL;
+
+    guard(os_mutex)(&cache->mtx);
+    switch (req->op) {
+    case BLKDEV_REQ_READ:
+        return blkcache_read(cache, req->blkno, req->blkcnt, req->buffer);
+    case BLKDEV_REQ_WRITE:
+        return blkcache_write(cache, req->blkno, req->blkcnt, req->buffer);
+    default:
+        break;
+    }
+    return -EINVAL;
+}
+
+static int blkcache_control(struct device *dev, unsigned int cmd, void *arg) {
+    struct blkcache *cache = dev_get_private(dev);
+
+    switch (cmd) {
+    case BLKDEV_IOC_SYNC:
+        return blkcache_sync(cache);
+    default:
+        /* The geometry is the one of the backing device */
+        return device_control(cache->backing, cmd, arg);
+    }
+}
+
+static inline uint8_t *blkcache_align(uint8_t *p) {
+    return (uint8_t *)(((uintptr_t)p + sizeof(void *) - 1) & ~(sizeof(void *) - 1));
+}
+
+int blkcache_init(struct blkcache *cache, const char *name,
+    struct device *backing, void *buffer, size_t size,
+    unsigned int block_sectors) {
+    size_t block_size, merge_size, per_block;
+    unsigned int nr_blocks, hash_size;
+    UINT sector_size = 0, blkcnt = 0;
+    uint8_t *p;
+    int err;
+
+    if (cache == NULL || name == NULL || backing == NULL || buffer == NULL ||
+        block_sectors == 0 || block_sectors > UINT16_MAX)
+        return -EINVAL;
+
+    if (device_control(backing, BLKDEV_IOC_GET_BLKSIZE, &sector_size) ||
+        sector_size == 0)
+        return -EINVAL;
+
+    memset(cache, 0, sizeof(*cache));
+    if (device_control(backing, BLKDEV_IOC_GET_BLKCOUNT, &blkcnt) || blkcnt == 0)
+        cache->dev_blkcnt = ULONG_MAX;
+    else
+        cache->dev_blkcnt = blkcnt;
+
+    block_size = (size_t)sector_size * block_sectors;
+    merge_size = (CONFIG_BLKCACHE_MERGE_MAX > 1)?
+        CONFIG_BLKCACHE_MERGE_MAX * block_size: 0;
+    per_block = block_size + sizeof(struct blkcache_block) +
+        sizeof(struct blkcache_block *);
+
+    p = blkcache_align(buffer);
+    size -= p - (uint8_t *)buffer;
+    if (size < merge_size + sizeof(void *) + 2 * per_block)
+        return -ENOMEM;
+
+    nr_blocks = (size - merge_size - sizeof(void *)) / per_block;
+    for (hash_size = 1; hash_size * 2 <= nr_blocks; hash_size <<= 1);
+
+    /* Layout: block data, merge buffer, block descriptors, hash table */
+    cache->merge_buffer = p + nr_blocks * block_size;
+    cache->blocks = (struct blkcache_block *)blkcache_align(
+        cache->merge_buffer + merge_size);
+    cache->hash = (struct blkcache_block **)(cache->blocks + nr_blocks);
+    memset(cache->blocks, 0, nr_blocks * sizeof(struct blkcache_block) +
+        hash_size * sizeof(struct blkcache_block *));
+
+    RTE_INIT_LIST(&cache->lru);
+    for (unsigned int i = 0; i < nr_blocks; i++) {
+        cache->blocks[i].data = p + i * block_size;
+        rte_list_add_tail(&cache->blocks[i].lru, &cache->lru);
+    }
+
+    cache->backing = backing;
+    cache->nr_blocks = nr_blocks;
+    cache->hash_mask = hash_size - 1;
+    cache->sector_size = sector_size;
+    cache->block_sectors = block_sectors;
+    cache->merge_max = (CONFIG_BLKCACHE_MERGE_MAX > 1)? CONFIG_BLKCACHE_MERGE_MAX: 1;
+    tx_mutex_create(&cache->mtx, (CHAR *)"blkcache", TX_INHERIT);
+
+    cache->blkdev.name = name;
+    cache->blkdev.private_data = cache;
+    cache->blkdev.request = blkcache_request;
+    cache->blkdev.control = blkcache_control;
+    err = device_register((struct device *)&cache->blkdev);
+    if (err) {
+        tx_mutex_delete(&cache->mtx);
+        return err;
+    }
+
+    pr_info("%s over %s: %u blocks of %u bytes", name, backing->name,
+        nr_blocks, (unsigned int)block_size);
+    return 0;
+}
+
+int blkcache_deinit(struct blkcache *cache) {
+    int err;
+
+    err = blkcache_sync(cache);
+    if (err)
+        return err;
+
+    device_unregister((struct device *)&cache->blkdev);
+    tx_mutex_delete(&cache->mtx);
+    return 0;
+}
+
+void blkcache_get_stat(struct blkcache *cache, struct blkcache_stat *stat) {
+    guard(os_mutex)(&cache->mtx);
+    *stat = cache->stat;
+}
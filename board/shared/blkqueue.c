@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2024 wtcat
+ *
+ * Block request queue
+ *
+ * Submitters append to the pending list under the queue mutex and wake
+ * the worker. The worker owns the transfer slots: it reaps the completed
+ * ones, calls the completion of their requests, and dispatches the head
+ * of the pending list as long as a slot is free and the head does not
+ * overlap an in-flight write. A completion only marks its slot done and
+ * wakes the worker, so drivers may complete from interrupt context.
+ *
+ * While the transfers are in flight the pending list grows, which is when
+ * the contiguous requests get merged.
+ */
+
+#define pr_fmt(fmt) "[blkqueue]: " fmt "\n"
+#include <limits.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "drivers/blkqueue.h"
+#include "basework/log.h"
+
+enum blkqueue_rq_state {
+    BLKQUEUE_RQ_FREE,
+    BLKQUEUE_RQ_BUSY,
+    BLKQUEUE_RQ_DONE
+};
+
+struct blkqueue_waiter {
+    struct blkdev_areq areq;
+    TX_SEMAPHORE sem;
+    int err;
+};
+
+static inline uint8_t blkqueue_rq_state(struct blkqueue_rq *rq) {
+    return __atomic_load_n(&rq->state, __ATOMIC_ACQUIRE);
+}
+
+/* Two requests must stay in order when they overlap and one is a write */
+static bool blkqueue_conflict(const struct blkdev_req *a,
+    const struct blkdev_req *b) {
+    if (a->op == BLKDEV_REQ_SYNC || b->op == BLKDEV_REQ_SYNC)
+        return true;
+    if (a->op == BLKDEV_REQ_READ && b->op == BLKDEV_REQ_READ)
+        return false;
+    return a->blkno < b->blkno + b->blkcnt && b->blkno < a->blkno + a->blkcnt;
+}
+
+static bool blkqueue_conflict_inflight(struct blkqueue *q,
+    const struct blkdev_req *req) {
+    for (unsigned int i = 0; i < q->nr_slots; i++) {
+        struct blkqueue_rq *rq = &q->slots[i];
+
+        if (blkqueue_rq_state(rq) != BLKQUEUE_RQ_FREE &&
+            blkqueue_conflict(&rq->req, req))
+            return true;
+    }
+    return false;
+}
+
+/* @areq may move ahead of the pending requests queued before it */
+static bool blkqueue_can_pass(struct blkqueue *q, struct blkdev_areq *areq) {
+    struct blkdev_areq *it;
+
+    rte_list_foreach_entry(it, &q->pending, node) {
+        if (it == areq)
+            return true;
+        if (blkqueue_conflict(&it->req, &areq->req))
+            return false;
+    }
+    return true;
+}
+
+static bool blkqueue_mergeable(const struct blkdev_areq *areq) {
+    return areq->req.op != BLKDEV_REQ_SYNC && areq->req.nsegs == 0;
+}
+
+/*
+ * Take @head off the pending list with the requests that extend it on
+ * either side. Must be called with the queue mutex held.
+ */
+static void blkqueue_merge(struct blkqueue *q, struct blkqueue_rq *rq,
+    struct blkdev_areq *head) {
+    unsigned long blkno = head->req.blkno;
+    unsigned long end = blkno + head->req.blkcnt;
+    struct blkdev_areq *it;
+    bool merged;
+
+    rte_list_del(&head->node);
+    rq->members[0] = head;
+    rq->nr_members = 1;
+    if (!blkqueue_mergeable(head))
+        return;
+
+    do {
+        merged = false;
+        rte_list_foreach_entry(it, &q->pending, node) {
+            bool back, front;
+
+            if (rq->nr_members >= q->max_merge || end - blkno >= q->max_blocks)
+                return;
+            if (!blkqueue_mergeable(it) || it->req.op != head->req.op ||
+                it->req.blkcnt > q->max_blocks - (end - blkno))
+                continue;
+
+            back = it->req.blkno == end;
+            front = it->req.blkno + it->req.blkcnt == blkno;
+            if (!back && !front)
+                continue;
+            if (!blkqueue_can_pass(q, it) || blkqueue_conflict_inflight(q, &it->req))
+                continue;
+
+            rte_list_del(&it->node);
+            if (back) {
+                rq->members[rq->nr_members] = it;
+                end += it->req.blkcnt;
+            } else {
+                memmove(&rq->members[1], &rq->members[0],
+                    rq->nr_members * sizeof(rq->members[0]));
+                rq->members[0] = it;
+                blkno = it->req.blkno;
+            }
+            rq->nr_members++;
+            merged = true;
+            break;
+        }
+    } while (merged);
+}
+
+/*
+ * Build the transfer of @rq and mark its slot busy. Must be called with the
+ * queue mutex held, blkqueue_conflicts() looks at the in-flight requests.
+ */
+static void blkqueue_prepare(struct blkqueue_rq *rq) {
+    if (rq->nr_members == 1) {
+        rq->req = rq->members[0]->req;
+    } else {
+        rq->req.op = rq->members[0]->req.op;
+        rq->req.blkno = rq->members[0]->req.blkno;
+        rq->req.blkcnt = 0;
+        rq->req.buffer = NULL;
+        for (unsigned int i = 0; i < rq->nr_members; i++) {
+            rq->segs[i].buffer = rq->members[i]->req.buffer;
+            rq->segs[i].blkcnt = rq->members[i]->req.blkcnt;
+            rq->req.blkcnt += rq->segs[i].blkcnt;
+        }
+        rq->req.segs = rq->segs;
+        rq->req.nsegs = rq->nr_members;
+    }
+    rq->state = BLKQUEUE_RQ_BUSY;
+}
+
+static void blkqueue_start(struct blkqueue *q, struct blkqueue_rq *rq) {
+    int err;
+
+    err = q->transfer(q->dev, &rq->req);
+    if (!(q->flags & BLKQUEUE_F_ASYNC) || err)
+        blkqueue_complete(&rq->req, err);
+}
+
+static struct blkqueue_rq *blkqueue_free_slot(struct blkqueue *q) {
+    for (unsigned int i = 0; i < q->nr_slots; i++) {
+        if (blkqueue_rq_state(&q->slots[i]) == BLKQUEUE_RQ_FREE)
+            return &q->slots[i];
+    }
+    return NULL;
+}
+
+static bool blkqueue_dispatch(struct blkqueue *q) {
+    bool dispatched = false;
+
+    for ( ; ; ) {
+        struct blkqueue_rq *rq = blkqueue_free_slot(q);
+        struct blkdev_areq *head;
+
+        if (rq == NULL)
+            break;
+
+        tx_mutex_get(&q->mtx, TX_WAIT_FOREVER);
+        if (rte_list_empty(&q->pending)) {
+            tx_mutex_put(&q->mtx);
+            break;
+        }
+
+        /* A sync request is a barrier */
+        head = rte_list_first_entry(&q->pending, struct blkdev_areq, node);
+        if ((head->req.op == BLKDEV_REQ_SYNC && q->inflight > 0) ||
+            blkqueue_conflict_inflight(q, &head->req)) {
+            tx_mutex_put(&q->mtx);
+            break;
+        }
+        blkqueue_merge(q, rq, head);
+        blkqueue_prepare(rq);
+        q->inflight++;
+        q->stat.dispatched++;
+        q->stat.merged += rq->nr_members - 1;
+        if (q->inflight > q->stat.max_inflight)
+            q->stat.max_inflight = q->inflight;
+        tx_mutex_put(&q->mtx);
+
+        blkqueue_start(q, rq);
+        dispatched = true;
+    }
+
+    return dispatched;
+}
+
+static bool blkqueue_reap(struct blkqueue *q) {
+    bool reaped = false;
+
+    for (unsigned int i = 0; i < q->nr_slots; i++) {
+        struct blkqueue_rq *rq = &q->slots[i];
+
+        if (blkqueue_rq_state(rq) != BLKQUEUE_RQ_DONE)
+            continue;
+
+        /* The queue is idle for blkqueue_destroy() once the last one is done */
+        tx_mutex_get(&q->mtx, TX_WAIT_FOREVER);
+        q->inflight--;
+        tx_mutex_put(&q->mtx);
+        for (unsigned int n = 0; n < rq->nr_members; n++)
+            rq->members[n]->done(rq->members[n], rq->err);
+        rq->state = BLKQUEUE_RQ_FREE;
+        reaped = true;
+    }
+    return reaped;
+}
+
+static void blkqueue_thread(void *arg) {
+    struct blkqueue *q = arg;
+
+    for ( ; ; ) {
+        bool progress = blkqueue_reap(q);
+
+        if (blkqueue_dispatch(q))
+            progress = true;
+        if (!progress)
+            tx_semaphore_get(&q->sem, TX_WAIT_FOREVER);
+    }
+}
+
+void blkqueue_complete(struct blkdev_req *req, int err) {
+    struct blkqueue_rq *rq = rte_container_of(req, struct blkqueue_rq, req);
+
+    rq->err = err;
+    __atomic_store_n(&rq->state, BLKQUEUE_RQ_DONE, __ATOMIC_RELEASE);
+    tx_semaphore_ceiling_put(&rq->queue->sem, 1);
+}
+
+int blkqueue_submit(struct blkqueue *q, struct blkdev_areq *areq) {
+    struct block_device *bdev;
+
+    if (q == NULL || areq == NULL || areq->done == NULL)
+        return -EINVAL;
+
+    bdev = (struct block_device *)q->dev;
+    if (areq->req.op != BLKDEV_REQ_SYNC &&
+        (areq->req.blkcnt == 0 || areq->req.nsegs > bdev->max_segs))
+        return -EINVAL;
+
+    tx_mutex_get(&q->mtx, TX_WAIT_FOREVER);
+    rte_list_add_tail(&areq->node, &q->pending);
+    q->stat.submitted++;
+    tx_mutex_put(&q->mtx);
+    tx_semaphore_ceiling_put(&q->sem, 1);
+    return 0;
+}
+
+static void blkqueue_wakeup(struct blkdev_areq *areq, int err) {
+    struct blkqueue_waiter *w = rte_container_of(areq,
+        struct blkqueue_waiter, areq);
+
+    w->err = err;
+    tx_semaphore_put(&w->sem);
+}
+
+int blkqueue_request(struct blkqueue *q, struct blkdev_req *req) {
+    struct blkqueue_waiter w;
+    int err;
+
+    w.areq.req = *req;
+    w.areq.done = blkqueue_wakeup;
+    w.err = 0;
+    tx_semaphore_create(&w.sem, (CHAR *)"blkreq", 0);
+    err = blkqueue_submit(q, &w.areq);
+    if (!err) {
+        tx_semaphore_get(&w.sem, TX_WAIT_FOREVER);
+        err = w.err;
+    }
+    tx_semaphore_delete(&w.sem);
+    return err;
+}
+
+bool blkqueue_conflicts(struct blkqueue *q, const struct blkdev_req *req) {
+    struct blkdev_areq *it;
+
+    guard(os_mutex)(&q->mtx);
+    if (blkqueue_conflict_inflight(q, req))
+        return true;
+    rte_list_foreach_entry(it, &q->pending, node) {
+        if (blkqueue_conflict(&it->req, req))
+            return true;
+    }
+    return false;
+}
+
+int blkqueue_init(struct blkqueue *q, struct device *dev,
+    const struct blkqueue_config *cfg) {
+    struct block_device *bdev = (struct block_device *)dev;
+    unsigned int max_merge;
+
+    if (q == NULL || dev == NULL || cfg == NULL || cfg->transfer == NULL ||
+        cfg->slots == NULL || cfg->nr_slots == 0 || cfg->stack == NULL)
+        return -EINVAL;
+
+    /* Merged requests are passed as segment lists */
+    max_merge = CONFIG_BLKQUEUE_MAX_SEGS;
+    if (bdev->max_segs < max_merge)
+        max_merge = bdev->max_segs;
+    if (max_merge == 0)
+        max_merge = 1;
+
+    memset(q, 0, sizeof(*q));
+    RTE_INIT_LIST(&q->pending);
+    q->dev = dev;
+    q->transfer = cfg->transfer;
+    q->flags = cfg->flags;
+    q->slots = cfg->slots;
+    q->nr_slots = cfg->nr_slots;
+    q->max_merge = max_merge;
+    q->max_blocks = cfg->max_blocks? cfg->max_blocks: ULONG_MAX;
+    for (unsigned int i = 0; i < cfg->nr_slots; i++) {
+        memset(&q->slots[i], 0, sizeof(q->slots[i]));
+        q->slots[i].queue = q;
+    }
+
+    tx_mutex_create(&q->mtx, (CHAR *)cfg->name, TX_INHERIT);
+    tx_semaphore_create(&q->sem, (CHAR *)cfg->name, 0);
+    tx_thread_spawn(&q->thread, cfg->name, blkqueue_thread, q, cfg->stack,
+        cfg->stack_size, cfg->prio, cfg->prio, TX_NO_TIME_SLICE, TX_AUTO_START);
+    bdev->queue = q;
+    return 0;
+}
+
+int blkqueue_destroy(struct blkqueue *q) {
+    struct blkdev_req barrier = {
+        .op = BLKDEV_REQ_SYNC
+    };
+    bool idle;
+
+    if (q == NULL)
+        return -EINVAL;
+
+    /*
+     * Wait for the queued requests, then send the new ones to the driver.
+     * The barrier is repeated as long as requests queued behind it remain.
+     */
+    do {
+        blkqueue_request(q, &barrier);
+        tx_mutex_get(&q->mtx, TX_WAIT_FOREVER);
+        idle = rte_list_empty(&q->pending) && q->inflight == 0;
+        if (idle)
+            ((struct block_device *)q->dev)->queue = NULL;
+        tx_mutex_put(&q->mtx);
+    } while (!idle);
+
+    tx_thread_terminate(&q->thread);
+    tx_thread_delete(&q->thread);
+    tx_semaphore_delete(&q->sem);
+    tx_mutex_delete(&q->mtx);
+    return 0;
+}
+
+void blkqueue_get_stat(struct blkqueue *q, struct blkqueue_stat *stat) {
+    guard(os_mutex)(&q->mtx);
+    *stat = q->stat;
+}
@@ -1,5 +1,20 @@
 /*
  * Copyright (c) 2024 wtcat
+ *
+ * Device registry
+ *
+ * Names are indexed by a hash table of singly linked chains. Writers are
+ * serialized by the mutex and publish a device with a release store after
+ * it is fully linked, so device_find() walks the chains without any lock.
+ * An unregistered device keeps its chain link, a reader that is standing
+ * on it still reaches the rest of the chain.
+ *
+ * Readers are counted in one of two epochs. device_unregister() switches
+ * the epoch after unlinking and waits for the readers of the previous one,
+ * no lookup can reach the device once it returns and the memory can be
+ * released. New lookups go to the other epoch and can not starve it. The
+ * handle returned by device_find() is still only valid while its owner
+ * keeps the device registered.
  */
 
 #include <errno.h>
@@ -7,44 +22,92 @@
 
 #include "tx_api.h"
 
+#ifndef CONFIG_DEVICE_HASH_SIZE
+#define CONFIG_DEVICE_HASH_SIZE 64
+#endif
 
-static STAILQ_HEAD(, device) dev_list;	
+#define DEVICE_HASH_MASK (CONFIG_DEVICE_HASH_SIZE - 1)
+
+_Static_assert((CONFIG_DEVICE_HASH_SIZE & DEVICE_HASH_MASK) == 0,
+    "CONFIG_DEVICE_HASH_SIZE must be a power of 2");
+
+LINKER_ROSET(device, struct device_item);
+
+static STAILQ_HEAD(, device) dev_list;
 static TX_MUTEX dev_mutex;
+static struct device *dev_hash[CONFIG_DEVICE_HASH_SIZE];
+static unsigned int dev_epoch;
+static unsigned int dev_readers[2];
 
-static struct device *device_find_locked(const char *name) {
+static struct device *device_hash_find(const char *name, uint32_t hash) {
     struct device *dev;
 
-    STAILQ_FOREACH(dev, &dev_list, link) {
-        if (!strcmp(name, dev->name))
+    dev = __atomic_load_n(&dev_hash[hash & DEVICE_HASH_MASK], __ATOMIC_ACQUIRE);
+    while (dev != NULL) {
+        if (dev->hash == hash && !strcmp(name, dev->name))
             return dev;
+        dev = __atomic_load_n(&dev->hnext, __ATOMIC_ACQUIRE);
     }
     return NULL;
 }
 
 struct device *device_find(const char *name) {
+    struct device *dev;
+    unsigned int idx;
+
     if (name == NULL)
         return NULL;
 
-    guard(os_mutex)(&dev_mutex);
-    return device_find_locked(name);
+    idx = __atomic_load_n(&dev_epoch, __ATOMIC_ACQUIRE) & 1;
+    __atomic_add_fetch(&dev_readers[idx], 1, __ATOMIC_SEQ_CST);
+    dev = device_hash_find(name, device_name_hash(name));
+    __atomic_sub_fetch(&dev_readers[idx], 1, __ATOMIC_RELEASE);
+    return dev;
 }
 
-int device_register(struct device *dev) {
-    if (dev == NULL)
-        return -EINVAL;
+/* 
+ * Must be called with dev_mutex held. A reader may have sampled the epoch
+ * before a previous switch, so both counters are drained in turn.
+ */
+static void device_wait_readers(void) {
+    for (int i = 0; i < 2; i++) {
+        unsigned int idx = dev_epoch & 1;
+
+        __atomic_store_n(&dev_epoch, dev_epoch + 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&dev_readers[idx], __ATOMIC_ACQUIRE) != 0)
+            tx_thread_sleep(1);
+    }
+}
+
+/* Must be called with dev_mutex held */
+static int device_insert_locked(struct device *dev) {
+    struct device **head;
 
-    guard(os_mutex)(&dev_mutex);
     if (dev->name == NULL)
         return -EINVAL;
 
-    if (device_find_locked(dev->name))
+    dev->hash = device_name_hash(dev->name);
+    if (device_hash_find(dev->name, dev->hash))
         return -EEXIST;
 
+    head = &dev_hash[dev->hash & DEVICE_HASH_MASK];
+    dev->hnext = *head;
+    __atomic_store_n(head, dev, __ATOMIC_RELEASE);
     STAILQ_INSERT_TAIL(&dev_list, dev, link);
     return 0;
 }
 
+int device_register(struct device *dev) {
+    if (dev == NULL)
+        return -EINVAL;
+
+    guard(os_mutex)(&dev_mutex);
+    return device_insert_locked(dev);
+}
+
 int device_unregister(struct device *dev) {
+    struct device **pprev;
+
     if (dev == NULL)
         return -EINVAL;
 
@@ -52,9 +115,15 @@ int device_unregister(struct device *dev) {
     if (dev->name == NULL)
         return -EINVAL;
 
-    if (device_find_locked(dev->name)) {
-        STAILQ_REMOVE(&dev_list, dev, device, link);
-        return 0;
+    pprev = &dev_hash[dev->hash & DEVICE_HASH_MASK];
+    while (*pprev != NULL) {
+        if (*pprev == dev) {
+            __atomic_store_n(pprev, dev->hnext, __ATOMIC_RELEASE);
+            STAILQ_REMOVE(&dev_list, dev, device, link);
+            device_wait_readers();
+            return 0;
+        }
+        pprev = &(*pprev)->hnext;
     }
 
     return -ENODEV;
@@ -76,6 +145,12 @@ void device_foreach(bool (*iterator)(struct device *, void *), void *user) {
 static int device_init(void) {
     STAILQ_INIT(&dev_list);
     tx_mutex_create(&dev_mutex, "device", TX_INHERIT);
+
+    /* Devices defined with DEVICE_DEFINE() */
+    LINKER_SET_FOREACH(device, item, struct device_item) {
+        if (device_insert_locked(item->dev))
+            printk("device: failed to register %s\n", item->dev->name);
+    }
     return 0;
 }
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * DMA coherent memory allocator
+ *
+ * A binary buddy allocator over a dedicated linker-defined region. The 
+ * region is mapped non-cacheable on targets with a data cache (the board 
+ * must set up MPU), so the CPU and DMA masters always see the same data.
+ * The minimum block is one cache line and every block is aligned to its
+ * own size relative to the region base, so buffers never share a cache
+ * line with other data.
+ */
+
+#include <errno.h>
+#include "tx_api.h"
+
+#include "basework/assert.h"
+
+extern char _dma_coherent_start[];
+#ifndef CONFIG_SIMULATOR
+extern char _dma_coherent_size[];
+#else
+extern UINT _dma_coherent_size;
+#endif /* CONFIG_SIMULATOR */
+
+#define DMA_MIN_SHIFT   5
+#define DMA_MIN_SIZE    (1u << DMA_MIN_SHIFT)
+#define DMA_MAX_ORDER   16
+#define DMA_BLOCK_FREE  0x80
+#define DMA_BLOCK_BODY  0x40
+
+_Static_assert(DMA_MIN_SIZE >= RTE_CACHE_LINE_SIZE, "");
+
+struct dma_block {
+    struct rte_list node;
+};
+
+struct dma_zone {
+    char *base;
+    size_t nblocks;
+    uint8_t *order_map;
+    struct rte_list free_list[DMA_MAX_ORDER];
+    size_t free_size;
+    size_t min_free;
+};
+
+static struct dma_zone dma_zone;
+
+static inline size_t block_index(struct dma_zone *z, void *p) {
+    return (size_t)((char *)p - z->base) >> DMA_MIN_SHIFT;
+}
+
+static inline struct dma_block *index_block(struct dma_zone *z, size_t idx) {
+    return (struct dma_block *)(z->base + (idx << DMA_MIN_SHIFT));
+}
+
+static inline unsigned int size_to_order(size_t size) {
+    unsigned int order = 0;
+
+    while (((size_t)DMA_MIN_SIZE << order) < size)
+        order++;
+    return order;
+}
+
+static void block_mark(struct dma_zone *z, size_t idx, unsigned int order, 
+    uint8_t flags) {
+    z->order_map[idx] = (uint8_t)order | flags;
+}
+
+static void block_add_free(struct dma_zone *z, size_t idx, unsigned int order) {
+    block_mark(z, idx, order, DMA_BLOCK_FREE);
+    rte_list_add(&index_block(z, idx)->node, &z->free_list[order]);
+}
+
+void *__dma_coherent_alloc(size_t size, unsigned int flags) {
+    struct dma_zone *z = &dma_zone;
+    unsigned int order, curr;
+    struct dma_block *blk;
+    size_t idx;
+
+    (void) flags;
+    if (size == 0)
+        return NULL;
+
+    order = size_to_order(size);
+    if (order >= DMA_MAX_ORDER)
+        return NULL;
+
+    scoped_guard(os_irq) {
+        for (curr = order; curr < DMA_MAX_ORDER; curr++) {
+            if (!rte_list_empty(&z->free_list[curr]))
+                break;
+        }
+        if (curr == DMA_MAX_ORDER)
+            return NULL;
+
+        blk = rte_list_first_entry(&z->free_list[curr], struct dma_block, node);
+        rte_list_del(&blk->node);
+        idx = block_index(z, blk);
+
+        /* Split and give back the upper halves */
+        while (curr > order) {
+            curr--;
+            block_add_free(z, idx + ((size_t)1 << curr), curr);
+        }
+
+        block_mark(z, idx, order, 0);
+        z->free_size -= (size_t)DMA_MIN_SIZE << order;
+        if (z->free_size < z->min_free)
+            z->min_free = z->free_size;
+    }
+
+    return blk;
+}
+
+void __dma_coherent_free(void *ptr) {
+    struct dma_zone *z = &dma_zone;
+    unsigned int order;
+    size_t idx, buddy;
+
+    if (ptr == NULL)
+        return;
+
+    idx = block_index(z, ptr);
+    rte_assert(idx < z->nblocks);
+
+    scoped_guard(os_irq) {
+        order = z->order_map[idx];
+        rte_assert(!(order & (DMA_BLOCK_FREE | DMA_BLOCK_BODY)));
+        z->free_size += (size_t)DMA_MIN_SIZE << order;
+
+        /* Merge with free buddies */
+        while (order < DMA_MAX_ORDER - 1) {
+            buddy = idx ^ ((size_t)1 << order);
+            if (buddy + ((size_t)1 << order) > z->nblocks)
+                break;
+            if (z->order_map[buddy] != (order | DMA_BLOCK_FREE))
+                break;
+
+            rte_list_del(&index_block(z, buddy)->node);
+            z->order_map[buddy] = DMA_BLOCK_BODY;
+            idx &= ~((size_t)1 << order);
+            order++;
+        }
+
+        block_add_free(z, idx, order);
+    }
+}
+
+size_t dma_coherent_free_size(void) {
+    return dma_zone.free_size;
+}
+
+size_t dma_coherent_min_free_size(void) {
+    return dma_zone.min_free;
+}
+
+static int dma_coherent_init(void) {
+    struct dma_zone *z = &dma_zone;
+    uintptr_t start = (uintptr_t)_dma_coherent_start;
+    uintptr_t end = start + (uintptr_t)_dma_coherent_size;
+    size_t nblocks, idx;
+    unsigned int order;
+
+    for (order = 0; order < DMA_MAX_ORDER; order++)
+        RTE_INIT_LIST(&z->free_list[order]);
+
+    /* 
+     * The order map is placed at the tail of region, one byte per 
+     * minimum block
+     */
+    start = rte_roundup(start, DMA_MIN_SIZE);
+    nblocks = (end - start) / (DMA_MIN_SIZE + 1);
+    if (nblocks == 0)
+        return -ENOMEM;
+
+    z->base = (char *)start;
+    z->nblocks = nblocks;
+    z->order_map = (uint8_t *)(start + nblocks * DMA_MIN_SIZE);
+    memset(z->order_map, DMA_BLOCK_BODY, nblocks);
+
+    /* Add the largest aligned blocks that fit */
+    for (idx = 0; idx < nblocks; idx += (size_t)1 << order) {
+        order = DMA_MAX_ORDER - 1;
+        while ((idx & (((size_t)1 << order) - 1)) || 
+            idx + ((size_t)1 << order) > nblocks)
+            order--;
+        block_add_free(z, idx, order);
+    }
+
+    z->free_size = nblocks * DMA_MIN_SIZE;
+    z->min_free = z->free_size;
+    return 0;
+}
+
+SYSINIT(dma_coherent_init, SI_MEMORY_LEVEL, 20);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024 wtcat
+ */
+#ifndef DRIVERS_BLKCACHE_H_
+#define DRIVERS_BLKCACHE_H_
+
+#include "tx_api.h"
+#include "drivers/blkdev.h"
+#include "basework/container/list.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#ifndef CONFIG_BLKCACHE_MERGE_MAX
+#define CONFIG_BLKCACHE_MERGE_MAX 8
+#endif
+
+/*
+ * Write-back block cache
+ *
+ * A block cache is a block device stacked on top of another one. It keeps
+ * the most recently used cache blocks (a multiple of the device sector) in
+ * memory, writes are absorbed until the block is evicted or the cache is
+ * synchronized with BLKDEV_IOC_SYNC. Adjacent dirty blocks are written to
+ * the backing device with one request.
+ *
+ *  static struct blkcache sd_cache;
+ *  static char sd_cache_memory[32 * 1024] __rte_aligned(RTE_CACHE_LINE_SIZE);
+ *
+ *  blkcache_init(&sd_cache, "sdcache", device_find("mmcblk0"),
+ *      sd_cache_memory, sizeof(sd_cache_memory), 1);
+ *  fs_mkfs(FS_EXFATFS, "sdcache", NULL, 0);
+ */
+struct blkcache_block {
+    struct rte_list lru;
+    struct blkcache_block *hnext;
+    unsigned long blkno;
+    uint8_t *data;
+    /* Dirty sector extent [dirty_start, dirty_end) of the block */
+    uint16_t dirty_start;
+    uint16_t dirty_end;
+    bool valid;
+};
+
+struct blkcache_stat {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long dev_reads;
+    unsigned long dev_writes;
+    unsigned long writebacks;
+    unsigned long merged;
+};
+
+struct blkcache {
+    struct block_device blkdev;
+    struct device *backing;
+    TX_MUTEX mtx;
+    struct rte_list lru;
+    struct blkcache_block *blocks;
+    struct blkcache_block **hash;
+    uint8_t *merge_buffer;
+    unsigned long dev_blkcnt;
+    unsigned int nr_blocks;
+    unsigned int hash_mask;
+    unsigned int sector_size;
+    unsigned int block_sectors;
+    unsigned int merge_max;
+    struct blkcache_stat stat;
+    /* Segment list of a merged write back */
+    struct blkdev_seg segs[CONFIG_BLKCACHE_MERGE_MAX];
+};
+
+/*
+ * Create the cache device @name over @backing. The cache blocks, the merge
+ * buffer and the lookup table are carved from @buffer, a cache block is
+ * @block_sectors sectors of the backing device.
+ */
+int blkcache_init(struct blkcache *cache, const char *name,
+    struct device *backing, void *buffer, size_t size,
+    unsigned int block_sectors);
+
+/*
+ * Write back the dirty blocks and unregister the cache device. @cache is no
+ * longer reachable through device_find() once this returns and can be
+ * released.
+ */
+int blkcache_deinit(struct blkcache *cache);
+
+/*
+ * Write back all dirty blocks, the backing device is not synchronized
+ */
+int blkcache_flush(struct blkcache *cache);
+
+void blkcache_get_stat(struct blkcache *cache, struct blkcache_stat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DRIVERS_BLKCACHE_H_ */
@@ -5,6 +5,7 @@
 #define DRIVERS_BLKDEV_H_
 
 #include "drivers/device.h"
+#include "basework/container/list.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -24,26 +25,116 @@ enum blkdev_request_op {
 	BLKDEV_REQ_SYNC
 };
 
+/*
+ * A segment of a scattered request buffer
+ */
+struct blkdev_seg {
+    void *buffer;
+    unsigned long blkcnt;
+};
+
+/*
+ * The data of a request is either in @buffer or, when @nsegs is not zero,
+ * in the segment list @segs whose block counts add up to @blkcnt.
+ */
 struct blkdev_req {
     enum blkdev_request_op op;
     unsigned long blkno;
     unsigned long blkcnt;
     void *buffer;
+    const struct blkdev_seg *segs;
+    unsigned int nsegs;
 };
 
+/*
+ * Asynchronous request, @done is called in the context of the request
+ * queue worker when the request completes
+ */
+struct blkdev_areq {
+    struct blkdev_req req;
+    void (*done)(struct blkdev_areq *areq, int err);
+    void *context;
+    struct rte_list node;
+};
+
+struct blkqueue;
+
 /*
  * Block device structure
+ *
+ * @max_segs is the longest segment list the driver accepts in one request,
+ * zero for drivers that only take a contiguous buffer. @queue is the
+ * request queue of drivers that accept asynchronous requests.
  */
 DEVICE_CLASS_DEFINE(block_device,
     int (*request)(struct device *dev, struct blkdev_req *req);
+    unsigned int max_segs;
+    struct blkqueue *queue;
 );
 
+int blkqueue_submit(struct blkqueue *queue, struct blkdev_areq *areq);
+int blkqueue_request(struct blkqueue *queue, struct blkdev_req *req);
+bool blkqueue_conflicts(struct blkqueue *queue, const struct blkdev_req *req);
+
+static inline int blkdev_request(struct device *dev, struct blkdev_req *req);
+
+/*
+ * Issue the segments one by one to a driver without segment lists
+ */
+static inline int
+blkdev_request_split(struct device *dev, struct blkdev_req *req) {
+    struct blkdev_req sreq = {
+        .op = req->op,
+        .blkno = req->blkno
+    };
+    int err;
+
+    for (unsigned int i = 0; i < req->nsegs; i++) {
+        sreq.blkcnt = req->segs[i].blkcnt;
+        sreq.buffer = req->segs[i].buffer;
+        err = blkdev_request(dev, &sreq);
+        if (err)
+            return err;
+        sreq.blkno += sreq.blkcnt;
+    }
+    return 0;
+}
+
+/*
+ * Synchronous request. With a request queue it only bypasses the queue when
+ * no queued or in-flight request overlaps it, so it can neither read stale
+ * data nor overtake a queued write.
+ */
 static inline int 
 blkdev_request(struct device *dev, struct blkdev_req *req) {
     struct block_device *bdev = (struct block_device *)dev;
+
+#ifdef CONFIG_BLKQUEUE
+    if (bdev->queue != NULL && req->nsegs <= bdev->max_segs &&
+        blkqueue_conflicts(bdev->queue, req))
+        return blkqueue_request(bdev->queue, req);
+#endif
+    if (req->nsegs > bdev->max_segs)
+        return blkdev_request_split(dev, req);
     return bdev->request(dev, req);
 }
 
+/*
+ * Submit an asynchronous request. Devices without a request queue execute
+ * it at once and complete it before returning.
+ */
+static inline int
+blkdev_submit(struct device *dev, struct blkdev_areq *areq) {
+#ifdef CONFIG_BLKQUEUE
+    struct block_device *bdev = (struct block_device *)dev;
+
+    if (bdev->queue != NULL)
+        return blkqueue_submit(bdev->queue, areq);
+#endif
+    areq->done(areq, blkdev_request(dev, &areq->req));
+    return 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
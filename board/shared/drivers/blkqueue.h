@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 wtcat
+ */
+#ifndef DRIVERS_BLKQUEUE_H_
+#define DRIVERS_BLKQUEUE_H_
+
+#include "tx_api.h"
+#include "drivers/blkdev.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#ifndef CONFIG_BLKQUEUE_MAX_SEGS
+#define CONFIG_BLKQUEUE_MAX_SEGS 16
+#endif
+
+/*
+ * Block request queue
+ *
+ * Asynchronous requests (blkdev_submit()) are queued in submission order
+ * and fed to the driver by a worker thread. When a request is dispatched,
+ * the pending requests that continue it on the device with the same
+ * direction are merged into one transfer with a segment list. Up to
+ * @nr_slots transfers are in flight, a request never passes a pending or
+ * in-flight request it overlaps with unless both are reads.
+ *
+ * Synchronous requests (blkdev_request()) go straight to the driver while
+ * the queue holds nothing they overlap with, otherwise they are queued
+ * behind the requests they must not pass.
+ *
+ * The transfer function of a synchronous driver returns the result. With
+ * BLKQUEUE_F_ASYNC it only starts the transfer and the driver reports the
+ * result later with blkqueue_complete(), from any context.
+ */
+#define BLKQUEUE_F_ASYNC 0x01
+
+struct blkqueue;
+
+struct blkqueue_rq {
+    struct blkdev_req req;
+    struct blkdev_seg segs[CONFIG_BLKQUEUE_MAX_SEGS];
+    struct blkdev_areq *members[CONFIG_BLKQUEUE_MAX_SEGS];
+    struct blkqueue *queue;
+    unsigned int nr_members;
+    int err;
+    uint8_t state;
+};
+
+struct blkqueue_config {
+    const char *name;
+    int (*transfer)(struct device *dev, struct blkdev_req *req);
+    unsigned int flags;
+    /* Transfers in flight */
+    struct blkqueue_rq *slots;
+    unsigned int nr_slots;
+    /* The largest merged transfer, 0 for no limit */
+    unsigned long max_blocks;
+    void *stack;
+    size_t stack_size;
+    unsigned int prio;
+};
+
+struct blkqueue_stat {
+    unsigned long submitted;
+    unsigned long dispatched;
+    unsigned long merged;
+    unsigned int max_inflight;
+};
+
+struct blkqueue {
+    TX_THREAD thread;
+    TX_SEMAPHORE sem;
+    TX_MUTEX mtx;
+    /* The pending list, inflight and stat are protected by mtx */
+    struct rte_list pending;
+    struct device *dev;
+    int (*transfer)(struct device *dev, struct blkdev_req *req);
+    struct blkqueue_rq *slots;
+    unsigned int nr_slots;
+    unsigned int inflight;
+    unsigned int max_merge;
+    unsigned long max_blocks;
+    unsigned int flags;
+    struct blkqueue_stat stat;
+};
+
+/*
+ * Create the request queue of block device @dev, blkdev_submit() on the
+ * device goes through the queue afterwards
+ */
+int blkqueue_init(struct blkqueue *queue, struct device *dev,
+    const struct blkqueue_config *cfg);
+
+/*
+ * Wait for the queued requests and stop the worker
+ */
+int blkqueue_destroy(struct blkqueue *queue);
+
+/*
+ * Queue @req and wait for its completion. Must not be called by the
+ * transfer function.
+ */
+int blkqueue_request(struct blkqueue *queue, struct blkdev_req *req);
+
+/*
+ * True if a pending or in-flight request must complete before @req, a
+ * sync request conflicts with any of them
+ */
+bool blkqueue_conflicts(struct blkqueue *queue, const struct blkdev_req *req);
+
+/*
+ * Completion of a transfer started by an asynchronous driver
+ */
+void blkqueue_complete(struct blkdev_req *req, int err);
+
+void blkqueue_get_stat(struct blkqueue *queue, struct blkqueue_stat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DRIVERS_BLKQUEUE_H_ */
@@ -12,6 +12,7 @@
 #include "tx_user.h"
 
 #include "basework/bitops.h"
+#include "basework/linker.h"
 #include "basework/container/queue.h"
 
 #ifdef __cplusplus
@@ -26,6 +27,8 @@ struct device;
 #define DEVICE_CLASS_DEFINE(_type, ...) \
     struct _type { \
         STAILQ_ENTRY(device) link; \
+        struct device *hnext; \
+        uint32_t hash; \
         const char *name; \
         void *private_data; \
         int (*control)(struct device *, unsigned int, void *); \
@@ -37,6 +40,36 @@ struct device;
  */
 DEVICE_CLASS_DEFINE(device);
 
+/*
+ * Static device definition
+ *
+ * DEVICE_DEFINE() places a device in the device linker set, it is
+ * registered by the device core before any driver initialization runs.
+ * Code that knows the device at build time takes the handle directly
+ * with DEVICE_GET() instead of looking it up by name.
+ *
+ *  DEVICE_DEFINE(block_device, ramblk,
+ *      .name = "ramblk",
+ *      .request = ramblk_request
+ *  );
+ *  struct device *dev = DEVICE_GET(ramblk);
+ */
+struct device_item {
+    struct device *dev;
+};
+
+#define DEVICE_DEFINE(_type, _id, ...) \
+    struct _type __device_##_id = { __VA_ARGS__ }; \
+    static LINKER_ROSET_ITEM_ORDERED(device, struct device_item, \
+        _id, 0) = { \
+        .dev = (struct device *)&__device_##_id \
+    }
+
+#define DEVICE_DECLARE(_type, _id) \
+    extern struct _type __device_##_id
+
+#define DEVICE_GET(_id) ((struct device *)&__device_##_id)
+
 /* 
  * Device helper interface
  */
@@ -49,6 +82,17 @@ int  device_register(struct device *dev);
 int  device_unregister(struct device *dev);
 void device_foreach(bool (*iterator)(struct device *, void *), void *user);
 
+/*
+ * Name hash used by the device index (FNV-1a)
+ */
+static inline uint32_t device_name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+
+    while (*name)
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    return hash;
+}
+
 static inline int 
 device_control(struct device *dev, unsigned int cmd, void *arg) {
     if (dev == NULL)
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Heap allocation profiler
+ *
+ * Every profiled block is prefixed with a small header that records the
+ * call site slot and the requested size. Call sites are kept in a fixed
+ * size open-addressing hash table keyed by the caller address. Probing is
+ * bounded, sites that do not fit are accounted to slot 0 ("other").
+ */
+
+#include <errno.h>
+#include "tx_api.h"
+
+#include "basework/assert.h"
+
+#ifndef CONFIG_HEAP_PROFILE_SITES
+#define CONFIG_HEAP_PROFILE_SITES 64
+#endif
+
+#define HEAP_PROFILE_PROBES  8
+#define HEAP_PROFILE_MAGIC   0xA5
+
+_Static_assert((CONFIG_HEAP_PROFILE_SITES & (CONFIG_HEAP_PROFILE_SITES - 1)) == 0,
+    "CONFIG_HEAP_PROFILE_SITES must be power of 2");
+_Static_assert(CONFIG_HEAP_PROFILE_SITES <= 256, "");
+
+struct heap_profile_header {
+    uint8_t magic;
+    uint8_t heap;
+    uint8_t site;
+    uint8_t reserved;
+    uint32_t size;
+};
+
+_Static_assert(sizeof(struct heap_profile_header) <= HEAP_PROFILE_HEADER_SIZE, "");
+
+static struct heap_site_stat heap_sites[CONFIG_HEAP_PROFILE_SITES];
+static struct heap_profile_total heap_totals[HEAP_PROFILE_MAX];
+
+static inline unsigned int heap_site_hash(uintptr_t caller) {
+    return (unsigned int)(((caller >> 1) * 2654435761u) >> 8) &
+        (CONFIG_HEAP_PROFILE_SITES - 1);
+}
+
+/* Slot 0 is reserved for sites that can not be placed */
+static unsigned int heap_site_lookup(uintptr_t caller, unsigned int heap) {
+    unsigned int idx = heap_site_hash(caller);
+
+    for (int i = 0; i < HEAP_PROFILE_PROBES; i++) {
+        struct heap_site_stat *site;
+
+        if (idx == 0)
+            idx = 1;
+        site = &heap_sites[idx];
+        if (site->caller == caller && site->heap == heap)
+            return idx;
+        if (site->caller == 0) {
+            site->caller = caller;
+            site->heap = heap;
+            return idx;
+        }
+        idx = (idx + 1) & (CONFIG_HEAP_PROFILE_SITES - 1);
+    }
+
+    return 0;
+}
+
+void *heap_profile_record(void *block, size_t size, unsigned int heap,
+    void *caller) {
+    struct heap_profile_header *hdr = block;
+    struct heap_site_stat *site;
+    struct heap_profile_total *total;
+
+    if (block == NULL)
+        return NULL;
+
+    rte_assert(heap < HEAP_PROFILE_MAX);
+    scoped_guard(os_irq) {
+        hdr->site = (uint8_t)heap_site_lookup((uintptr_t)caller, heap);
+        site = &heap_sites[hdr->site];
+        site->allocs++;
+        site->live_count++;
+        site->live_bytes += size;
+        if (site->live_bytes > site->peak_bytes)
+            site->peak_bytes = site->live_bytes;
+
+        total = &heap_totals[heap];
+        total->live_bytes += size;
+        if (total->live_bytes > total->peak_bytes)
+            total->peak_bytes = total->live_bytes;
+    }
+
+    hdr->magic = HEAP_PROFILE_MAGIC;
+    hdr->heap = (uint8_t)heap;
+    hdr->size = (uint32_t)size;
+    return (char *)block + HEAP_PROFILE_HEADER_SIZE;
+}
+
+void *heap_profile_release(void *ptr) {
+    struct heap_profile_header *hdr;
+    struct heap_site_stat *site;
+
+    hdr = (struct heap_profile_header *)((char *)ptr - HEAP_PROFILE_HEADER_SIZE);
+    rte_assert(hdr->magic == HEAP_PROFILE_MAGIC);
+
+    scoped_guard(os_irq) {
+        site = &heap_sites[hdr->site];
+        site->frees++;
+        site->live_count--;
+        site->live_bytes -= hdr->size;
+        heap_totals[hdr->heap].live_bytes -= hdr->size;
+    }
+
+    hdr->magic = 0;
+    return hdr;
+}
+
+int heap_profile_get_sites(struct heap_site_stat *sites, int max) {
+    int n = 0;
+
+    if (sites == NULL || max <= 0)
+        return -EINVAL;
+
+    for (int i = 0; i < CONFIG_HEAP_PROFILE_SITES && n < max; i++) {
+        scoped_guard(os_irq) {
+            if (heap_sites[i].allocs)
+                sites[n++] = heap_sites[i];
+        }
+    }
+
+    return n;
+}
+
+int heap_profile_get_total(unsigned int heap, struct heap_profile_total *total) {
+    if (heap >= HEAP_PROFILE_MAX || total == NULL)
+        return -EINVAL;
+
+    scoped_guard(os_irq) {
+        *total = heap_totals[heap];
+    }
+    return 0;
+}
@@ -4,6 +4,7 @@
 #define TX_USE_BOARD_PRIVATE
 
 #include <errno.h>
+#include <string.h>
 #include "tx_api.h"
 
 
@@ -14,6 +15,59 @@ struct irq_desc {
 
 static struct irq_desc _irqdesc_table[BOARD_IRQ_MAX] __fastbss;
 
+#ifdef CONFIG_IRQ_STAT
+#ifndef IRQ_STAT_CYCLES
+#error "The board must define IRQ_STAT_CYCLES() for CONFIG_IRQ_STAT"
+#endif
+#ifndef IRQ_STAT_INIT
+#define IRQ_STAT_INIT() (void)0
+#endif
+
+static struct irq_stat _irqstat_table[BOARD_IRQ_MAX] __fastbss;
+static ULONG _irqstat_since;
+
+static void __fastcode irq_stat_account(int irq, uint32_t cycles) {
+	struct irq_stat *stat = _irqstat_table + irq;
+	uint32_t bucket;
+
+	stat->count++;
+	stat->total += cycles;
+	if (cycles > stat->max)
+		stat->max = cycles;
+
+	cycles >>= IRQ_STAT_HIST_SHIFT;
+	bucket = cycles? 32 - __builtin_clz(cycles): 0;
+	if (bucket >= IRQ_STAT_BUCKETS)
+		bucket = IRQ_STAT_BUCKETS - 1;
+	stat->hist[bucket]++;
+}
+
+int irq_stat_get(int irq, struct irq_stat *stat) {
+	if (irq < 0 || irq >= BOARD_IRQ_MAX || stat == NULL)
+		return -EINVAL;
+
+	scoped_guard(os_irq) {
+		*stat = _irqstat_table[irq];
+	}
+	return 0;
+}
+
+void irq_stat_reset(void) {
+	scoped_guard(os_irq) {
+		memset(_irqstat_table, 0, sizeof(_irqstat_table));
+		_irqstat_since = tx_time_get();
+	}
+}
+
+ULONG irq_stat_since(void) {
+	return _irqstat_since;
+}
+
+uint32_t irq_stat_cycles_per_us(void) {
+	return IRQ_STAT_CYCLES_PER_US;
+}
+#endif /* CONFIG_IRQ_STAT */
+
 static void default_irq_handler(void *arg) {
 	printk("Warnning***: please install interrupt(%d) handler\n", 
 		(int)IRQ_VECTOR_GET());
@@ -22,6 +76,9 @@ static void default_irq_handler(void *arg) {
 void __fastcode dispatch_irq(void) {
 	int irq = IRQ_VECTOR_GET();
 	struct irq_desc *desc = _irqdesc_table + irq;
+#ifdef CONFIG_IRQ_STAT
+	uint32_t start = IRQ_STAT_CYCLES();
+#endif
 
 #ifdef TX_EXECUTION_PROFILE_ENABLE
     _tx_execution_isr_enter();
@@ -30,6 +87,9 @@ void __fastcode dispatch_irq(void) {
 #ifdef TX_EXECUTION_PROFILE_ENABLE
     _tx_execution_isr_exit();
 #endif
+#ifdef CONFIG_IRQ_STAT
+	irq_stat_account(irq, IRQ_STAT_CYCLES() - start);
+#endif
 }
 
 int request_irq(int irq, void (*handler)(void *), void *arg) {
@@ -70,5 +130,96 @@ int init_irq(void) {
 		_irqdesc_table[i].arg = NULL;
 	}
 
+#ifdef CONFIG_IRQ_STAT
+	IRQ_STAT_INIT();
+	irq_stat_reset();
+#endif
     return 0;
 }
+
+#ifdef CONFIG_IRQ_THREAD
+/*
+ * Threaded interrupt
+ *
+ * The hard handler only acknowledges the device and returns IRQ_WAKE_THREAD,
+ * the bottom half runs as a task on the interrupt task runner. An interrupt
+ * raised while its bottom half is still pending is coalesced into it, with
+ * IRQF_ONESHOT the line is also masked until the bottom half has run. Either
+ * way an interrupt storm costs at most one bottom half per pass.
+ */
+#ifndef TX_IRQ_THREAD_STACK_SIZE
+#define TX_IRQ_THREAD_STACK_SIZE 1024
+#endif
+#ifndef TX_IRQ_THREAD_PRIO
+#define TX_IRQ_THREAD_PRIO 1
+#endif
+
+struct task_runner _irq_taskrunner __fastbss;
+static char irq_stack_memory[TX_IRQ_THREAD_STACK_SIZE] __fastbss __rte_aligned(8);
+
+static void __fastcode threaded_irq_handler(void *arg) {
+	struct irq_thread *it = arg;
+	int ret = IRQ_WAKE_THREAD;
+
+	it->raised++;
+	if (it->handler)
+		ret = it->handler(it->arg);
+	if (ret != IRQ_WAKE_THREAD)
+		return;
+
+	if (it->flags & IRQF_ONESHOT)
+		disable_irq(it->irq);
+	if (task_post_prio(&_irq_taskrunner, &it->task, TASK_PRIO_HIGHEST) == -EBUSY)
+		it->coalesced++;
+}
+
+static void threaded_irq_task(struct task *task) {
+	struct irq_thread *it = (struct irq_thread *)task;
+
+	it->thread_fn(it->arg);
+	it->executed++;
+	if (it->flags & IRQF_ONESHOT)
+		enable_irq(it->irq);
+}
+
+int request_threaded_irq(int irq, struct irq_thread *it, int (*handler)(void *),
+	void (*thread_fn)(void *), void *arg, unsigned int flags) {
+	if (it == NULL || thread_fn == NULL)
+		return -EINVAL;
+
+	init_task(&it->task, threaded_irq_task);
+	it->handler = handler;
+	it->thread_fn = thread_fn;
+	it->arg = arg;
+	it->irq = irq;
+	it->flags = flags;
+	it->raised = 0;
+	it->coalesced = 0;
+	it->executed = 0;
+	return request_irq(irq, threaded_irq_handler, it);
+}
+
+/*
+ * Returns once a running bottom half has finished and a pending one has been
+ * dropped by the interrupt task runner, @it can be released afterwards. Must
+ * not be called from a bottom half.
+ */
+int remove_threaded_irq(int irq, struct irq_thread *it) {
+	int err;
+
+	if (it == NULL)
+		return -EINVAL;
+
+	err = remove_irq(irq, threaded_irq_handler, it);
+	if (!err)
+		task_cancel(&it->task, true);
+	return err;
+}
+
+static int irq_thread_init(void) {
+	return task_runner_construct(&_irq_taskrunner, "irq_taskrunner",
+		irq_stack_memory, sizeof(irq_stack_memory), TX_IRQ_THREAD_PRIO, 0);
+}
+
+SYSINIT(irq_thread_init, SI_MEMORY_LEVEL, 81);
+#endif /* CONFIG_IRQ_THREAD */
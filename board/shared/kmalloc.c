@@ -2,8 +2,11 @@
  * Copyright 2024 wtcat
  */
 
+#include <errno.h>
 #include "tx_api.h"
 
+#include "basework/assert.h"
+
 extern char _kernel_byte_pool_start[];
 #ifndef CONFIG_SIMULATOR
 extern char _kernel_byte_pool_size[];
@@ -11,31 +14,289 @@ extern char _kernel_byte_pool_size[];
 extern UINT _kernel_byte_pool_size;
 #endif /* CONFIG_SIMULATOR */
 
-static TX_BYTE_POOL kernel_byte_pool __fastdata;
+#ifdef CONFIG_KMALLOC_TLSF
+static struct tlsf kernel_heap __fastbss;
+
+/* TLSF never blocks, GMF_WAIT is ignored */
+static void *kernel_pool_alloc(size_t size, unsigned int flags) {
+    void *ptr = NULL;
 
+    (void) flags;
+    scoped_guard(os_irq) {
+        ptr = tlsf_malloc(&kernel_heap, size);
+    }
+    return ptr;
+}
 
-void * __kmalloc(size_t size, unsigned int flags) {
+static void kernel_pool_free(void *ptr) {
+    scoped_guard(os_irq) {
+        tlsf_free(&kernel_heap, ptr);
+    }
+}
+
+#else /* !CONFIG_KMALLOC_TLSF */
+static TX_BYTE_POOL kernel_byte_pool __fastdata;
+
+static void *kernel_pool_alloc(size_t size, unsigned int flags) {
     void *ptr = NULL;
-    tx_byte_allocate(&kernel_byte_pool,
-        &ptr, size, (flags & GMF_WAIT)? TX_WAIT_FOREVER: TX_NO_WAIT);
+    tx_byte_allocate(&kernel_byte_pool, &ptr, size, 
+        (flags & GMF_WAIT)? TX_WAIT_FOREVER: TX_NO_WAIT);
     return ptr;
 }
 
+static void kernel_pool_free(void *ptr) {
+    tx_byte_release(ptr);
+}
+#endif /* CONFIG_KMALLOC_TLSF */
+
+#ifdef CONFIG_KMALLOC_SLAB
+/*
+ * Size-class slab layer
+ *
+ * Small requests are served from per-class object pools, the pages of a
+ * class are carved from the kernel byte pool on demand and never returned.
+ * Every object is prefixed with a header that points to its class (NULL for
+ * requests that went straight to the byte pool), so kfree() is O(1).
+ */
+#ifndef CONFIG_KMALLOC_SLAB_SIZES
+#define CONFIG_KMALLOC_SLAB_SIZES 16, 32, 64, 128, 256, 512
+#endif
+#ifndef CONFIG_KMALLOC_SLAB_PAGE_SIZE
+#define CONFIG_KMALLOC_SLAB_PAGE_SIZE 2048
+#endif
+
+#define KMEM_ALIGN       8
+#define KMEM_HEADER_SIZE rte_roundup(sizeof(struct kmem_header), KMEM_ALIGN)
+#define KMEM_GRANULE     16
+
+struct kmem_cache {
+    struct object_pool pool;
+    size_t objsize;
+    unsigned long pages;
+    unsigned long total;
+    unsigned long inuse;
+    unsigned long peak;
+    unsigned long allocs;
+};
+
+struct kmem_header {
+    struct kmem_cache *cache;
+};
+
+static const uint16_t kmem_class_size[] = {CONFIG_KMALLOC_SLAB_SIZES};
+static struct kmem_cache kmem_caches[rte_array_size(kmem_class_size)] __fastbss;
+static unsigned long kmem_large_allocs;
+
+#define KMEM_MAX_SIZE kmem_class_size[rte_array_size(kmem_class_size) - 1]
+#define KMEM_INDEX_NUM(_max) ((size_t)(_max) / KMEM_GRANULE + 1)
+
+/* Map (size + KMEM_GRANULE - 1) / KMEM_GRANULE to size class */
+static uint8_t kmem_size_index[KMEM_INDEX_NUM(4096)] __fastbss;
+
+static inline struct kmem_cache *kmem_cache_lookup(size_t size) {
+    if (rte_unlikely(size == 0 || size > KMEM_MAX_SIZE))
+        return NULL;
+    return &kmem_caches[kmem_size_index[rte_div_roundup(size, KMEM_GRANULE)]];
+}
+
+static int kmem_cache_grow(struct kmem_cache *cache) {
+    size_t objsize = KMEM_HEADER_SIZE + cache->objsize;
+    size_t n = CONFIG_KMALLOC_SLAB_PAGE_SIZE / objsize;
+    void *page;
+    char *p;
+
+    if (n < 2)
+        n = 2;
+
+    page = kernel_pool_alloc(n * objsize, 0);
+    if (page == NULL)
+        return -ENOMEM;
+
+    scoped_guard(os_irq) {
+        cache->pages++;
+        cache->total += n;
+    }
+
+    for (p = page; n > 0; n--, p += objsize)
+        object_free(&cache->pool, p);
+
+    return 0;
+}
+
+static void *kmem_cache_alloc(struct kmem_cache *cache) {
+    struct kmem_header *hdr;
+
+    hdr = object_allocate(&cache->pool);
+    if (hdr == NULL) {
+        if (kmem_cache_grow(cache))
+            return NULL;
+        hdr = object_allocate(&cache->pool);
+        if (hdr == NULL)
+            return NULL;
+    }
+
+    scoped_guard(os_irq) {
+        cache->allocs++;
+        if (++cache->inuse > cache->peak)
+            cache->peak = cache->inuse;
+    }
+
+    hdr->cache = cache;
+    return (char *)hdr + KMEM_HEADER_SIZE;
+}
+
+static void *kmem_large_alloc(size_t size, unsigned int flags) {
+    struct kmem_header *hdr;
+
+    hdr = kernel_pool_alloc(KMEM_HEADER_SIZE + size, flags);
+    if (hdr == NULL)
+        return NULL;
+
+    scoped_guard(os_irq) {
+        kmem_large_allocs++;
+    }
+    hdr->cache = NULL;
+    return (char *)hdr + KMEM_HEADER_SIZE;
+}
+
+static void *kmem_alloc(size_t size, unsigned int flags) {
+    struct kmem_cache *cache = kmem_cache_lookup(size);
+    void *ptr;
+
+    if (cache) {
+        ptr = kmem_cache_alloc(cache);
+        if (rte_likely(ptr))
+            return ptr;
+    }
+
+    /*
+     * Large request or the slab can not grow, fall back to byte pool
+     */
+    return kmem_large_alloc(size, flags);
+}
+
+static void kmem_free(void *ptr) {
+    struct kmem_header *hdr;
+    struct kmem_cache *cache;
+
+    if (ptr == NULL)
+        return;
+
+    hdr = (struct kmem_header *)((char *)ptr - KMEM_HEADER_SIZE);
+    cache = hdr->cache;
+    if (cache) {
+        object_free(&cache->pool, hdr);
+        scoped_guard(os_irq) {
+            cache->inuse--;
+        }
+        return;
+    }
+
+    kernel_pool_free(hdr);
+}
+
+int kmalloc_get_class_stat(unsigned int idx, struct kmem_class_stat *stat) {
+    struct kmem_cache *cache;
+
+    if (stat == NULL)
+        return -EINVAL;
+
+    if (idx >= rte_array_size(kmem_caches))
+        return -ENOENT;
+
+    cache = &kmem_caches[idx];
+    scoped_guard(os_irq) {
+        stat->objsize = cache->objsize;
+        stat->pages   = cache->pages;
+        stat->total   = cache->total;
+        stat->inuse   = cache->inuse;
+        stat->peak    = cache->peak;
+        stat->allocs  = cache->allocs;
+    }
+    return 0;
+}
+
+unsigned long kmalloc_get_large_allocs(void) {
+    return kmem_large_allocs;
+}
+
+static void kmem_caches_init(void) {
+    size_t i, k, cls = 0;
+
+    rte_assert(KMEM_MAX_SIZE <= 4096);
+    for (i = 0; i < rte_array_size(kmem_caches); i++) {
+        kmem_caches[i].pool.free_chain = NULL;
+        kmem_caches[i].objsize = rte_roundup(kmem_class_size[i], KMEM_ALIGN);
+    }
+
+    for (k = 1; k < KMEM_INDEX_NUM(KMEM_MAX_SIZE); k++) {
+        while (kmem_class_size[cls] < k * KMEM_GRANULE && 
+            cls < rte_array_size(kmem_class_size) - 1)
+            cls++;
+        kmem_size_index[k] = (uint8_t)cls;
+    }
+}
+
+#else /* !CONFIG_KMALLOC_SLAB */
+static void *kmem_alloc(size_t size, unsigned int flags) {
+    return kernel_pool_alloc(size, flags);
+}
+
+static void kmem_free(void *ptr) {
+    if (ptr)
+        kernel_pool_free(ptr);
+}
+#endif /* CONFIG_KMALLOC_SLAB */
+
+#ifdef CONFIG_HEAP_PROFILE
+static void *kmem_alloc_profiled(size_t size, unsigned int flags, void *caller) {
+    return heap_profile_record(kmem_alloc(size + HEAP_PROFILE_HEADER_SIZE, flags),
+        size, HEAP_PROFILE_KERNEL, caller);
+}
+
+void *__kmalloc(size_t size, unsigned int flags) {
+    return kmem_alloc_profiled(size, flags, __builtin_return_address(0));
+}
+
 void *__kzalloc(size_t size, unsigned int flags) {
-    void *ptr = __kmalloc(size, flags);
+    void *ptr = kmem_alloc_profiled(size, flags, __builtin_return_address(0));
     if (ptr)
         memset(ptr, 0, size);
     return ptr;
 }
 
 void __kfree(void *ptr) {
-    tx_byte_release(ptr);
+    if (ptr)
+        kmem_free(heap_profile_release(ptr));
 }
 
+#else /* !CONFIG_HEAP_PROFILE */
+void *__kmalloc(size_t size, unsigned int flags) {
+    return kmem_alloc(size, flags);
+}
+
+void *__kzalloc(size_t size, unsigned int flags) {
+    void *ptr = kmem_alloc(size, flags);
+    if (ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void __kfree(void *ptr) {
+    kmem_free(ptr);
+}
+#endif /* CONFIG_HEAP_PROFILE */
 
 static int kmalloc_init(void) {
+#ifdef CONFIG_KMALLOC_TLSF
+    tlsf_init(&kernel_heap, _kernel_byte_pool_start, (size_t)_kernel_byte_pool_size);
+#else
     tx_byte_pool_create(&kernel_byte_pool, "kernel",
         _kernel_byte_pool_start, (ULONG)_kernel_byte_pool_size);
+#endif
+#ifdef CONFIG_KMALLOC_SLAB
+    kmem_caches_init();
+#endif
     return 0;
 }
 
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Lock-free object pool
+ *
+ * The free list is a LIFO of object indexes. Every free object stores the
+ * index of its successor in the first word, and the list head packs a
+ * modification tag in the upper half of a machine word. The head is only
+ * changed by compare-and-swap, on Cortex-M this is an LDREX/STREX loop and
+ * on linux_x86 a locked cmpxchg, so no interrupt lock is needed.
+ */
+
+#include <errno.h>
+#include "tx_api.h"
+
+#define TAG_ONE ((uintptr_t)1 << LOCKFREE_POOL_INDEX_BITS)
+
+static inline void *index_to_object(struct lockfree_pool *pool, uintptr_t index) {
+    return pool->base + (index - 1) * pool->objsize;
+}
+
+static inline uintptr_t object_to_index(struct lockfree_pool *pool, void *obj) {
+    return (uintptr_t)((char *)obj - pool->base) / pool->objsize + 1;
+}
+
+static inline void stat_account_alloc(struct object_pool_stat *stat) {
+    unsigned long inuse, peak;
+
+    __atomic_fetch_add(&stat->allocs, 1, __ATOMIC_RELAXED);
+    inuse = __atomic_add_fetch(&stat->inuse, 1, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&stat->peak, __ATOMIC_RELAXED);
+    while (inuse > peak) {
+        if (__atomic_compare_exchange_n(&stat->peak, &peak, inuse, true, 
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+void *lockfree_allocate(struct lockfree_pool *pool) {
+    uintptr_t head, next, index;
+    void *obj;
+
+    head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    do {
+        index = head & LOCKFREE_POOL_INDEX_MASK;
+        if (rte_unlikely(index == 0)) {
+            __atomic_fetch_add(&pool->stat.failures, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+
+        /*
+         * The object may be taken and overwritten by another context before
+         * the CAS, in that case the tag has changed and the CAS fails.
+         */
+        obj = index_to_object(pool, index);
+        next = ((head & ~LOCKFREE_POOL_INDEX_MASK) + TAG_ONE) | 
+            (*(volatile uintptr_t *)obj & LOCKFREE_POOL_INDEX_MASK);
+    } while (!__atomic_compare_exchange_n(&pool->head, &head, next, true, 
+        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    stat_account_alloc(&pool->stat);
+    return obj;
+}
+
+void lockfree_free(struct lockfree_pool *pool, void *obj) {
+    uintptr_t head, next, index;
+
+    if (obj == NULL)
+        return;
+
+    /* Account before publishing, so inuse never exceeds the real usage */
+    __atomic_fetch_add(&pool->stat.frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&pool->stat.inuse, 1, __ATOMIC_RELAXED);
+
+    index = object_to_index(pool, obj);
+    head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+    do {
+        *(volatile uintptr_t *)obj = head & LOCKFREE_POOL_INDEX_MASK;
+        next = ((head & ~LOCKFREE_POOL_INDEX_MASK) + TAG_ONE) | index;
+    } while (!__atomic_compare_exchange_n(&pool->head, &head, next, true, 
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+int lockfree_pool_initialize(struct lockfree_pool *pool, void *buffer, size_t size, 
+    size_t objsize) {
+    size_t n, fixed_isize = rte_roundup(objsize, sizeof(void *));
+    uintptr_t head = 0;
+    char *p;
+
+    if (pool == NULL || buffer == NULL || objsize == 0)
+        return -EINVAL;
+
+    n = size / fixed_isize;
+    if (n == 0 || n > LOCKFREE_POOL_MAX_OBJECTS)
+        return -EINVAL;
+
+    memset(&pool->stat, 0, sizeof(pool->stat));
+    pool->base = buffer;
+    pool->objsize = fixed_isize;
+    pool->nobjs = n;
+
+    /* Link objects in address order, so the first allocation returns buffer */
+    for (p = pool->base + (n - 1) * fixed_isize; n > 0; n--) {
+        *(uintptr_t *)p = head;
+        head = n;
+        p -= fixed_isize;
+    }
+    __atomic_store_n(&pool->head, head, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void lockfree_pool_get_stat(struct lockfree_pool *pool, struct object_pool_stat *stat) {
+    stat->allocs   = __atomic_load_n(&pool->stat.allocs, __ATOMIC_RELAXED);
+    stat->frees    = __atomic_load_n(&pool->stat.frees, __ATOMIC_RELAXED);
+    stat->failures = __atomic_load_n(&pool->stat.failures, __ATOMIC_RELAXED);
+    stat->inuse    = __atomic_load_n(&pool->stat.inuse, __ATOMIC_RELAXED);
+    stat->peak     = __atomic_load_n(&pool->stat.peak, __ATOMIC_RELAXED);
+}
@@ -2,40 +2,303 @@
  * Copyright 2024 wtcat
  */
 
+#include <errno.h>
+#include <stdint.h>
 #include "tx_api.h"
+#include "tx_thread.h"
 
 extern char _app_pool_byte_start[];
+#ifndef CONFIG_SIMULATOR
 extern char _app_pool_byte_size[];
+#else
+extern UINT _app_pool_byte_size;
+#endif /* CONFIG_SIMULATOR */
 
-static TX_BYTE_POOL app_byte_pool __fastdata; 
+#ifdef CONFIG_MALLOC_TLSF
+static struct tlsf app_heap __fastbss;
 
-void *__general_malloc(size_t size) {
+static void *heap_alloc(size_t size) {
     void *p = NULL;
-    tx_byte_allocate(&app_byte_pool, &p, size, TX_NO_WAIT);
+
+    scoped_guard(os_irq) {
+        p = tlsf_malloc(&app_heap, size);
+    }
     return p;
 }
 
-void *__general_calloc(size_t n, size_t size) {
+static void heap_free(void *ptr) {
+    scoped_guard(os_irq) {
+        tlsf_free(&app_heap, ptr);
+    }
+}
+
+int malloc_get_heap_stat(struct heap_stat *stat) {
+    if (stat == NULL)
+        return -EINVAL;
+
+    scoped_guard(os_irq) {
+        tlsf_get_stat(&app_heap, stat);
+    }
+    return 0;
+}
+
+#else /* !CONFIG_MALLOC_TLSF */
+static TX_BYTE_POOL app_byte_pool __fastdata;
+
+static void *heap_alloc(size_t size) {
     void *p = NULL;
-    tx_byte_allocate(&app_byte_pool, &p, n *size, TX_NO_WAIT);
+    tx_byte_allocate(&app_byte_pool, &p, size, TX_NO_WAIT);
     return p;
 }
 
-void __general_free(void *ptr) {
+static void heap_free(void *ptr) {
     tx_byte_release(ptr);
 }
 
-void *__dma_coherent_alloc(size_t size, unsigned int flags) {
-    return NULL;
+int malloc_get_heap_stat(struct heap_stat *stat) {
+    return -ENOTSUP;
+}
+#endif /* CONFIG_MALLOC_TLSF */
+
+#ifdef CONFIG_MALLOC_TCACHE
+/*
+ * Per-thread allocation cache
+ *
+ * Small blocks released by a thread are kept in its own free lists
+ * (hung on TX_THREAD::tx_thread_tcache) and handed out again without
+ * touching the heap. Only the owner thread accesses its cache, so
+ * no lock is needed. A bin that overflows gives back a bounded batch to
+ * the heap. The cache of a deleted thread is put on an orphan list by
+ * the delete hook, which runs with interrupt disabled, and is given back
+ * to the heap by the next allocation call made from a thread.
+ * Every block is prefixed with a header that records its size class
+ * (TCACHE_NONE for requests that went straight to the heap).
+ */
+#ifndef CONFIG_MALLOC_TCACHE_SIZES
+#define CONFIG_MALLOC_TCACHE_SIZES 16, 32, 64, 128, 256
+#endif
+#ifndef CONFIG_MALLOC_TCACHE_COUNT
+#define CONFIG_MALLOC_TCACHE_COUNT 16
+#endif
+
+#define TCACHE_ALIGN       8
+#define TCACHE_HEADER_SIZE rte_roundup(sizeof(struct tcache_header), TCACHE_ALIGN)
+#define TCACHE_NONE        0xFF
+#define TCACHE_FLUSH_BATCH (CONFIG_MALLOC_TCACHE_COUNT / 2)
+
+struct tcache_header {
+    uintptr_t cls;
+};
+
+struct tcache_entry {
+    struct tcache_entry *next;
+};
+
+static const uint16_t tcache_class_size[] = {CONFIG_MALLOC_TCACHE_SIZES};
+
+#define TCACHE_CLASSES   rte_array_size(tcache_class_size)
+#define TCACHE_MAX_SIZE  tcache_class_size[TCACHE_CLASSES - 1]
+
+struct tcache {
+    struct tcache_entry *bins[TCACHE_CLASSES];
+    uint16_t counts[TCACHE_CLASSES];
+    struct tcache *next;
+};
+
+static struct tcache *tcache_orphans;
+
+static void tcache_reap(void);
+
+static inline unsigned int tcache_class(size_t size) {
+    unsigned int cls = 0;
+
+    while (tcache_class_size[cls] < size)
+        cls++;
+    return cls;
+}
+
+static struct tcache *tcache_get(void) {
+    TX_THREAD *thread;
+    void *tc;
+
+    /* 
+     * Interrupt or initialize context. An interrupt handler must not use
+     * the cache of the thread it interrupted.
+     */
+    if (rte_unlikely(TX_THREAD_GET_SYSTEM_STATE() != 0))
+        return NULL;
+
+    thread = tx_thread_identify();
+    if (rte_unlikely(thread == NULL))
+        return NULL;
+
+    if (rte_unlikely(__atomic_load_n(&tcache_orphans, __ATOMIC_RELAXED) != NULL))
+        tcache_reap();
+
+    tc = thread->tx_thread_tcache;
+    if (rte_unlikely(tc == NULL)) {
+        tc = heap_alloc(sizeof(struct tcache));
+        if (tc == NULL)
+            return NULL;
+        memset(tc, 0, sizeof(struct tcache));
+        thread->tx_thread_tcache = tc;
+    }
+
+    return tc;
+}
+
+static void tcache_flush(struct tcache *tc, unsigned int cls, unsigned int n) {
+    struct tcache_entry *e;
+
+    while (n > 0 && (e = tc->bins[cls]) != NULL) {
+        tc->bins[cls] = e->next;
+        tc->counts[cls]--;
+        heap_free((char *)e - TCACHE_HEADER_SIZE);
+        n--;
+    }
 }
 
-void __dma_coherent_free(void *ptr) {
-    
+/* Give the caches of the deleted threads back to the heap */
+static void tcache_reap(void) {
+    struct tcache *tc;
+
+    scoped_guard(os_irq) {
+        tc = tcache_orphans;
+        tcache_orphans = NULL;
+    }
+
+    while (tc != NULL) {
+        struct tcache *next = tc->next;
+
+        for (unsigned int cls = 0; cls < TCACHE_CLASSES; cls++)
+            tcache_flush(tc, cls, CONFIG_MALLOC_TCACHE_COUNT);
+        heap_free(tc);
+        tc = next;
+    }
+}
+
+/* Called by tx_thread_delete() with interrupt disabled */
+void __general_tcache_drain(TX_THREAD *thread) {
+    struct tcache *tc = thread->tx_thread_tcache;
+
+    if (tc == NULL)
+        return;
+
+    thread->tx_thread_tcache = NULL;
+    tc->next = tcache_orphans;
+    tcache_orphans = tc;
+}
+
+static void *general_malloc(size_t size) {
+    struct tcache_header *hdr;
+    struct tcache_entry *e;
+    struct tcache *tc;
+    unsigned int cls = TCACHE_NONE;
+
+    if (size <= TCACHE_MAX_SIZE) {
+        cls = tcache_class(size);
+        tc = tcache_get();
+        if (tc != NULL && (e = tc->bins[cls]) != NULL) {
+            tc->bins[cls] = e->next;
+            tc->counts[cls]--;
+            return e;
+        }
+        size = tcache_class_size[cls];
+    }
+
+    hdr = heap_alloc(TCACHE_HEADER_SIZE + size);
+    if (hdr == NULL)
+        return NULL;
+
+    hdr->cls = cls;
+    return (char *)hdr + TCACHE_HEADER_SIZE;
+}
+
+static void general_free(void *ptr) {
+    struct tcache_header *hdr;
+    struct tcache_entry *e;
+    struct tcache *tc;
+    unsigned int cls;
+
+    if (ptr == NULL)
+        return;
+
+    hdr = (struct tcache_header *)((char *)ptr - TCACHE_HEADER_SIZE);
+    cls = (unsigned int)hdr->cls;
+    if (cls != TCACHE_NONE && (tc = tcache_get()) != NULL) {
+        if (tc->counts[cls] >= CONFIG_MALLOC_TCACHE_COUNT)
+            tcache_flush(tc, cls, TCACHE_FLUSH_BATCH);
+
+        e = ptr;
+        e->next = tc->bins[cls];
+        tc->bins[cls] = e;
+        tc->counts[cls]++;
+        return;
+    }
+
+    heap_free(hdr);
+}
+
+#else /* !CONFIG_MALLOC_TCACHE */
+static void *general_malloc(size_t size) {
+    return heap_alloc(size);
+}
+
+static void general_free(void *ptr) {
+    if (ptr)
+        heap_free(ptr);
+}
+#endif /* CONFIG_MALLOC_TCACHE */
+
+#ifdef CONFIG_HEAP_PROFILE
+static void *general_malloc_profiled(size_t size, void *caller) {
+    return heap_profile_record(general_malloc(size + HEAP_PROFILE_HEADER_SIZE),
+        size, HEAP_PROFILE_GENERAL, caller);
+}
+
+void *__general_malloc(size_t size) {
+    return general_malloc_profiled(size, __builtin_return_address(0));
+}
+
+void __general_free(void *ptr) {
+    if (ptr)
+        general_free(heap_profile_release(ptr));
+}
+
+#else /* !CONFIG_HEAP_PROFILE */
+void *__general_malloc(size_t size) {
+    return general_malloc(size);
+}
+
+void __general_free(void *ptr) {
+    general_free(ptr);
+}
+#endif /* CONFIG_HEAP_PROFILE */
+
+void *__general_calloc(size_t n, size_t size) {
+    void *p;
+
+    if (size && n > SIZE_MAX / size)
+        return NULL;
+
+    size *= n;
+#ifdef CONFIG_HEAP_PROFILE
+    p = general_malloc_profiled(size, __builtin_return_address(0));
+#else
+    p = general_malloc(size);
+#endif
+    if (p)
+        memset(p, 0, size);
+    return p;
 }
 
 static int malloc_init(void) {
+#ifdef CONFIG_MALLOC_TLSF
+    tlsf_init(&app_heap, _app_pool_byte_start, (size_t)_app_pool_byte_size);
+#else
     tx_byte_pool_create(&app_byte_pool, "application",
         _app_pool_byte_start, (ULONG)_app_pool_byte_size);
+#endif
     return 0;
 }
 
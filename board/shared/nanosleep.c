@@ -103,6 +103,89 @@ UINT tx_os_nanosleep(uint64_t time) {
     return thread_ptr->tx_thread_suspend_status;
 }
 
+/*
+ * Hybrid delay
+ *
+ * A delay longer than twice the measured wakeup latency of
+ * tx_os_nanosleep() sleeps for the bulk and spins on the timer counter
+ * for the rest, a shorter one (or one from interrupt context) only spins.
+ */
+#define DELAY_CALIBRATE_LOOPS 8
+#define DELAY_CALIBRATE_NS    100000
+
+#define DELAY_NS_TO_CYCLES(ns) (HRTIMER_US((uint64_t)(ns)) / 1000)
+#define DELAY_CYCLES_TO_NS(n)  HRTIMER_CYCLE_TO_US((uint64_t)(n) * 1000)
+
+/* Wakeup latency in nanoseconds, 0 until calibrated */
+static uint32_t delay_latency_ns;
+
+static bool delay_can_sleep(void) {
+    TX_THREAD *thread_ptr;
+
+    TX_THREAD_GET_CURRENT(thread_ptr)
+    return thread_ptr != TX_NULL && 
+        TX_THREAD_GET_SYSTEM_STATE() == ((ULONG) 0) &&
+        _tx_thread_preempt_disable == ((UINT) 0);
+}
+
+/*
+ * Spin until @cycles timer cycles have passed since @start. The counter is
+ * 32 bits wide on some boards, so the elapsed time is accumulated poll by
+ * poll. At least @passed cycles are known to be gone already (a sleep),
+ * which keeps the first poll unambiguous after a long sleep.
+ */
+static void delay_spin(uint32_t start, uint64_t cycles, uint64_t passed) {
+    uint32_t prev = start + (uint32_t)passed;
+    uint64_t elapsed = passed;
+
+    while (elapsed < cycles) {
+        uint32_t now = (uint32_t)HRTIMER_JIFFIES;
+
+        elapsed += (uint32_t)(now - prev);
+        prev = now;
+    }
+}
+
 UINT tx_os_delay(uint64_t nano_sec) {
+    uint32_t start = (uint32_t)HRTIMER_JIFFIES;
+    uint32_t latency = delay_latency_ns;
+    uint64_t passed = 0;
+    UINT ret;
+
+    if (latency > 0 && nano_sec > 2 * (uint64_t)latency && delay_can_sleep()) {
+        ret = tx_os_nanosleep(nano_sec - latency);
+        if (ret != TX_SUCCESS)
+            return ret;
+        /* Allow the sleep to end up to one latency early */
+        passed = DELAY_NS_TO_CYCLES(nano_sec - 2 * (uint64_t)latency);
+    }
+
+    delay_spin(start, DELAY_NS_TO_CYCLES(nano_sec), passed);
+    return TX_SUCCESS;
+}
+
+uint32_t tx_os_delay_latency(void) {
+    return delay_latency_ns;
+}
+
+static int tx_os_delay_calibrate(void) {
+    uint64_t total = 0;
+
+    if (!delay_can_sleep())
+        return 0;
+
+    for (int i = 0; i < DELAY_CALIBRATE_LOOPS; i++) {
+        uint32_t start = (uint32_t)HRTIMER_JIFFIES;
+        uint64_t elapsed;
+
+        tx_os_nanosleep(DELAY_CALIBRATE_NS);
+        elapsed = DELAY_CYCLES_TO_NS((uint32_t)(HRTIMER_JIFFIES - start));
+        if (elapsed > DELAY_CALIBRATE_NS)
+            total += elapsed - DELAY_CALIBRATE_NS;
+    }
+
+    delay_latency_ns = (uint32_t)(total / DELAY_CALIBRATE_LOOPS) + 1;
     return 0;
 }
+
+SYSINIT(tx_os_delay_calibrate, SI_PREDRIVER_LEVEL, 90);
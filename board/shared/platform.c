@@ -36,6 +36,10 @@ static void __fastcode put_char(int c, void *arg) {
 int vprintk(const char *fmt, va_list ap) {
 	struct printk_buffer pb;
 
+#ifdef CONFIG_PRINTK_DEFERRED
+	if (__printk_log(fmt, ap) == 0)
+		return 0;
+#endif
 	pb.len = 0;
 	int len = _IO_Vprintf(put_char, &pb, fmt, ap);
 	if (pb.len > 0)
@@ -44,7 +48,7 @@ int vprintk(const char *fmt, va_list ap) {
 	return len;
 }
 
-int printk(const char *fmt, ...) {
+int (printk)(const char *fmt, ...) {
 	va_list ap;
 
 	va_start(ap, fmt);
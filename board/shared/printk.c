@@ -0,0 +1,700 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Deferred printk
+ *
+ * printk() packs the tick count, the format pointer and the raw arguments
+ * into a record of a lock-free multi-producer ring and returns at once.
+ * The printk thread formats the records and writes them to the console.
+ * Strings are copied into the record, the caller's buffer may be gone when
+ * the record is formatted. A string cut at the end of the record ends with
+ * "..." so the truncation shows in the output. The format itself is not
+ * copied: it must be a string literal, which the printk() macro places in
+ * the .log_dict section. A format outside that section (vprintk(), the
+ * pr_*() log macros that reach it through the board printer, or a direct
+ * call of the printk function) is printed synchronously.
+ *
+ * A producer reserves its record by advancing the ring head with a CAS and
+ * publishes it by writing the header last. The consumer stops at the first
+ * record that is not published yet and zeroes what it consumed, so a stale
+ * word is never taken for a header. A record never wraps, the space up to
+ * the end of the ring is filled with a pad record instead.
+ *
+ * With CONFIG_PRINTK_DICTIONARY the records whose format is in the log
+ * dictionary are sent as binary frames instead of text.
+ */
+#include <stdarg.h>
+#include <string.h>
+
+#include "tx_api.h"
+
+#include "basework/lib/iovpr.h"
+
+#ifndef CONFIG_PRINTK_RING_SIZE
+#define CONFIG_PRINTK_RING_SIZE 4096
+#endif
+#ifndef TX_PRINTK_THREAD_STACK_SIZE
+#define TX_PRINTK_THREAD_STACK_SIZE 2048
+#endif
+#ifndef TX_PRINTK_THREAD_PRIO
+#define TX_PRINTK_THREAD_PRIO (TX_MAX_PRIORITIES - 2)
+#endif
+
+#define PRINTK_RING_WORDS   (CONFIG_PRINTK_RING_SIZE / sizeof(uint32_t))
+#define PRINTK_RING_MASK    (PRINTK_RING_WORDS - 1)
+#define PRINTK_RECORD_WORDS 64
+
+/* Record header */
+#define PRINTK_COMMITTED    0x80000000u
+#define PRINTK_PAD          0x40000000u
+#define PRINTK_LEN_MASK     0x0000ffffu
+
+#define PRINTK_PTR_WORDS    (sizeof(void *) / sizeof(uint32_t))
+#define PRINTK_TRUNC_MARK   "..."
+
+#define PRINTK_HDR_WORDS    (2 + PRINTK_PTR_WORDS)
+
+_Static_assert((PRINTK_RING_WORDS & PRINTK_RING_MASK) == 0,
+	"CONFIG_PRINTK_RING_SIZE must be a power of 2");
+
+enum printk_arg {
+	PRINTK_ARG_NONE,
+	PRINTK_ARG_INT,
+	PRINTK_ARG_LONG,
+	PRINTK_ARG_LLONG,
+	PRINTK_ARG_PTR,
+	PRINTK_ARG_DOUBLE,
+	PRINTK_ARG_STR,
+	PRINTK_ARG_INVALID
+};
+
+struct printk_spec {
+	const char *start;
+	const char *end;
+	enum printk_arg type;
+	int stars;
+};
+
+struct printk_line {
+#define LINE_SIZE 256
+	char buf[LINE_SIZE + 2];
+	uint16_t len;
+};
+
+struct printk_log {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped;
+	uint32_t reported;
+	uint32_t records;
+	uint32_t peak;
+	int wakeup;
+	int draining;
+	bool deferred;
+#ifdef CONFIG_PRINTK_TIMESTAMP
+	bool newline;
+#endif
+	TX_SEMAPHORE sem;
+	TX_THREAD thread;
+};
+
+extern const char __log_dict_start[];
+extern const char __log_dict_end[];
+
+static struct printk_log printk_log;
+static uint32_t printk_ring[PRINTK_RING_WORDS] __rte_aligned(8);
+static char printk_stack[TX_PRINTK_THREAD_STACK_SIZE] __rte_aligned(8);
+
+/*
+ * Scan the next conversion of @fmt. Returns NULL at the end of the string
+ */
+static const char *printk_next_spec(const char *fmt, struct printk_spec *spec) {
+	const char *p = strchr(fmt, '%');
+	int lng = 0;
+
+	if (p == NULL)
+		return NULL;
+
+	spec->start = p++;
+	spec->stars = 0;
+	while (*p && strchr("-+ #0", *p))
+		p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	for ( ; ; p++) {
+		if (*p == 'h') {
+			continue;
+		} else if (*p == 'l') {
+			lng++;
+		} else if (*p == 'q' || *p == 'j' || *p == 'L') {
+			lng = 2;
+		} else if (*p == 'z' || *p == 't') {
+			lng = 1;
+		} else {
+			break;
+		}
+	}
+
+	switch (*p) {
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+		spec->type = lng == 0? PRINTK_ARG_INT:
+			(lng == 1? PRINTK_ARG_LONG: PRINTK_ARG_LLONG);
+		break;
+	case 'p':
+		spec->type = PRINTK_ARG_PTR;
+		break;
+	case 's':
+		spec->type = PRINTK_ARG_STR;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+		spec->type = PRINTK_ARG_DOUBLE;
+		break;
+	case '%':
+		spec->type = PRINTK_ARG_NONE;
+		break;
+	default:
+		spec->type = PRINTK_ARG_INVALID;
+		return p;
+	}
+	spec->end = p + 1;
+	return spec->end;
+}
+
+static size_t printk_pack_str(uint32_t *rec, size_t pos, const char *s) {
+	size_t avail = (PRINTK_RECORD_WORDS - pos - 1) * sizeof(uint32_t);
+	size_t len;
+
+	if (s == NULL)
+		s = "(null)";
+	len = strnlen(s, avail - 1);
+	rec[pos++] = (uint32_t)(len + 1);
+	memcpy(&rec[pos], s, len);
+	((char *)&rec[pos])[len] = '\0';
+	if (s[len] != '\0' && len >= sizeof(PRINTK_TRUNC_MARK) - 1)
+		memcpy((char *)&rec[pos] + len - (sizeof(PRINTK_TRUNC_MARK) - 1),
+			PRINTK_TRUNC_MARK, sizeof(PRINTK_TRUNC_MARK) - 1);
+	return pos + rte_div_roundup(len + 1, sizeof(uint32_t));
+}
+
+/*
+ * Pack @fmt and its arguments into @rec, returns the record length in
+ * words or 0 if the format can not be deferred
+ */
+static size_t printk_pack(uint32_t *rec, const char *fmt, va_list ap) {
+	struct printk_spec spec;
+	size_t pos = PRINTK_HDR_WORDS;
+
+	rec[1] = (uint32_t)tx_time_get();
+	memcpy(&rec[2], &fmt, sizeof(fmt));
+
+	while ((fmt = printk_next_spec(fmt, &spec)) != NULL) {
+		/* Leave room for the largest argument and a short string */
+		if (spec.type == PRINTK_ARG_INVALID ||
+			pos + spec.stars + 4 > PRINTK_RECORD_WORDS)
+			return 0;
+
+		for (int i = 0; i < spec.stars; i++)
+			rec[pos++] = (uint32_t)va_arg(ap, int);
+
+		switch (spec.type) {
+		case PRINTK_ARG_INT:
+			rec[pos++] = (uint32_t)va_arg(ap, int);
+			break;
+		case PRINTK_ARG_LONG: {
+			long v = va_arg(ap, long);
+			memcpy(&rec[pos], &v, sizeof(v));
+			pos += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_LLONG: {
+			long long v = va_arg(ap, long long);
+			memcpy(&rec[pos], &v, sizeof(v));
+			pos += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_PTR: {
+			void *v = va_arg(ap, void *);
+			memcpy(&rec[pos], &v, sizeof(v));
+			pos += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_DOUBLE: {
+			double v = va_arg(ap, double);
+			memcpy(&rec[pos], &v, sizeof(v));
+			pos += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_STR:
+			pos = printk_pack_str(rec, pos, va_arg(ap, const char *));
+			break;
+		default:
+			break;
+		}
+	}
+	return pos;
+}
+
+static uint32_t *printk_reserve(uint32_t nwords) {
+	struct printk_log *log = &printk_log;
+	uint32_t head, tail, pad, used;
+
+	head = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+	do {
+		tail = __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE);
+		pad = PRINTK_RING_WORDS - (head & PRINTK_RING_MASK);
+		if (pad >= nwords)
+			pad = 0;
+		used = head - tail + pad + nwords;
+		if (used > PRINTK_RING_WORDS) {
+			__atomic_add_fetch(&log->dropped, 1, __ATOMIC_RELAXED);
+			return NULL;
+		}
+	} while (!__atomic_compare_exchange_n(&log->head, &head, head + pad + nwords,
+		true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	if (used > log->peak)
+		log->peak = used;
+	if (pad > 0) {
+		__atomic_store_n(&printk_ring[head & PRINTK_RING_MASK],
+			PRINTK_COMMITTED | PRINTK_PAD | pad, __ATOMIC_RELEASE);
+		head += pad;
+	}
+	return &printk_ring[head & PRINTK_RING_MASK];
+}
+
+int __printk_log(const char *fmt, va_list ap) {
+	struct printk_log *log = &printk_log;
+	uint32_t rec[PRINTK_RECORD_WORDS];
+	uint32_t *slot;
+	size_t nwords;
+	va_list args;
+
+	if (!__atomic_load_n(&log->deferred, __ATOMIC_RELAXED))
+		return -EAGAIN;
+
+	/* Only the formats of the .log_dict section outlive the call */
+	if (fmt < __log_dict_start || fmt >= __log_dict_end)
+		return -EAGAIN;
+
+	va_copy(args, ap);
+	nwords = printk_pack(rec, fmt, args);
+	va_end(args);
+	if (nwords == 0)
+		return -EAGAIN;
+
+	slot = printk_reserve(nwords);
+	if (slot == NULL)
+		return 0;
+
+	memcpy(slot + 1, rec + 1, (nwords - 1) * sizeof(uint32_t));
+	__atomic_store_n(slot, PRINTK_COMMITTED | nwords, __ATOMIC_RELEASE);
+
+	if (!__atomic_exchange_n(&log->wakeup, 1, __ATOMIC_ACQ_REL))
+		tx_semaphore_put(&log->sem);
+	return 0;
+}
+
+static void printk_putc(int c, void *arg) {
+	struct printk_line *p = (struct printk_line *)arg;
+
+	if (rte_likely(p->len < LINE_SIZE)) {
+		if (c == '\n')
+			p->buf[p->len++] = '\r';
+		p->buf[p->len++] = (char)c;
+	}
+}
+
+static void printk_emit(struct printk_line *line, const char *spec, ...) {
+	va_list ap;
+
+	va_start(ap, spec);
+	_IO_Vprintf(printk_putc, line, spec, ap);
+	va_end(ap);
+}
+
+static const uint32_t *printk_emit_arg(struct printk_line *line,
+	const struct printk_spec *spec, const uint32_t *arg) {
+	char buf[32];
+	size_t len = 0;
+
+	/* Substitute '*' with the recorded width and precision */
+	for (const char *p = spec->start; p < spec->end && len < sizeof(buf) - 12; p++) {
+		if (*p == '*') {
+			int v = (int)*arg++;
+			char digits[12];
+			int n = 0;
+
+			if (v < 0) {
+				buf[len++] = '-';
+				v = -v;
+			}
+			do {
+				digits[n++] = '0' + v % 10;
+				v /= 10;
+			} while (v > 0);
+			while (n > 0)
+				buf[len++] = digits[--n];
+			continue;
+		}
+		buf[len++] = *p;
+	}
+	buf[len] = '\0';
+
+	switch (spec->type) {
+	case PRINTK_ARG_INT:
+		printk_emit(line, buf, (int)*arg);
+		return arg + 1;
+	case PRINTK_ARG_LONG: {
+		long v;
+		memcpy(&v, arg, sizeof(v));
+		printk_emit(line, buf, v);
+		return arg + sizeof(v) / sizeof(uint32_t);
+	}
+	case PRINTK_ARG_LLONG: {
+		long long v;
+		memcpy(&v, arg, sizeof(v));
+		printk_emit(line, buf, v);
+		return arg + sizeof(v) / sizeof(uint32_t);
+	}
+	case PRINTK_ARG_PTR: {
+		void *v;
+		memcpy(&v, arg, sizeof(v));
+		printk_emit(line, buf, v);
+		return arg + sizeof(v) / sizeof(uint32_t);
+	}
+	case PRINTK_ARG_DOUBLE: {
+		double v;
+		memcpy(&v, arg, sizeof(v));
+		printk_emit(line, buf, v);
+		return arg + sizeof(v) / sizeof(uint32_t);
+	}
+	case PRINTK_ARG_STR:
+		printk_emit(line, buf, (const char *)(arg + 1));
+		return arg + 1 + rte_div_roundup(*arg, sizeof(uint32_t));
+	default:
+		printk_putc('%', line);
+		return arg;
+	}
+}
+
+static void printk_format(const uint32_t *rec, struct printk_line *line) {
+	struct printk_spec spec;
+	const uint32_t *arg = rec + PRINTK_HDR_WORDS;
+	const char *fmt, *next;
+
+	memcpy(&fmt, &rec[2], sizeof(fmt));
+	line->len = 0;
+
+#ifdef CONFIG_PRINTK_TIMESTAMP
+	if (printk_log.newline)
+		printk_emit(line, "[%u] ", (unsigned int)rec[1]);
+#endif
+
+	while ((next = printk_next_spec(fmt, &spec)) != NULL) {
+		while (fmt < spec.start)
+			printk_putc(*fmt++, line);
+		arg = printk_emit_arg(line, &spec, arg);
+		fmt = next;
+	}
+	while (*fmt)
+		printk_putc(*fmt++, line);
+
+#ifdef CONFIG_PRINTK_TIMESTAMP
+	printk_log.newline = line->len > 0 && line->buf[line->len - 1] == '\n';
+#endif
+}
+
+#ifdef CONFIG_PRINTK_DICTIONARY
+/*
+ * Binary log frame (decoded by scripts/log_decoder.py)
+ *
+ *  magic(0xA5) | length | payload | checksum
+ *
+ * The payload starts with a varint of (value << 2 | type). A dictionary
+ * record carries the format offset in the log dictionary as value and is
+ * followed by the tick delta and the arguments: integers and pointers as
+ * varints of their bit pattern, doubles as 8 little endian bytes and
+ * strings as a varint length and the characters. A text frame carries
+ * the formatted text of a format that is not in the dictionary, a drop
+ * frame the number of dropped records. The checksum is the low byte of
+ * the sum of the length and payload bytes.
+ */
+#define PRINTK_FRAME_MAGIC   0xA5
+#define PRINTK_FRAME_DICT    0
+#define PRINTK_FRAME_TEXT    1
+#define PRINTK_FRAME_DROP    2
+#define PRINTK_FRAME_PAYLOAD 255
+
+struct printk_frame {
+	uint8_t buf[PRINTK_FRAME_PAYLOAD + 16];
+	uint16_t len;
+};
+
+
+static void printk_frame_varint(struct printk_frame *f, uint64_t v) {
+	while (v >= 0x80) {
+		f->buf[f->len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	f->buf[f->len++] = (uint8_t)v;
+}
+
+static void printk_frame_begin(struct printk_frame *f, uint32_t value,
+	int type) {
+	f->buf[0] = PRINTK_FRAME_MAGIC;
+	f->len = 2;
+	printk_frame_varint(f, ((uint64_t)value << 2) | type);
+}
+
+static void printk_frame_end(struct printk_frame *f) {
+	uint8_t sum;
+
+	f->buf[1] = (uint8_t)(f->len - 2);
+	sum = 0;
+	for (int i = 1; i < f->len; i++)
+		sum += f->buf[i];
+	f->buf[f->len++] = sum;
+	__console_puts((const char *)f->buf, f->len);
+}
+
+static void printk_frame_text(const char *text, size_t len) {
+	struct printk_frame f;
+
+	printk_frame_begin(&f, 0, PRINTK_FRAME_TEXT);
+	if (len > PRINTK_FRAME_PAYLOAD - 1)
+		len = PRINTK_FRAME_PAYLOAD - 1;
+	memcpy(&f.buf[f.len], text, len);
+	f.len += len;
+	printk_frame_end(&f);
+}
+
+/*
+ * Encode a dictionary record, returns false if it does not fit a frame
+ */
+static bool printk_encode(const uint32_t *rec, const char *fmt) {
+	static uint32_t last_tick;
+	const uint32_t *arg = rec + PRINTK_HDR_WORDS;
+	struct printk_spec spec;
+	struct printk_frame f;
+
+	printk_frame_begin(&f, (uint32_t)(fmt - __log_dict_start), PRINTK_FRAME_DICT);
+	printk_frame_varint(&f, rec[1] - last_tick);
+
+	while ((fmt = printk_next_spec(fmt, &spec)) != NULL) {
+		/* The largest argument takes 10 bytes */
+		if (f.len + 10 * (spec.stars + 1) > PRINTK_FRAME_PAYLOAD + 2)
+			return false;
+
+		for (int i = 0; i < spec.stars; i++)
+			printk_frame_varint(&f, *arg++);
+
+		switch (spec.type) {
+		case PRINTK_ARG_INT:
+			printk_frame_varint(&f, *arg++);
+			break;
+		case PRINTK_ARG_LONG: {
+			long v;
+			memcpy(&v, arg, sizeof(v));
+			printk_frame_varint(&f, (unsigned long)v);
+			arg += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_LLONG: {
+			long long v;
+			memcpy(&v, arg, sizeof(v));
+			printk_frame_varint(&f, (unsigned long long)v);
+			arg += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_PTR: {
+			uintptr_t v;
+			memcpy(&v, arg, sizeof(v));
+			printk_frame_varint(&f, v);
+			arg += sizeof(v) / sizeof(uint32_t);
+			break;
+		}
+		case PRINTK_ARG_DOUBLE:
+			/* Both of our targets are little endian */
+			memcpy(&f.buf[f.len], arg, sizeof(double));
+			f.len += sizeof(double);
+			arg += sizeof(double) / sizeof(uint32_t);
+			break;
+		case PRINTK_ARG_STR: {
+			size_t len = *arg - 1;
+
+			if (f.len + len + 3 > PRINTK_FRAME_PAYLOAD + 2)
+				return false;
+			printk_frame_varint(&f, len);
+			memcpy(&f.buf[f.len], arg + 1, len);
+			f.len += len;
+			arg += 1 + rte_div_roundup(*arg, sizeof(uint32_t));
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	last_tick = rec[1];
+	printk_frame_end(&f);
+	return true;
+}
+
+static void printk_output(const uint32_t *rec) {
+	struct printk_line line;
+	const char *fmt;
+
+	memcpy(&fmt, &rec[2], sizeof(fmt));
+	if (printk_encode(rec, fmt))
+		return;
+
+	printk_format(rec, &line);
+	if (line.len > 0)
+		printk_frame_text(line.buf, line.len);
+}
+
+static void printk_report_drops(struct printk_log *log) {
+	uint32_t dropped = __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+	struct printk_frame f;
+
+	if (dropped == log->reported)
+		return;
+
+	printk_frame_begin(&f, dropped - log->reported, PRINTK_FRAME_DROP);
+	log->reported = dropped;
+	printk_frame_end(&f);
+}
+
+#else /* !CONFIG_PRINTK_DICTIONARY */
+static void printk_output(const uint32_t *rec) {
+	struct printk_line line;
+
+	printk_format(rec, &line);
+	if (line.len > 0)
+		__console_puts(line.buf, line.len);
+}
+
+static void printk_report_drops(struct printk_log *log) {
+	uint32_t dropped = __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+	struct printk_line line;
+
+	if (dropped == log->reported)
+		return;
+
+	line.len = 0;
+	printk_emit(&line, "*** printk: %u messages dropped ***\n",
+		(unsigned int)(dropped - log->reported));
+	log->reported = dropped;
+	__console_puts(line.buf, line.len);
+}
+#endif /* CONFIG_PRINTK_DICTIONARY */
+
+/*
+ * Output the published records. Only one context drains at a time unless
+ * @force is set (panic), returns false if another context is draining
+ */
+static bool printk_drain(bool force) {
+	struct printk_log *log = &printk_log;
+	uint32_t tail, hdr, nwords;
+	uint32_t *rec;
+
+	if (__atomic_exchange_n(&log->draining, 1, __ATOMIC_ACQUIRE) && !force)
+		return false;
+
+	tail = __atomic_load_n(&log->tail, __ATOMIC_RELAXED);
+	for ( ; ; ) {
+		rec = &printk_ring[tail & PRINTK_RING_MASK];
+		hdr = __atomic_load_n(rec, __ATOMIC_ACQUIRE);
+		if (!(hdr & PRINTK_COMMITTED))
+			break;
+
+		nwords = hdr & PRINTK_LEN_MASK;
+		if (!(hdr & PRINTK_PAD)) {
+			printk_output(rec);
+			log->records++;
+		}
+		memset(rec, 0, nwords * sizeof(uint32_t));
+		tail += nwords;
+		__atomic_store_n(&log->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	printk_report_drops(log);
+	__atomic_store_n(&log->draining, 0, __ATOMIC_RELEASE);
+	return true;
+}
+
+void printk_flush(void) {
+	struct printk_log *log = &printk_log;
+	uint32_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+
+	while ((int32_t)(__atomic_load_n(&log->tail, __ATOMIC_ACQUIRE) - head) < 0) {
+		/* The producer of the next record may have been preempted */
+		if (!printk_drain(false) ||
+			(int32_t)(__atomic_load_n(&log->tail, __ATOMIC_ACQUIRE) - head) < 0)
+			tx_thread_sleep(1);
+	}
+}
+
+void printk_panic(void) {
+	__atomic_store_n(&printk_log.deferred, false, __ATOMIC_RELEASE);
+	printk_drain(true);
+}
+
+bool printk_set_deferred(bool enable) {
+	return __atomic_exchange_n(&printk_log.deferred, enable, __ATOMIC_ACQ_REL);
+}
+
+void printk_get_stat(struct printk_stat *stat) {
+	struct printk_log *log = &printk_log;
+
+	stat->records = log->records;
+	stat->dropped = __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+	stat->pending = (__atomic_load_n(&log->head, __ATOMIC_ACQUIRE) -
+		__atomic_load_n(&log->tail, __ATOMIC_ACQUIRE)) * sizeof(uint32_t);
+	stat->peak = log->peak * sizeof(uint32_t);
+	stat->size = CONFIG_PRINTK_RING_SIZE;
+}
+
+static void printk_thread(void *arg) {
+	struct printk_log *log = arg;
+
+	for ( ; ; ) {
+		tx_semaphore_get(&log->sem, TX_WAIT_FOREVER);
+		__atomic_store_n(&log->wakeup, 0, __ATOMIC_RELEASE);
+		printk_drain(false);
+	}
+}
+
+static int printk_init(void) {
+	struct printk_log *log = &printk_log;
+	int err;
+
+	tx_semaphore_create(&log->sem, "printk", 0);
+	err = tx_thread_spawn(&log->thread, "printk", printk_thread, log,
+		printk_stack, sizeof(printk_stack), TX_PRINTK_THREAD_PRIO,
+		TX_PRINTK_THREAD_PRIO, TX_NO_TIME_SLICE, TX_AUTO_START);
+	if (err)
+		return -EINVAL;
+
+#ifdef CONFIG_PRINTK_TIMESTAMP
+	log->newline = true;
+#endif
+	printk_set_deferred(true);
+	return 0;
+}
+
+SYSINIT(printk_init, SI_MEMORY_LEVEL, 82);
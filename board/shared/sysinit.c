@@ -1,18 +1,348 @@
 /*
  * Copyright 2024 wtcat
+ *
+ * System initialize
+ *
+ * The items run level by level. Inside a level a SYSINIT item waits for
+ * the SYSINIT items linked before it but not for the async ones, so a tree
+ * without async items initializes exactly in link order. An async item
+ * only waits for its dependencies, with CONFIG_SYSINIT_PARALLEL it runs on
+ * a worker of the boot task pool while the main thread goes on with the
+ * level. The main thread runs with preemption disabled during the
+ * initialization, so the workers make progress whenever it blocks: in a
+ * slow handler or at the level barrier.
+ *
+ * Every handler is timed in ticks and the totals are printed when the
+ * initialization is done. With CONFIG_SYSINIT_PARALLEL the report also
+ * lists the start and end of each item and the critical path, the item
+ * timings are not kept otherwise.
  */
+#include <string.h>
+
 #include "tx_api.h"
 
+#ifndef CONFIG_SYSINIT_WORKERS
+#define CONFIG_SYSINIT_WORKERS 2
+#endif
+#ifndef CONFIG_SYSINIT_STACK_SIZE
+#define CONFIG_SYSINIT_STACK_SIZE 4096
+#endif
+#ifndef TX_SYSINIT_WORKER_PRIO
+#define TX_SYSINIT_WORKER_PRIO 11
+#endif
+
+#define SYSINIT_LEVEL(_item) ((_item)->order >> 8)
+#define SYSINIT_TICKS_TO_MS(_ticks) \
+    ((uint32_t)((uint64_t)(_ticks) * 1000 / TX_TIMER_TICKS_PER_SECOND))
+
+enum sysinit_status {
+    SI_PENDING,
+    SI_RUNNING,
+    SI_DONE
+};
+
+struct sysinit_context {
+    TX_SEMAPHORE done;
+    ULONG base;
+    ULONG serial;   /* Sum of the handler times */
+    unsigned int running;
+#ifdef CONFIG_SYSINIT_PARALLEL
+    struct task_pool pool;
+    bool pool_ready;
+#endif
+};
+
 LINKER_ROSET(sysinit, struct sysinit_item);
 
+static struct sysinit_context sysinit_ctx;
+static struct sysinit_stat sysinit_stat;
+
+#ifdef CONFIG_SYSINIT_PARALLEL
+static struct task_pool_worker sysinit_workers[CONFIG_SYSINIT_WORKERS];
+static ULONG sysinit_stack[CONFIG_SYSINIT_WORKERS]
+    [CONFIG_SYSINIT_STACK_SIZE / sizeof(ULONG)];
+#endif
+
+static inline uint8_t sysinit_status(const struct sysinit_item *item) {
+    return __atomic_load_n(&item->state->status, __ATOMIC_ACQUIRE);
+}
+
+static const struct sysinit_item *sysinit_find(const char *name) {
+    LINKER_SET_FOREACH(sysinit, item, struct sysinit_item) {
+        if (!strcmp(item->name, name))
+            return item;
+    }
+    return NULL;
+}
+
+static void sysinit_run(const struct sysinit_item *item) {
+    struct sysinit_state *state = item->state;
+    ULONG start, end;
+    int err;
+
+    printk("[%04x] => %s\n", item->order, item->name);
+    start = tx_time_get();
+    err = item->handler();
+    end = tx_time_get();
+    __atomic_fetch_add(&sysinit_ctx.serial, end - start, __ATOMIC_RELAXED);
+#ifdef CONFIG_SYSINIT_PARALLEL
+    state->start = start - sysinit_ctx.base;
+    state->end = end - sysinit_ctx.base;
+#endif
+    state->err = err;
+    if (err)
+        printk("!Failed to execute %s (%d)\n", item->name, err);
+}
+
+#ifdef CONFIG_SYSINIT_PARALLEL
+static void sysinit_async_handler(struct task *task) {
+    struct sysinit_state *state = rte_container_of(task,
+        struct sysinit_state, task);
+
+    sysinit_run(state->item);
+    __atomic_store_n(&state->status, SI_DONE, __ATOMIC_RELEASE);
+    tx_semaphore_put(&sysinit_ctx.done);
+}
+
+static bool sysinit_post(const struct sysinit_item *item) {
+    struct sysinit_context *ctx = &sysinit_ctx;
+
+    if (!ctx->pool_ready) {
+        if (task_pool_construct(&ctx->pool, sysinit_workers,
+            CONFIG_SYSINIT_WORKERS, "sysinit", sysinit_stack,
+            sizeof(sysinit_stack[0]), TX_SYSINIT_WORKER_PRIO, -1))
+            return false;
+        ctx->pool_ready = true;
+    }
+
+    item->state->task.handler = sysinit_async_handler;
+    item->state->status = SI_RUNNING;
+    ctx->running++;
+    task_pool_post(&ctx->pool, &item->state->task);
+    return true;
+}
+#endif /* CONFIG_SYSINIT_PARALLEL */
+
+static void sysinit_start(const struct sysinit_item *item) {
+#ifdef CONFIG_SYSINIT_PARALLEL
+    if ((item->flags & SYSINIT_F_ASYNC) && sysinit_post(item))
+        return;
+#endif
+    sysinit_run(item);
+    item->state->status = SI_DONE;
+}
+
+/* Dependencies that are missing or in a later level are ignored */
+static bool sysinit_depends_valid(const struct sysinit_item *item,
+    const struct sysinit_item *dep) {
+    return dep != NULL && dep != item && SYSINIT_LEVEL(dep) <= SYSINIT_LEVEL(item);
+}
+
+/*
+ * A plain item waits for the plain items before it in its level, the
+ * asynchronous ones only for the items they name
+ */
+static bool sysinit_ready(const struct sysinit_item *item,
+    const struct sysinit_item *first) {
+    if (!(item->flags & SYSINIT_F_ASYNC)) {
+        for (const struct sysinit_item *it = first; it < item; it++) {
+            if (!(it->flags & SYSINIT_F_ASYNC) && sysinit_status(it) != SI_DONE)
+                return false;
+        }
+        return true;
+    }
+
+    if (item->depends == NULL)
+        return true;
+
+    for (const char *const *name = item->depends; *name != NULL; name++) {
+        const struct sysinit_item *dep = sysinit_find(*name);
+
+        if (sysinit_depends_valid(item, dep) && sysinit_status(dep) != SI_DONE)
+            return false;
+    }
+    return true;
+}
+
+static void sysinit_level(const struct sysinit_item *first,
+    const struct sysinit_item *last) {
+    struct sysinit_context *ctx = &sysinit_ctx;
+
+    for ( ; ; ) {
+        const struct sysinit_item *next = NULL;
+        const struct sysinit_item *blocked = NULL;
+
+        /* Rescan from the start, a completion may unblock earlier items */
+        for (const struct sysinit_item *it = first; it < last; it++) {
+            if (it->state->status != SI_PENDING)
+                continue;
+            if (sysinit_ready(it, first)) {
+                next = it;
+                break;
+            }
+            if (blocked == NULL)
+                blocked = it;
+        }
+
+        if (next != NULL) {
+            sysinit_start(next);
+            continue;
+        }
+
+        if (ctx->running > 0) {
+            tx_semaphore_get(&ctx->done, TX_WAIT_FOREVER);
+            ctx->running--;
+            continue;
+        }
+
+        if (blocked == NULL)
+            break;
+
+        printk("!sysinit: dependency cycle at %s\n", blocked->name);
+        sysinit_run(blocked);
+        blocked->state->status = SI_DONE;
+    }
+}
+
+static void sysinit_check_depends(void) {
+    LINKER_SET_FOREACH(sysinit, item, struct sysinit_item) {
+#ifdef CONFIG_SYSINIT_PARALLEL
+        item->state->item = item;
+#endif
+        item->state->status = SI_PENDING;
+        if (item->depends == NULL)
+            continue;
+
+        for (const char *const *name = item->depends; *name != NULL; name++) {
+            if (!sysinit_depends_valid(item, sysinit_find(*name)))
+                printk("!sysinit: %s ignores dependency %s\n", item->name, *name);
+        }
+    }
+}
+
+#ifdef CONFIG_SYSINIT_PARALLEL
+/*
+ * The predecessor of @item that completed last: any item of an earlier
+ * level, the items linked before a SYSINIT item or the dependencies of an
+ * async item.
+ */
+static const struct sysinit_item *sysinit_critical_pred(
+    const struct sysinit_item *item) {
+    const struct sysinit_item *pred = NULL;
+
+    LINKER_SET_FOREACH(sysinit, it, struct sysinit_item) {
+        bool depends = false;
+
+        if (SYSINIT_LEVEL(it) < SYSINIT_LEVEL(item)) {
+            depends = true;
+        } else if (SYSINIT_LEVEL(it) == SYSINIT_LEVEL(item)) {
+            if (!(item->flags & SYSINIT_F_ASYNC)) {
+                depends = it < item && !(it->flags & SYSINIT_F_ASYNC);
+            } else if (item->depends != NULL) {
+                for (const char *const *name = item->depends; *name; name++) {
+                    if (!strcmp(it->name, *name) && it != item) {
+                        depends = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (depends && (pred == NULL || it->state->end >= pred->state->end))
+            pred = it;
+    }
+    return pred;
+}
+
+/* Print the item timings, returns the item that completed last */
+static const struct sysinit_item *sysinit_report_items(void) {
+    const struct sysinit_item *tail = NULL;
+
+    printk("\n*** System Initialize Profile (ms) ***\n"
+        " ORDER | START  | END    | TIME   | NAME\n"
+        "-------+--------+--------+--------+---------------------\n");
+    LINKER_SET_FOREACH(sysinit, item, struct sysinit_item) {
+        struct sysinit_state *state = item->state;
+        uint32_t start = SYSINIT_TICKS_TO_MS(state->start);
+        uint32_t end = SYSINIT_TICKS_TO_MS(state->end);
+
+        printk(" %02x%02x%c | %-6u | %-6u | %-6u | %s\n", SYSINIT_LEVEL(item),
+            item->order & 0xFF, (item->flags & SYSINIT_F_ASYNC)? 'A': ' ',
+            (unsigned int)start, (unsigned int)end,
+            (unsigned int)(end - start), item->name);
+        if (tail == NULL || state->end >= tail->state->end)
+            tail = item;
+    }
+    return tail;
+}
+
+/* Walk back from the item that completed last */
+static void sysinit_report_path(const struct sysinit_item *it, uint32_t items) {
+    printk("critical path:\n");
+    for (uint32_t n = 0; it != NULL && n < items; n++) {
+        if (it->state->end > it->state->start)
+            printk("  <- %s (%u ms)\n", it->name,
+                (unsigned int)SYSINIT_TICKS_TO_MS(it->state->end - it->state->start));
+        it = sysinit_critical_pred(it);
+    }
+}
+#endif /* CONFIG_SYSINIT_PARALLEL */
+
+static void sysinit_report(void) {
+    uint32_t items = 0, async = 0;
+
+    LINKER_SET_FOREACH(sysinit, item, struct sysinit_item) {
+        items++;
+        if (item->flags & SYSINIT_F_ASYNC)
+            async++;
+    }
+
+    sysinit_stat.items = items;
+    sysinit_stat.async = async;
+    sysinit_stat.serial_ms = SYSINIT_TICKS_TO_MS(sysinit_ctx.serial);
+    sysinit_stat.boot_ms = SYSINIT_TICKS_TO_MS(tx_time_get() - sysinit_ctx.base);
+#ifdef CONFIG_SYSINIT_PARALLEL
+    const struct sysinit_item *tail = sysinit_report_items();
+#endif
+    printk("boot %u ms, serial %u ms\n", (unsigned int)sysinit_stat.boot_ms,
+        (unsigned int)sysinit_stat.serial_ms);
+#ifdef CONFIG_SYSINIT_PARALLEL
+    sysinit_report_path(tail, items);
+#endif
+}
+
+void sysinit_get_stat(struct sysinit_stat *stat) {
+    *stat = sysinit_stat;
+}
+
 void do_sysinit(void) {
-    int no = 0;
+    struct sysinit_context *ctx = &sysinit_ctx;
+    struct sysinit_item *first = NULL;
+    struct sysinit_item *last = NULL;
 
     printk("\n*** System Initialize ***\n");
+    tx_semaphore_create(&ctx->done, (CHAR *)"sysinit", 0);
+    ctx->base = tx_time_get();
+    sysinit_check_depends();
+
     LINKER_SET_FOREACH(sysinit, item, struct sysinit_item) {
-        printk("[%02d] => %s\n", no++, item->name);
-        int err = item->handler();
-        if (err)
-            printk("!Failed to execute %s (%d)\n", item->name, err);
+        if (first != NULL && SYSINIT_LEVEL(item) != SYSINIT_LEVEL(first)) {
+            sysinit_level(first, item);
+            first = NULL;
+        }
+        if (first == NULL)
+            first = item;
+        last = item + 1;
+    }
+    if (first != NULL)
+        sysinit_level(first, last);
+
+#ifdef CONFIG_SYSINIT_PARALLEL
+    if (ctx->pool_ready) {
+        task_pool_destroy(&ctx->pool);
+        ctx->pool_ready = false;
     }
+#endif
+    tx_semaphore_delete(&ctx->done);
+    sysinit_report();
 }
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2024 wtcat
+ *
+ * Work-stealing task pool
+ *
+ * Each worker owns a deque. Tasks posted from inside a worker are pushed
+ * to the head of its own deque and popped from there (newest first, still
+ * hot in cache). Tasks posted from outside are spread round-robin and go
+ * to the tail. A worker that runs dry steals the oldest task from the tail
+ * of the other workers before going to sleep.
+ *
+ * The deques are protected by TX_DISABLE/TX_RESTORE rather than the os_irq
+ * guard, on the SMP kernel these take the inter-core protection lock.
+ */
+
+#include <errno.h>
+#include "tx_api.h"
+
+#include "basework/assert.h"
+
+struct parallel_context {
+    void (*fn)(size_t begin, size_t end, void *arg);
+    void *arg;
+    unsigned int remaining;
+    TX_SEMAPHORE done;
+};
+
+struct parallel_chunk {
+    struct task base;
+    size_t begin;
+    size_t end;
+    struct parallel_context *ctx;
+};
+
+_Static_assert(TASK_POOL_MAX_WORKERS <= 32, "");
+_Static_assert(CONFIG_TASK_POOL_MAX_CHUNKS >= 1, "");
+
+static struct task_pool_worker *task_pool_self(struct task_pool *pool) {
+    TX_THREAD *thread = tx_thread_identify();
+    struct task_pool_worker *end = pool->workers + pool->nr_workers;
+
+    if ((void *)thread < (void *)pool->workers || (void *)thread >= (void *)end)
+        return NULL;
+    return rte_container_of(thread, struct task_pool_worker, pid);
+}
+
+/* Must be called with interrupt disabled */
+static struct task *task_pool_steal(struct task_pool *pool,
+    struct task_pool_worker *self) {
+    unsigned int start = self? (unsigned int)(self - pool->workers): pool->next;
+    struct task_pool_worker *victim;
+    struct task *task;
+
+    for (unsigned int i = 0; i < pool->nr_workers; i++) {
+        victim = &pool->workers[(start + i) % pool->nr_workers];
+        if (victim == self || rte_list_empty(&victim->deque))
+            continue;
+
+        task = rte_list_entry(victim->deque.prev, struct task, node);
+        rte_list_del(&task->node);
+        task->node.next = NULL;
+        victim->depth--;
+        if (self)
+            self->stolen++;
+        return task;
+    }
+
+    return NULL;
+}
+
+/* Must be called with interrupt disabled */
+static struct task *task_pool_grab(struct task_pool *pool,
+    struct task_pool_worker *self) {
+    struct task *task;
+
+    if (!rte_list_empty(&self->deque)) {
+        task = rte_list_first_entry(&self->deque, struct task, node);
+        rte_list_del(&task->node);
+        task->node.next = NULL;
+        self->depth--;
+        return task;
+    }
+
+    return task_pool_steal(pool, self);
+}
+
+/* Must be called with interrupt disabled */
+static struct task_pool_worker *task_pool_wake_idle(struct task_pool *pool) {
+    unsigned int idx;
+
+    if (pool->idle_map == 0)
+        return NULL;
+
+    idx = (unsigned int)__builtin_ctz(pool->idle_map);
+    pool->idle_map &= ~(1u << idx);
+    return &pool->workers[idx];
+}
+
+static void task_pool_thread(void *arg) {
+    struct task_pool_worker *self = arg;
+    struct task_pool *pool = self->pool;
+    uint32_t self_bit = 1u << (self - pool->workers);
+    struct task_pool_worker *buddy;
+    struct task *task;
+    TX_INTERRUPT_SAVE_AREA
+
+    TX_DISABLE
+
+    for ( ; ; ) {
+        task = task_pool_grab(pool, self);
+        if (task == NULL) {
+            pool->idle_map |= self_bit;
+            TX_RESTORE
+            tx_semaphore_get(&self->sem, TX_WAIT_FOREVER);
+
+            TX_DISABLE
+            continue;
+        }
+
+        /*
+         * There is still work queued somewhere, pass the baton to
+         * another idle worker
+         */
+        pool->idle_map &= ~self_bit;
+        buddy = NULL;
+        if (!rte_list_empty(&self->deque))
+            buddy = task_pool_wake_idle(pool);
+        TX_RESTORE
+
+        if (buddy)
+            tx_semaphore_ceiling_put(&buddy->sem, 1);
+
+        task->handler(task);
+        self->executed++;
+
+        TX_DISABLE
+    }
+}
+
+int task_pool_post(struct task_pool *pool, struct task *task) {
+    struct task_pool_worker *self, *target, *wake;
+    TX_INTERRUPT_SAVE_AREA
+
+    rte_assert(pool != NULL);
+    if (task == NULL)
+        return -EINVAL;
+
+    self = task_pool_self(pool);
+
+    TX_DISABLE
+    if (task->node.next != NULL) {
+        TX_RESTORE
+        return -EBUSY;
+    }
+
+    /* Tasks are not owned by a runner, stealing is always allowed */
+    task->runner = NULL;
+    if (self) {
+        target = self;
+        rte_list_add(&task->node, &self->deque);
+    } else {
+        target = &pool->workers[pool->next];
+        pool->next = (pool->next + 1) % pool->nr_workers;
+        rte_list_add_tail(&task->node, &target->deque);
+    }
+    target->depth++;
+
+    /* Prefer the owner, otherwise wake any idle worker to steal it */
+    wake = NULL;
+    if (pool->idle_map & (1u << (target - pool->workers))) {
+        pool->idle_map &= ~(1u << (target - pool->workers));
+        wake = target;
+    } else if (target != self) {
+        wake = task_pool_wake_idle(pool);
+    }
+    TX_RESTORE
+
+    if (wake)
+        return (int)tx_semaphore_ceiling_put(&wake->sem, 1);
+    return 0;
+}
+
+static void parallel_chunk_handler(struct task *task) {
+    struct parallel_chunk *chunk = (struct parallel_chunk *)task;
+    struct parallel_context *ctx = chunk->ctx;
+    unsigned int remaining;
+    TX_INTERRUPT_SAVE_AREA
+
+    ctx->fn(chunk->begin, chunk->end, ctx->arg);
+
+    TX_DISABLE
+    remaining = --ctx->remaining;
+    TX_RESTORE
+
+    if (remaining == 0)
+        tx_semaphore_ceiling_put(&ctx->done, 1);
+}
+
+/*
+ * Split [begin, end) into chunks of at least @grain items (0 lets the pool
+ * pick one from the number of workers) and run @fn on each of them. The
+ * caller runs the first chunk and helps with queued tasks until all chunks
+ * are done, so it is safe to call from inside a worker.
+ */
+int task_pool_parallel_for(struct task_pool *pool, size_t begin, size_t end,
+    size_t grain, void (*fn)(size_t begin, size_t end, void *arg), void *arg) {
+    struct parallel_chunk chunks[CONFIG_TASK_POOL_MAX_CHUNKS];
+    struct parallel_context ctx;
+    struct task_pool_worker *self;
+    struct task *task;
+    size_t count, nchunks, step;
+    TX_INTERRUPT_SAVE_AREA
+
+    rte_assert(pool != NULL);
+    if (fn == NULL || end < begin)
+        return -EINVAL;
+
+    count = end - begin;
+    if (count == 0)
+        return 0;
+
+    if (grain == 0)
+        grain = rte_div_roundup(count, pool->nr_workers * 2);
+    nchunks = rte_div_roundup(count, grain);
+    if (nchunks > CONFIG_TASK_POOL_MAX_CHUNKS)
+        nchunks = CONFIG_TASK_POOL_MAX_CHUNKS;
+    step = rte_div_roundup(count, nchunks);
+    nchunks = rte_div_roundup(count, step);
+
+    ctx.fn = fn;
+    ctx.arg = arg;
+    ctx.remaining = (unsigned int)nchunks;
+    tx_semaphore_create(&ctx.done, "parallel_for", 0);
+
+    for (size_t i = 0; i < nchunks; i++) {
+        struct parallel_chunk *chunk = &chunks[i];
+
+        init_task(&chunk->base, parallel_chunk_handler);
+        chunk->begin = begin + i * step;
+        chunk->end = chunk->begin + step < end? chunk->begin + step: end;
+        chunk->ctx = &ctx;
+        if (i > 0)
+            task_pool_post(pool, &chunk->base);
+    }
+
+    parallel_chunk_handler(&chunks[0].base);
+
+    /* Help the workers instead of just blocking */
+    self = task_pool_self(pool);
+    for ( ; ; ) {
+        TX_DISABLE
+        if (ctx.remaining == 0) {
+            TX_RESTORE
+            break;
+        }
+        task = self? task_pool_grab(pool, self): task_pool_steal(pool, NULL);
+        TX_RESTORE
+
+        if (task == NULL)
+            break;
+        task->handler(task);
+    }
+
+    /*
+     * The last chunk signals @done exactly once, wait for it so that no
+     * worker touches @ctx after we return
+     */
+    tx_semaphore_get(&ctx.done, TX_WAIT_FOREVER);
+    tx_semaphore_delete(&ctx.done);
+    return 0;
+}
+
+int task_pool_construct(struct task_pool *pool, struct task_pool_worker *workers,
+    unsigned int nr_workers, const char *name, void *stack, size_t stack_size,
+    unsigned int prio, int cpu) {
+    char *sp = stack;
+
+    if (pool == NULL || workers == NULL || stack == NULL)
+        return -EINVAL;
+
+    if (nr_workers == 0 || nr_workers > TASK_POOL_MAX_WORKERS)
+        return -EINVAL;
+
+    if (stack_size < TX_MINIMUM_STACK)
+        return -EINVAL;
+
+    if (prio >= TX_MAX_PRIORITIES)
+        return -EINVAL;
+
+    if (name == NULL)
+        name = "task-pool";
+
+    pool->workers = workers;
+    pool->nr_workers = nr_workers;
+    pool->next = 0;
+    pool->idle_map = 0;
+
+    for (unsigned int i = 0; i < nr_workers; i++) {
+        struct task_pool_worker *worker = &workers[i];
+
+        RTE_INIT_LIST(&worker->deque);
+        worker->pool = pool;
+        worker->depth = 0;
+        worker->executed = 0;
+        worker->stolen = 0;
+        tx_semaphore_create(&worker->sem, (CHAR *)name, 0);
+    }
+
+    /* Each worker gets @stack_size bytes of @stack and the next core */
+    for (unsigned int i = 0; i < nr_workers; i++) {
+        struct task_pool_worker *worker = &workers[i];
+
+        int core = cpu;
+
+#ifdef TX_THREAD_SMP_MAX_CORES
+        if (cpu >= 0)
+            core = (int)((cpu + i) % TX_THREAD_SMP_MAX_CORES);
+#endif
+        tx_thread_spawn(&worker->pid, name, task_pool_thread, worker, sp,
+            stack_size, prio, prio, TX_NO_TIME_SLICE, TX_DONT_START);
+        task_thread_bind_cpu(&worker->pid, core);
+        tx_thread_resume(&worker->pid);
+        sp += stack_size;
+    }
+
+    return 0;
+}
+
+int task_pool_destroy(struct task_pool *pool) {
+    if (pool == NULL)
+        return -EINVAL;
+
+    for (unsigned int i = 0; i < pool->nr_workers; i++) {
+        struct task_pool_worker *worker = &pool->workers[i];
+
+        tx_thread_terminate(&worker->pid);
+        tx_thread_delete(&worker->pid);
+        tx_semaphore_delete(&worker->sem);
+    }
+
+    pool->nr_workers = 0;
+    return 0;
+}
@@ -7,81 +7,656 @@
 
 #include "basework/assert.h"
 
+#ifndef TX_TASK_RUNNER_TIMESTAMP
+#define TX_TASK_RUNNER_TIMESTAMP() (uint32_t)tx_time_get()
+#endif
+#ifndef TX_TASK_RUNNER_TIMESTAMP_US
+#define TX_TASK_RUNNER_TIMESTAMP_US(n) \
+    (uint32_t)((uint64_t)(n) * 1000000 / TX_TIMER_TICKS_PER_SECOND)
+#endif
+
+#define TASK_WHEEL_MASK   (TASK_WHEEL_SLOTS - 1)
+#define TASK_WHEEL_RANGE  (1u << (TASK_WHEEL_LEVELS * TASK_WHEEL_BITS))
+
+/* struct task::state */
+#define TASK_STATE_IDLE      0
+#define TASK_STATE_INBOX     1  /* In the submission queue */
+#define TASK_STATE_QUEUED    2  /* In a pending list */
+#define TASK_STATE_CANCELED  3  /* Cancelled while in the submission queue */
+
+_Static_assert(TASK_PRIO_LEVELS >= 1 && TASK_PRIO_LEVELS <= 32, "");
+_Static_assert(TASK_WHEEL_LEVELS * TASK_WHEEL_BITS < 32, "");
+
 struct cancel_task {
     struct task task;
     TX_SEMAPHORE ack;
 };
 
-static void post_timeout_cb(ULONG id) {
-    struct delayed_task *task = (struct delayed_task *)id;
-    __task_post(task->base.runner, &task->base);
-}
-
 static void sync_helper_task(struct task *task) {
     struct cancel_task *ct = (struct cancel_task *)task;
     tx_semaphore_ceiling_put(&ct->ack, 1);
 }
 
-static void task_runner_thread(void *arg) {
-    struct task_runner *runner = arg;
-    struct task *curr, *next;
-    void (*fn)(struct task *);
-    TX_INTERRUPT_SAVE_AREA
+/* Must be called with interrupt disabled */
+static void task_dequeue(struct task_runner *runner, struct task *task) {
+    unsigned int prio = task->prio;
+
+    rte_list_del(&task->node);
+    task->node.next = NULL;
+    if (rte_list_empty(&runner->pending[prio]))
+        runner->ready_map &= ~(1u << prio);
+    runner->stat[prio].depth--;
+#ifdef CONFIG_TASK_RUNNER_TRACE
+    runner->depth--;
+#endif
+    __atomic_store_n(&task->state, TASK_STATE_IDLE, __ATOMIC_RELEASE);
+}
+
+/* 
+ * Must be called with interrupt disabled. A task that is still in the
+ * submission queue can not be unlinked, it is marked and dropped by the
+ * runner later.
+ */
+static bool task_unqueue(struct task *task) {
+    uint8_t state = TASK_STATE_INBOX;
+
+    if (task->state == TASK_STATE_QUEUED) {
+        task_dequeue(task->runner, task);
+        return true;
+    }
+
+    return __atomic_compare_exchange_n(&task->state, &state, TASK_STATE_CANCELED, 
+        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
 
-    TX_DISABLE
+/*
+ * Submission queue (Vyukov intrusive MPSC queue)
+ *
+ * A producer swaps itself into the tail with one atomic exchange and then
+ * links the previous tail to it, so posting is wait-free and never turns
+ * interrupts off. Between the two steps the queue looks shorter to the
+ * runner, the producer wakes the runner once the link is in place.
+ */
+static inline void task_inbox_push(struct task_runner *runner, 
+    struct task_link *link) {
+    struct task_link *prev;
+
+    __atomic_store_n(&link->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&runner->inbox_tail, link, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, link, __ATOMIC_RELEASE);
+}
+
+/* Runner thread only */
+static struct task *task_inbox_pop(struct task_runner *runner) {
+    struct task_link *head = runner->inbox_head;
+    struct task_link *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+
+    if (head == &runner->inbox_stub) {
+        if (next == NULL)
+            return NULL;
+        runner->inbox_head = next;
+        head = next;
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next == NULL) {
+        /* A producer is half way through */
+        if (head != __atomic_load_n(&runner->inbox_tail, __ATOMIC_ACQUIRE))
+            return NULL;
+
+        task_inbox_push(runner, &runner->inbox_stub);
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+        if (next == NULL)
+            return NULL;
+    }
+
+    runner->inbox_head = next;
+    return rte_container_of(head, struct task, link);
+}
+
+/* Runner thread only. True if task_inbox_pop() has nothing to return */
+static bool task_inbox_idle(struct task_runner *runner) {
+    struct task_link *head = runner->inbox_head;
+
+    if (__atomic_load_n(&head->next, __ATOMIC_ACQUIRE) != NULL)
+        return false;
+    if (head == &runner->inbox_stub)
+        return true;
+    return head != __atomic_load_n(&runner->inbox_tail, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Safe from any context. Return 1 if the runner was asleep and has to be
+ * woken up by the caller
+ */
+static int task_submit(struct task_runner *runner, struct task *task, 
+    unsigned int prio) {
+    uint8_t state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+    TX_INTERRUPT_SAVE_AREA
 
     for ( ; ; ) {
-        
-        if (rte_list_empty(&runner->pending)) {
+        if (state == TASK_STATE_CANCELED) {
+            bool taken;
+
             /* 
-             * If pending queue is empty then restore interrupt
-             * and suspend task runner
+             * Still in the submission queue, take it back. The runner reads
+             * the level with interrupt disabled once the task is drained.
              */
+            if (task->runner != runner)
+                return -EBUSY;
+            TX_DISABLE
+            taken = __atomic_compare_exchange_n(&task->state, &state, TASK_STATE_INBOX, 
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            if (taken)
+                task->prio = (uint8_t)prio;
             TX_RESTORE
-            tx_semaphore_get(&runner->sem, TX_WAIT_FOREVER);
+            if (taken)
+                goto _wakeup;
+            continue;
+        }
 
-            TX_DISABLE
+        if (state != TASK_STATE_IDLE)
+            return -EBUSY;
+        if (__atomic_compare_exchange_n(&task->state, &state, TASK_STATE_INBOX, 
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+    }
+
+    task->runner = runner;
+    task->prio = (uint8_t)prio;
+    task->timestamp = TX_TASK_RUNNER_TIMESTAMP();
+    task_inbox_push(runner, &task->link);
+
+_wakeup:
+    return __atomic_exchange_n(&runner->sleeping, 0, __ATOMIC_SEQ_CST) != 0;
+}
+
+/* Move submitted tasks to the pending lists */
+static void task_runner_drain(struct task_runner *runner) {
+    struct task_queue_stat *stat;
+    struct task *task;
+    uint8_t state;
+    TX_INTERRUPT_SAVE_AREA
+
+    while ((task = task_inbox_pop(runner)) != NULL) {
+        TX_DISABLE
+        state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+        for ( ; ; ) {
+            if (state == TASK_STATE_CANCELED) {
+                if (__atomic_compare_exchange_n(&task->state, &state, TASK_STATE_IDLE, 
+                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                    break;
+                continue;
+            }
+
+            rte_assert(state == TASK_STATE_INBOX);
+            if (__atomic_compare_exchange_n(&task->state, &state, TASK_STATE_QUEUED, 
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                rte_list_add_tail(&task->node, &runner->pending[task->prio]);
+                runner->ready_map |= 1u << task->prio;
+
+                stat = &runner->stat[task->prio];
+                stat->posted++;
+                if (++stat->depth > stat->max_depth)
+                    stat->max_depth = stat->depth;
+#ifdef CONFIG_TASK_RUNNER_TRACE
+                if (++runner->depth > runner->max_depth)
+                    runner->max_depth = runner->depth;
+#endif
+                break;
+            }
         }
+        TX_RESTORE
+    }
+}
 
-        /*
-         * Walk around pending list and execute task callback
+/*
+ * Must be called with interrupt disabled
+ *
+ * Tasks that expire within TASK_WHEEL_SLOTS ticks go to level 0, each
+ * following level covers TASK_WHEEL_BITS more bits of the expiry time.
+ * Anything beyond the wheel range is parked in the last slot reachable
+ * and re-inserted when it comes due.
+ */
+static void task_wheel_add(struct task_wheel *wheel, struct delayed_task *task) {
+    uint32_t expires = task->expires;
+    uint32_t delta = expires - wheel->now;
+    unsigned int level = 0;
+
+    if ((int32_t)delta < 0) {
+        rte_list_add_tail(&task->tnode, &wheel->slots[0][wheel->now & TASK_WHEEL_MASK]);
+        return;
+    }
+
+    if (delta >= TASK_WHEEL_RANGE) {
+        delta = TASK_WHEEL_RANGE - 1;
+        expires = wheel->now + delta;
+    }
+    while (delta >= (1u << ((level + 1) * TASK_WHEEL_BITS)))
+        level++;
+
+    rte_list_add_tail(&task->tnode, 
+        &wheel->slots[level][(expires >> (level * TASK_WHEEL_BITS)) & TASK_WHEEL_MASK]);
+}
+
+/* Must be called with interrupt disabled */
+static void task_wheel_del(struct task_wheel *wheel, struct delayed_task *task) {
+    rte_list_del(&task->tnode);
+    task->tnode.next = NULL;
+    wheel->count--;
+}
+
+/* Move all tasks of @slot to a private list head */
+static bool task_wheel_detach(struct rte_list *slot, struct rte_list *head) {
+    if (rte_list_empty(slot))
+        return false;
+
+    *head = *slot;
+    head->next->prev = head;
+    head->prev->next = head;
+    RTE_INIT_LIST(slot);
+    return true;
+}
+
+/* Must be called with interrupt disabled */
+static unsigned int task_wheel_cascade(struct task_wheel *wheel, unsigned int level) {
+    unsigned int idx = (wheel->now >> (level * TASK_WHEEL_BITS)) & TASK_WHEEL_MASK;
+    struct delayed_task *task;
+    struct rte_list head;
+
+    if (task_wheel_detach(&wheel->slots[level][idx], &head)) {
+        while (!rte_list_empty(&head)) {
+            task = rte_list_first_entry(&head, struct delayed_task, tnode);
+            rte_list_del(&task->tnode);
+            task_wheel_add(wheel, task);
+        }
+    }
+
+    return idx;
+}
+
+/* 
+ * Must be called with interrupt disabled. Process one tick and post
+ * every task that expires on it, return true if the runner needs to
+ * be woken up
+ */
+static bool task_wheel_advance(struct task_runner *runner) {
+    struct task_wheel *wheel = &runner->wheel;
+    unsigned int idx = wheel->now & TASK_WHEEL_MASK;
+    struct delayed_task *task;
+    struct rte_list head;
+    uint32_t tick;
+    bool wake = false;
+
+    if (idx == 0) {
+        for (unsigned int level = 1; level < TASK_WHEEL_LEVELS; level++) {
+            if (task_wheel_cascade(wheel, level) != 0)
+                break;
+        }
+    }
+
+    tick = wheel->now++;
+    if (!task_wheel_detach(&wheel->slots[0][idx], &head))
+        return false;
+
+    while (!rte_list_empty(&head)) {
+        task = rte_list_first_entry(&head, struct delayed_task, tnode);
+        rte_list_del(&task->tnode);
+
+        /* Parked beyond the wheel range */
+        if ((int32_t)(task->expires - tick) > 0) {
+            task_wheel_add(wheel, task);
+            continue;
+        }
+
+        /* 
+         * Periodic tasks are re-armed from the previous expiry so they do
+         * not drift. If the last run is still pending the expirations are
+         * coalesced into it.
          */
-        rte_list_foreach_entry_safe(curr, next, &runner->pending, node) {
-            rte_list_del(&curr->node);
-            runner->curr = curr;
-            fn = curr->handler;
-            TX_RESTORE
+        if (task->period) {
+            task->expires += task->period;
+            task_wheel_add(wheel, task);
+        } else {
+            task->tnode.next = NULL;
+            wheel->count--;
+        }
 
-            fn(curr);
+        if (task_submit(runner, &task->base, task->prio) > 0)
+            wake = true;
+    }
 
-            TX_DISABLE
-            runner->curr = NULL;
+    return wake;
+}
+
+/* 
+ * Must be called with interrupt disabled. Return the first tick from
+ * wheel->now on that processes a non-empty slot, either the expiry of a
+ * level 0 slot or the cascade of a higher level one. Nothing happens on
+ * the ticks before it, so the wheel can skip them.
+ */
+static uint32_t task_wheel_next(struct task_wheel *wheel) {
+    uint32_t now = wheel->now;
+    uint32_t next = now + TASK_WHEEL_RANGE;
+
+    for (unsigned int level = 0; level < TASK_WHEEL_LEVELS; level++) {
+        unsigned int shift = level * TASK_WHEEL_BITS;
+        uint32_t span = 1u << (shift + TASK_WHEEL_BITS);
+
+        for (unsigned int idx = 0; idx < TASK_WHEEL_SLOTS; idx++) {
+            uint32_t tick;
+
+            if (rte_list_empty(&wheel->slots[level][idx]))
+                continue;
+
+            if (level == 0) {
+                tick = now + ((idx - now) & TASK_WHEEL_MASK);
+            } else {
+                tick = (now & ~(span - 1)) | ((uint32_t)idx << shift);
+                if ((int32_t)(tick - now) < 0)
+                    tick += span;
+            }
+            if ((int32_t)(tick - next) < 0)
+                next = tick;
         }
     }
 
-    TX_RESTORE
+    return next;
 }
 
-int __task_post(struct task_runner *runner, struct task *task) {
+/* Must be called with interrupt disabled */
+static void task_wheel_arm(struct task_wheel *wheel, uint32_t expires, uint32_t now) {
+    if ((int32_t)(expires - now) <= 0)
+        expires = now + 1;
+
+    tx_timer_deactivate(&wheel->timer);
+    tx_timer_change(&wheel->timer, expires - now, 0);
+    tx_timer_activate(&wheel->timer);
+    wheel->expires = expires;
+    wheel->running = true;
+}
+
+static void task_wheel_timeout(ULONG arg) {
+    struct task_runner *runner = (struct task_runner *)arg;
+    struct task_wheel *wheel = &runner->wheel;
+    uint32_t now = (uint32_t)tx_time_get();
+    bool wake = false;
+
     scoped_guard(os_irq) {
-        if (task->node.next != NULL)
-            return -EBUSY;
-        
-        task->runner = runner;
-        rte_list_add_tail(&task->node, &runner->pending);
-        if (runner->curr)
-            return 0;
+        wheel->running = false;
+        while (wheel->count > 0) {
+            uint32_t next = task_wheel_next(wheel);
+
+            if ((int32_t)(next - now) > 0) {
+                task_wheel_arm(wheel, next, now);
+                break;
+            }
+            wheel->now = next;
+            if (task_wheel_advance(runner))
+                wake = true;
+        }
+    }
+
+    /* All tasks expired on the same tick share one wakeup */
+    if (wake)
+        tx_semaphore_ceiling_put(&runner->sem, 1);
+}
+
+#ifdef CONFIG_TASK_RUNNER_TRACE
+#define TASK_TRACE_PROBES   8
+#define TASK_WATCHDOG_TICKS \
+    (TX_TIMER_TICKS_PER_SECOND / 100? TX_TIMER_TICKS_PER_SECOND / 100: 1)
+
+_Static_assert((CONFIG_TASK_RUNNER_TRACE_SITES & (CONFIG_TASK_RUNNER_TRACE_SITES - 1)) == 0,
+    "CONFIG_TASK_RUNNER_TRACE_SITES must be power of 2");
+
+static struct task_handler_stat task_handler_stats[CONFIG_TASK_RUNNER_TRACE_SITES];
+static struct rte_list task_runner_list;
+static TX_TIMER task_watchdog_timer;
+
+static inline unsigned int task_trace_bucket(uint32_t us) {
+    unsigned int idx = us? 32 - (unsigned int)__builtin_clz(us): 0;
+    return idx < TASK_TRACE_BUCKETS? idx: TASK_TRACE_BUCKETS - 1;
+}
+
+/* Slot 0 collects the handlers that can not be placed */
+static struct task_handler_stat *task_trace_lookup(struct task_runner *runner,
+    void (*handler)(struct task *)) {
+    uintptr_t key = (uintptr_t)handler ^ (uintptr_t)runner;
+    unsigned int idx = (unsigned int)(((key >> 1) * 2654435761u) >> 8) &
+        (CONFIG_TASK_RUNNER_TRACE_SITES - 1);
+
+    for (int i = 0; i < TASK_TRACE_PROBES; i++) {
+        struct task_handler_stat *site;
+
+        if (idx == 0)
+            idx = 1;
+        site = &task_handler_stats[idx];
+        if (site->handler == handler && site->runner == runner)
+            return site;
+        if (site->handler == NULL) {
+            site->handler = handler;
+            site->runner = runner;
+            return site;
+        }
+        idx = (idx + 1) & (CONFIG_TASK_RUNNER_TRACE_SITES - 1);
+    }
+
+    return &task_handler_stats[0];
+}
+
+static void task_trace_record(struct task_runner *runner, 
+    void (*handler)(struct task *), uint32_t wait, uint32_t start) {
+    uint32_t run_us = TX_TASK_RUNNER_TIMESTAMP_US(TX_TASK_RUNNER_TIMESTAMP() - start);
+    uint32_t wait_us = TX_TASK_RUNNER_TIMESTAMP_US(wait);
+    struct task_handler_stat *site;
+
+    scoped_guard(os_irq) {
+        site = task_trace_lookup(runner, handler);
+        site->count++;
+        site->run_total += run_us;
+        site->wait_total += wait_us;
+        if (run_us > site->run_max)
+            site->run_max = run_us;
+        if (wait_us > site->wait_max)
+            site->wait_max = wait_us;
+        if (runner->budget && run_us > runner->budget)
+            site->overruns++;
+        site->run_hist[task_trace_bucket(run_us)]++;
+        site->wait_hist[task_trace_bucket(wait_us)]++;
+    }
+}
+
+/*
+ * Report every handler that has been running for longer than the budget
+ * of its runner, once per run
+ */
+static void task_watchdog_timeout(ULONG arg) {
+    struct task_runner *runner;
+    struct task *curr;
+    uint32_t elapsed;
+
+    (void) arg;
+    rte_list_foreach_entry(runner, &task_runner_list, trace_node) {
+        curr = runner->curr;
+        if (curr == NULL || curr == runner->stalled || runner->budget == 0)
+            continue;
+
+        elapsed = TX_TASK_RUNNER_TIMESTAMP_US(TX_TASK_RUNNER_TIMESTAMP() - 
+            runner->curr_start);
+        if (elapsed > runner->budget) {
+            runner->stalled = curr;
+            printk("taskrunner(%s): handler %p stalled for %u us (budget %u us)\n",
+                runner->pid.tx_thread_name, curr->handler, (unsigned int)elapsed, 
+                (unsigned int)runner->budget);
+        }
     }
-    return tx_semaphore_ceiling_put(&runner->sem, 1);
 }
 
+static void task_trace_register(struct task_runner *runner) {
+    RTE_INIT_LIST(&runner->trace_node);
+    runner->stalled = NULL;
+    runner->curr_start = 0;
+    runner->budget = CONFIG_TASK_RUNNER_WATCHDOG_BUDGET;
+    runner->depth = 0;
+    runner->max_depth = 0;
+
+    scoped_guard(os_irq) {
+        if (task_runner_list.next == NULL) {
+            RTE_INIT_LIST(&task_runner_list);
+            tx_timer_create(&task_watchdog_timer, "taskrunner_watchdog", 
+                task_watchdog_timeout, 0, TASK_WATCHDOG_TICKS, TASK_WATCHDOG_TICKS, 
+                TX_AUTO_ACTIVATE);
+        }
+        rte_list_add_tail(&runner->trace_node, &task_runner_list);
+    }
+}
+
+void task_runner_foreach(bool (*iterator)(struct task_runner *, void *), void *arg) {
+    struct task_runner *runner;
+
+    if (task_runner_list.next == NULL)
+        return;
+
+    rte_list_foreach_entry(runner, &task_runner_list, trace_node) {
+        if (iterator(runner, arg))
+            break;
+    }
+}
+
+int task_runner_set_budget(struct task_runner *runner, uint32_t budget_us) {
+    if (runner == NULL)
+        return -EINVAL;
+
+    runner->budget = budget_us;
+    return 0;
+}
+
+int task_runner_get_handlers(struct task_handler_stat *stats, int max) {
+    int n = 0;
+
+    if (stats == NULL || max <= 0)
+        return -EINVAL;
+
+    for (int i = 0; i < CONFIG_TASK_RUNNER_TRACE_SITES && n < max; i++) {
+        scoped_guard(os_irq) {
+            if (task_handler_stats[i].count)
+                stats[n++] = task_handler_stats[i];
+        }
+    }
+
+    return n;
+}
+
+void task_runner_reset_trace(void) {
+    struct task_runner *runner;
+
+    scoped_guard(os_irq) {
+        memset(task_handler_stats, 0, sizeof(task_handler_stats));
+        if (task_runner_list.next != NULL) {
+            rte_list_foreach_entry(runner, &task_runner_list, trace_node)
+                runner->max_depth = runner->depth;
+        }
+    }
+}
+#endif /* CONFIG_TASK_RUNNER_TRACE */
+
+static void task_runner_thread(void *arg) {
+    struct task_runner *runner = arg;
+    struct task_queue_stat *stat;
+    struct task *curr;
+    void (*fn)(struct task *);
+    unsigned int prio;
+    uint32_t wait;
+    TX_INTERRUPT_SAVE_AREA
+
+    for ( ; ; ) {
+        task_runner_drain(runner);
+
+        TX_DISABLE
+        if (runner->ready_map == 0) {
+            /* 
+             * Announce that we are going to sleep before the last look at
+             * the submission queue, a producer that finishes its post after
+             * this point sees the flag and wakes us up.
+             */
+            TX_RESTORE
+            __atomic_store_n(&runner->sleeping, 1, __ATOMIC_SEQ_CST);
+            if (task_inbox_idle(runner))
+                tx_semaphore_get(&runner->sem, TX_WAIT_FOREVER);
+            __atomic_store_n(&runner->sleeping, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        /*
+         * Pick the first task of the highest non-empty queue
+         */
+        prio = (unsigned int)__builtin_ctz(runner->ready_map);
+        curr = rte_list_first_entry(&runner->pending[prio], struct task, node);
+        task_dequeue(runner, curr);
+
+        stat = &runner->stat[prio];
+        wait = TX_TASK_RUNNER_TIMESTAMP() - curr->timestamp;
+        stat->executed++;
+        stat->wait_total += wait;
+        if (wait > stat->wait_max)
+            stat->wait_max = wait;
+
+#ifdef CONFIG_TASK_RUNNER_TRACE
+        runner->curr_start = TX_TASK_RUNNER_TIMESTAMP();
+        runner->stalled = NULL;
+#endif
+        runner->curr = curr;
+        fn = curr->handler;
+        TX_RESTORE
+
+        fn(curr);
+        runner->curr = NULL;
+#ifdef CONFIG_TASK_RUNNER_TRACE
+        task_trace_record(runner, fn, wait, runner->curr_start);
+#endif
+    }
+}
+
+int __task_post_prio(struct task_runner *runner, struct task *task, 
+    unsigned int prio) {
+    int err;
+
+    if (prio >= TASK_PRIO_LEVELS)
+        prio = TASK_PRIO_LOWEST;
+
+    err = task_submit(runner, task, prio);
+    if (err <= 0)
+        return err;
+
+    /* The task is queued, a wakeup that is already pending is enough */
+    tx_semaphore_ceiling_put(&runner->sem, 1);
+    return 0;
+}
+
+int __task_post(struct task_runner *runner, struct task *task) {
+    return __task_post_prio(runner, task, TASK_PRIO_NORMAL);
+}
+
+/*
+ * A task cancelled in the submission queue stays there until the runner
+ * drops it. The submission queue is FIFO, so with @wait the helper task
+ * is acknowledged only after the cancelled task has been drained.
+ */
 int __task_cancel(struct task *task, bool wait) {
+    struct task_runner *runner;
+
     scoped_guard(os_irq) {
-        if (task->node.next != NULL) {
-            rte_list_del(&task->node);
+        runner = task->runner;
+        if (runner == NULL)
+            return 0;
+        if (task->state == TASK_STATE_QUEUED) {
+            task_dequeue(runner, task);
             return 0;
         }
-        if (task->runner->curr != task)
+        if (!task_unqueue(task) && 
+            task->state != TASK_STATE_CANCELED && 
+            runner->curr != task)
             return 0;
     }
     if (wait) {
@@ -89,31 +664,70 @@ int __task_cancel(struct task *task, bool wait) {
 
         init_task(&ct.task, sync_helper_task);
         tx_semaphore_create(&ct.ack, "task_cancel", 0);
-        __task_post(task->runner, &ct.task);
+        __task_post(runner, &ct.task);
         tx_semaphore_get(&ct.ack, TX_WAIT_FOREVER);
         tx_semaphore_delete(&ct.ack);
     }
     return 0;
 }
 
+/*
+ * The task is queued at @prio when it expires. task->base.prio stays the
+ * level of the pending list the task may still be on until it is unqueued.
+ */
 int __delayed_task_post(struct task_runner *runner, struct delayed_task *task, 
-    unsigned long ticks) {
-    if (ticks == TX_NO_WAIT)
-        return __task_post(runner, &task->base);
+    unsigned long ticks, unsigned int prio) {
+    struct task_wheel *wheel = &runner->wheel;
+    uint32_t now;
+
+    if (ticks == TX_NO_WAIT && task->period == 0) {
+        scoped_guard(os_irq) {
+            if (task->tnode.next != NULL)
+                task_wheel_del(&task->base.runner->wheel, task);
+        }
+        return __task_post_prio(runner, &task->base, prio);
+    }
 
     scoped_guard(os_irq) {
-        tx_timer_deactivate(&task->timer);
-        if (task->base.node.next != NULL)
-            rte_list_del(&task->base.node);
+        /* 
+         * A task in the submission queue of another runner can only move
+         * once that runner has drained it
+         */
+        if (task->base.runner != NULL && task->base.runner != runner) {
+            uint8_t state = __atomic_load_n(&task->base.state, __ATOMIC_ACQUIRE);
+            if (state == TASK_STATE_INBOX || state == TASK_STATE_CANCELED)
+                return -EBUSY;
+        }
+        if (task->tnode.next != NULL)
+            task_wheel_del(&task->base.runner->wheel, task);
+        if (task->base.runner != NULL)
+            task_unqueue(&task->base);
         task->base.runner = runner;
-        task->timer.tx_timer_internal.tx_timer_internal_remaining_ticks = ticks;
+        task->prio = (uint8_t)prio;
+
+        /* The wheel clock stands still while no task is armed */
+        now = (uint32_t)tx_time_get();
+        if (wheel->count == 0)
+            wheel->now = now;
+
+        task->expires = now + (uint32_t)ticks;
+        task_wheel_add(wheel, task);
+        wheel->count++;
+
+        /* The timer fires for the earliest task and re-arms itself from there */
+        if (!wheel->running || (int32_t)(task->expires - wheel->expires) < 0)
+            task_wheel_arm(wheel, task->expires, now);
     }
 
-    return (int)tx_timer_activate(&task->timer);
+    return 0;
 }
 
 int __delayed_task_cancel(struct delayed_task *task, bool wait) {
-    tx_timer_deactivate(&task->timer);
+    scoped_guard(os_irq) {
+        task->period = 0;
+        if (task->tnode.next != NULL)
+            task_wheel_del(&task->base.runner->wheel, task);
+    }
     return __task_cancel(&task->base, wait);
 }
 
@@ -125,13 +739,48 @@ int task_post(struct task_runner *runner, struct task *task) {
     return __task_post(runner, task);
 }
 
+int task_post_prio(struct task_runner *runner, struct task *task, 
+    unsigned int prio) {
+    rte_assert(runner != NULL);
+    if (task == NULL || prio >= TASK_PRIO_LEVELS)
+        return -EINVAL;
+    
+    return __task_post_prio(runner, task, prio);
+}
+
 int delayed_task_post(struct task_runner *runner, struct delayed_task *task, 
     unsigned long ticks) {
     rte_assert(runner != NULL);
     if (task == NULL)
         return -EINVAL;
 
-    return __delayed_task_post(runner, task, ticks);
+    task->period = 0;
+    return __delayed_task_post(runner, task, ticks, task->prio);
+}
+
+int delayed_task_post_prio(struct task_runner *runner, struct delayed_task *task, 
+    unsigned long ticks, unsigned int prio) {
+    rte_assert(runner != NULL);
+    if (task == NULL || prio >= TASK_PRIO_LEVELS)
+        return -EINVAL;
+
+    task->period = 0;
+    return __delayed_task_post(runner, task, ticks, prio);
+}
+
+/*
+ * Run @task every @period ticks, the first time after @ticks (or @period
+ * if @ticks is 0). The schedule is kept on the original time grid, late
+ * runs do not push back the following ones.
+ */
+int delayed_task_post_periodic(struct task_runner *runner, struct delayed_task *task, 
+    unsigned long ticks, unsigned long period) {
+    rte_assert(runner != NULL);
+    if (task == NULL || period == 0)
+        return -EINVAL;
+
+    task->period = (uint32_t)period;
+    return __delayed_task_post(runner, task, ticks? ticks: period, task->prio);
 }
 
 int task_cancel(struct task *task, bool wait) {
@@ -148,20 +797,45 @@ int delayed_task_cancel(struct delayed_task *task, bool wait) {
 
 void init_task(struct task *task, void (*handler)(struct task *)) {
     task->node = (struct rte_list){NULL, NULL};
+    task->link.next = NULL;
     task->handler = handler;
+    task->runner = NULL;
+    task->prio = TASK_PRIO_NORMAL;
+    task->state = TASK_STATE_IDLE;
 }
 
 void init_delayed_task(struct delayed_task *task, void (*handler)(struct task *)) {
     init_task(&task->base, handler);
-    tx_timer_create(&task->timer, "delayed_task",
-            post_timeout_cb, (ULONG)task,
-            0, 0, TX_FALSE);
+    task->tnode = (struct rte_list){NULL, NULL};
+    task->expires = 0;
+    task->period = 0;
+    task->prio = TASK_PRIO_NORMAL;
+}
+
+/*
+ * Restrict a thread to one core. Only the SMP kernel has more than one
+ * core, a negative @cpu leaves the thread free to run anywhere.
+ */
+int task_thread_bind_cpu(TX_THREAD *thread, int cpu) {
+#ifdef TX_THREAD_SMP_MAX_CORES
+    ULONG cores = (1ul << TX_THREAD_SMP_MAX_CORES) - 1;
+
+    if (cpu < 0)
+        return 0;
+    if (cpu >= TX_THREAD_SMP_MAX_CORES)
+        return -EINVAL;
+
+    return (int)tx_thread_smp_core_exclude(thread, cores & ~(1ul << cpu));
+#else
+    (void) thread;
+    (void) cpu;
+    return 0;
+#endif
 }
 
 int task_runner_construct(struct task_runner *runner, const char *name, void *stack, 
     size_t stack_size, unsigned int prio, int cpu) {
     
-    (void) cpu;
     if (runner == NULL)
         return -EINVAL;
 
@@ -177,14 +851,54 @@ int task_runner_construct(struct task_runner *runner, const char *name, void *st
     if (name == NULL)
         name = "task-runner";
 
-    RTE_INIT_LIST(&runner->pending);
+    for (int i = 0; i < TASK_PRIO_LEVELS; i++) {
+        RTE_INIT_LIST(&runner->pending[i]);
+        memset(&runner->stat[i], 0, sizeof(runner->stat[i]));
+    }
+    runner->ready_map = 0;
+    runner->curr = NULL;
+    runner->inbox_stub.next = NULL;
+    runner->inbox_head = &runner->inbox_stub;
+    runner->inbox_tail = &runner->inbox_stub;
+    runner->sleeping = 0;
+#ifdef CONFIG_TASK_RUNNER_TRACE
+    task_trace_register(runner);
+#endif
+
+    for (int i = 0; i < TASK_WHEEL_LEVELS; i++) {
+        for (unsigned int j = 0; j < TASK_WHEEL_SLOTS; j++)
+            RTE_INIT_LIST(&runner->wheel.slots[i][j]);
+    }
+    runner->wheel.now = 0;
+    runner->wheel.expires = 0;
+    runner->wheel.count = 0;
+    runner->wheel.running = false;
+    tx_timer_create(&runner->wheel.timer, (CHAR *)name, task_wheel_timeout,
+        (ULONG)runner, 1, 0, TX_NO_ACTIVATE);
+
     tx_semaphore_create(&runner->sem, (CHAR *)name, 0);
     tx_thread_spawn(&runner->pid, name, task_runner_thread, runner, stack, 
-        stack_size, prio, prio, TX_NO_TIME_SLICE, TX_AUTO_START);
+        stack_size, prio, prio, TX_NO_TIME_SLICE, TX_DONT_START);
+    task_thread_bind_cpu(&runner->pid, cpu);
+    tx_thread_resume(&runner->pid);
     
     return 0;
 }
 
+int task_runner_get_stat(struct task_runner *runner, unsigned int prio, 
+    struct task_queue_stat *stat) {
+    if (runner == NULL || stat == NULL)
+        return -EINVAL;
+
+    if (prio >= TASK_PRIO_LEVELS)
+        return -ENOENT;
+
+    scoped_guard(os_irq) {
+        *stat = runner->stat[prio];
+    }
+    return 0;
+}
+
 /*
  * Create task runner for system
  */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024 wtcat
+ *
+ * Tickless idle
+ *
+ * When the scheduler goes idle, tx_low_power_enter() reports the number of
+ * ticks until the next ThreadX timer expires. The periodic tick is stopped
+ * and a one-shot hrtimer is armed one tick boundary before that expiry.
+ * On the first interrupt after that (the hrtimer or any other source)
+ * tx_low_power_exit() gets the number of whole ticks that elapsed, the
+ * ThreadX clock is caught up with tx_time_increment() and the tick is
+ * restarted. The expiring timers are left with one remaining tick, the
+ * restarted tick fires them on time.
+ *
+ * The part of a tick that elapsed before the tick was stopped (the phase)
+ * and the part of a tick that was left over when it is restarted (the
+ * residual) are carried, so the ThreadX clock does not drift however
+ * often the system goes idle.
+ */
+#define TX_USE_BOARD_PRIVATE
+
+#include "tx_api.h"
+
+#ifndef CONFIG_TICKLESS_MAX_MS
+#define CONFIG_TICKLESS_MAX_MS 10000
+#endif
+
+#define TICKLESS_TICK_NS   (1000000000ull / TX_TIMER_TICKS_PER_SECOND)
+#define TICKLESS_MAX_TICKS \
+    ((ULONG)((uint64_t)CONFIG_TICKLESS_MAX_MS * TX_TIMER_TICKS_PER_SECOND / 1000))
+
+/* Not worth stopping the tick for less than this */
+#define TICKLESS_MIN_TICKS 2
+
+#define TICKLESS_NS_TO_CYCLES(ns) rte_div_roundup(HRTIMER_US((uint64_t)(ns)), 1000)
+#define TICKLESS_CYCLES_TO_NS(n)  HRTIMER_CYCLE_TO_US((uint64_t)(n) * 1000)
+
+/* Rounding of the timer cycle conversions */
+#define TICKLESS_SLACK_NS         (TICKLESS_CYCLES_TO_NS(2) + 1)
+
+/* The elapsed time is measured on 32 bits of the timer counter */
+#define TICKLESS_MAX_SLEEP_NS     TICKLESS_CYCLES_TO_NS(UINT32_MAX / 2)
+
+_Static_assert(TICKLESS_MAX_TICKS >= TICKLESS_MIN_TICKS,
+    "CONFIG_TICKLESS_MAX_MS is shorter than two ticks");
+
+struct tickless {
+    struct hrtimer timer;
+    struct tickless_stat stat;
+    uint32_t start;
+    uint32_t phase;
+    uint32_t residual;
+    bool enabled;
+    bool stopped;
+    volatile bool woken;
+};
+
+static struct tickless tickless;
+
+static void tickless_wakeup(struct hrtimer *timer) {
+    struct tickless *tl = rte_container_of(timer, struct tickless, timer);
+
+    tl->woken = true;
+}
+
+/* Called by tx_low_power_enter() with interrupts disabled */
+void tickless_enter(ULONG ticks) {
+    struct tickless *tl = &tickless;
+    uint64_t sleep_ns;
+
+    if (tl->stopped || !tl->enabled || ticks < TICKLESS_MIN_TICKS)
+        return;
+
+    if (ticks > TICKLESS_MAX_TICKS)
+        ticks = TICKLESS_MAX_TICKS;
+
+    tl->phase = TICKLESS_TICK_STOP();
+    tl->start = (uint32_t)HRTIMER_JIFFIES;
+
+    /* Wake up at the tick boundary just before the expiry */
+    sleep_ns = (uint64_t)(ticks - 1) * TICKLESS_TICK_NS;
+    if (sleep_ns > (uint64_t)tl->phase + tl->residual)
+        sleep_ns -= tl->phase + tl->residual;
+    else
+        sleep_ns = 1;
+    if (sleep_ns > TICKLESS_MAX_SLEEP_NS)
+        sleep_ns = TICKLESS_MAX_SLEEP_NS;
+
+    tl->woken = false;
+    tl->stopped = true;
+    tl->stat.entries++;
+    hrtimer_start(&tl->timer, TICKLESS_NS_TO_CYCLES(sleep_ns));
+}
+
+/* Called by tx_low_power_exit() with interrupts disabled */
+ULONG tickless_exit(void) {
+    struct tickless *tl = &tickless;
+    uint64_t elapsed;
+    ULONG ticks;
+
+    if (!tl->stopped)
+        return 0;
+
+    hrtimer_stop(&tl->timer);
+    elapsed = TICKLESS_CYCLES_TO_NS((uint32_t)HRTIMER_JIFFIES - tl->start) +
+        tl->phase + tl->residual;
+    ticks = (ULONG)(elapsed / TICKLESS_TICK_NS);
+    tl->residual = (uint32_t)(elapsed % TICKLESS_TICK_NS);
+
+    /* Woken up on the tick boundary */
+    if (tl->residual + TICKLESS_SLACK_NS >= TICKLESS_TICK_NS) {
+        tl->residual = 0;
+        ticks++;
+    }
+    TICKLESS_TICK_START();
+
+    tl->stopped = false;
+    tl->woken = false;
+    tl->stat.wakeups++;
+    tl->stat.skipped += ticks;
+    return ticks;
+}
+
+bool tickless_wakeup_pending(void) {
+    return tickless.woken;
+}
+
+void tickless_enable(bool enable) {
+    scoped_guard(os_irq) {
+        tickless.enabled = enable;
+    }
+}
+
+void tickless_get_stat(struct tickless_stat *stat) {
+    scoped_guard(os_irq) {
+        *stat = tickless.stat;
+        stat->enabled = tickless.enabled;
+    }
+}
+
+static int tickless_init(void) {
+    hrtimer_init(&tickless.timer);
+    tickless.timer.routine = tickless_wakeup;
+    tickless_enable(true);
+    return 0;
+}
+
+SYSINIT(tickless_init, SI_PREDRIVER_LEVEL, 20);
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2024 wtcat
+ *
+ * Two-Level Segregated Fit allocator
+ *
+ * Free blocks are kept in segregated lists indexed by a first level
+ * (power of two) and a second level (linear subdivision of the first
+ * level range). Two bitmaps record the non-empty lists, so both malloc
+ * and free are O(1). Adjacent free blocks are merged immediately.
+ *
+ * The allocator itself is not thread safe, callers must serialize.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include "tx_api.h"
+
+#include "basework/assert.h"
+
+#define TLSF_ALIGN            (1u << TLSF_ALIGN_SHIFT)
+#define TLSF_SMALL_BLOCK_SIZE ((size_t)1 << TLSF_FL_INDEX_SHIFT)
+
+#define BLOCK_FREE            ((size_t)1 << 0)
+#define BLOCK_PREV_FREE       ((size_t)1 << 1)
+#define BLOCK_FLAGS           (BLOCK_FREE | BLOCK_PREV_FREE)
+
+/*
+ * The prev_phys field is stored in the last word of the previous block and
+ * is only valid if the previous block is free. The user data starts right
+ * after the size field.
+ */
+#define BLOCK_OVERHEAD        sizeof(size_t)
+#define BLOCK_START_OFFSET    (offsetof(struct tlsf_block, size) + sizeof(size_t))
+#define BLOCK_SIZE_MIN        (sizeof(struct tlsf_block) - sizeof(struct tlsf_block *))
+#define BLOCK_SIZE_MAX        ((size_t)1 << TLSF_FL_INDEX_MAX)
+
+_Static_assert(TLSF_SL_INDEX_COUNT <= 32, "");
+_Static_assert(TLSF_FL_INDEX_COUNT <= 32, "");
+
+static inline int tlsf_ffs(uint32_t word) {
+    return __builtin_ctz(word);
+}
+
+static inline int tlsf_fls(size_t size) {
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)size);
+}
+
+static inline size_t block_size(const struct tlsf_block *b) {
+    return b->size & ~BLOCK_FLAGS;
+}
+
+static inline void block_set_size(struct tlsf_block *b, size_t size) {
+    b->size = size | (b->size & BLOCK_FLAGS);
+}
+
+static inline bool block_is_free(const struct tlsf_block *b) {
+    return !!(b->size & BLOCK_FREE);
+}
+
+static inline void *block_to_ptr(const struct tlsf_block *b) {
+    return (char *)b + BLOCK_START_OFFSET;
+}
+
+static inline struct tlsf_block *block_from_ptr(const void *ptr) {
+    return (struct tlsf_block *)((char *)ptr - BLOCK_START_OFFSET);
+}
+
+static inline struct tlsf_block *block_next(const struct tlsf_block *b) {
+    return (struct tlsf_block *)((char *)block_to_ptr(b) + block_size(b) -
+        BLOCK_OVERHEAD);
+}
+
+static inline struct tlsf_block *block_link_next(struct tlsf_block *b) {
+    struct tlsf_block *next = block_next(b);
+
+    next->prev_phys = b;
+    return next;
+}
+
+static inline void block_mark_free(struct tlsf_block *b) {
+    struct tlsf_block *next = block_link_next(b);
+
+    next->size |= BLOCK_PREV_FREE;
+    b->size |= BLOCK_FREE;
+}
+
+static inline void block_mark_used(struct tlsf_block *b) {
+    struct tlsf_block *next = block_next(b);
+
+    next->size &= ~BLOCK_PREV_FREE;
+    b->size &= ~BLOCK_FREE;
+}
+
+static inline void mapping_insert(size_t size, int *fli, int *sli) {
+    int fl, sl;
+
+    if (size < TLSF_SMALL_BLOCK_SIZE) {
+        fl = 0;
+        sl = (int)(size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT));
+    } else {
+        fl = tlsf_fls(size);
+        sl = (int)(size >> (fl - TLSF_SL_INDEX_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+        fl -= TLSF_FL_INDEX_SHIFT - 1;
+    }
+    *fli = fl;
+    *sli = sl;
+}
+
+/* Round up to the next list so that any block found there is big enough */
+static inline void mapping_search(size_t size, int *fli, int *sli) {
+    if (size >= TLSF_SMALL_BLOCK_SIZE)
+        size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_INDEX_LOG2)) - 1;
+    mapping_insert(size, fli, sli);
+}
+
+static struct tlsf_block *
+search_suitable_block(struct tlsf *t, int *fli, int *sli) {
+    int fl = *fli, sl;
+    uint32_t sl_map = t->sl_bitmap[fl] & (~0u << *sli);
+
+    if (sl_map == 0) {
+        uint32_t fl_map = (fl + 1 < 32)? t->fl_bitmap & (~0u << (fl + 1)): 0;
+
+        if (fl_map == 0)
+            return NULL;
+        fl = tlsf_ffs(fl_map);
+        sl_map = t->sl_bitmap[fl];
+    }
+
+    sl = tlsf_ffs(sl_map);
+    *fli = fl;
+    *sli = sl;
+    return t->blocks[fl][sl];
+}
+
+static void remove_free_block(struct tlsf *t, struct tlsf_block *b,
+    int fl, int sl) {
+    struct tlsf_block *prev = b->prev_free;
+    struct tlsf_block *next = b->next_free;
+
+    next->prev_free = prev;
+    prev->next_free = next;
+    if (t->blocks[fl][sl] == b) {
+        t->blocks[fl][sl] = next;
+        if (next == &t->block_null) {
+            t->sl_bitmap[fl] &= ~(1u << sl);
+            if (t->sl_bitmap[fl] == 0)
+                t->fl_bitmap &= ~(1u << fl);
+        }
+    }
+    t->free_blocks--;
+}
+
+static void insert_free_block(struct tlsf *t, struct tlsf_block *b,
+    int fl, int sl) {
+    struct tlsf_block *curr = t->blocks[fl][sl];
+
+    b->next_free = curr;
+    b->prev_free = &t->block_null;
+    curr->prev_free = b;
+    t->blocks[fl][sl] = b;
+    t->fl_bitmap |= 1u << fl;
+    t->sl_bitmap[fl] |= 1u << sl;
+    t->free_blocks++;
+}
+
+static inline void block_remove(struct tlsf *t, struct tlsf_block *b) {
+    int fl, sl;
+
+    mapping_insert(block_size(b), &fl, &sl);
+    remove_free_block(t, b, fl, sl);
+}
+
+static inline void block_insert(struct tlsf *t, struct tlsf_block *b) {
+    int fl, sl;
+
+    mapping_insert(block_size(b), &fl, &sl);
+    insert_free_block(t, b, fl, sl);
+}
+
+static inline bool block_can_split(struct tlsf_block *b, size_t size) {
+    return block_size(b) >= sizeof(struct tlsf_block) + size;
+}
+
+static struct tlsf_block *block_split(struct tlsf_block *b, size_t size) {
+    struct tlsf_block *remain = (struct tlsf_block *)
+        ((char *)block_to_ptr(b) + size - BLOCK_OVERHEAD);
+    size_t remain_size = block_size(b) - (size + BLOCK_OVERHEAD);
+
+    remain->size = remain_size;
+    block_set_size(b, size);
+    block_mark_free(remain);
+    return remain;
+}
+
+static struct tlsf_block *block_absorb(struct tlsf_block *prev,
+    struct tlsf_block *b) {
+    prev->size += block_size(b) + BLOCK_OVERHEAD;
+    block_link_next(prev);
+    return prev;
+}
+
+static struct tlsf_block *block_merge_prev(struct tlsf *t, struct tlsf_block *b) {
+    if (b->size & BLOCK_PREV_FREE) {
+        struct tlsf_block *prev = b->prev_phys;
+
+        rte_assert(block_is_free(prev));
+        block_remove(t, prev);
+        b = block_absorb(prev, b);
+    }
+    return b;
+}
+
+static struct tlsf_block *block_merge_next(struct tlsf *t, struct tlsf_block *b) {
+    struct tlsf_block *next = block_next(b);
+
+    if (block_is_free(next)) {
+        block_remove(t, next);
+        b = block_absorb(b, next);
+    }
+    return b;
+}
+
+static void block_trim_free(struct tlsf *t, struct tlsf_block *b, size_t size) {
+    if (block_can_split(b, size)) {
+        struct tlsf_block *remain = block_split(b, size);
+
+        block_link_next(b);
+        remain->size |= BLOCK_PREV_FREE;
+        block_insert(t, remain);
+    }
+}
+
+static inline size_t adjust_request_size(size_t size) {
+    size_t aligned;
+
+    if (size == 0 || size >= BLOCK_SIZE_MAX)
+        return 0;
+
+    aligned = rte_roundup(size, TLSF_ALIGN);
+    return aligned < BLOCK_SIZE_MIN? BLOCK_SIZE_MIN: aligned;
+}
+
+void *tlsf_malloc(struct tlsf *t, size_t size) {
+    struct tlsf_block *b;
+    int fl, sl;
+
+    size = adjust_request_size(size);
+    if (rte_unlikely(size == 0))
+        return NULL;
+
+    mapping_search(size, &fl, &sl);
+    if (rte_unlikely(fl >= TLSF_FL_INDEX_COUNT))
+        return NULL;
+
+    b = search_suitable_block(t, &fl, &sl);
+    if (rte_unlikely(b == NULL))
+        return NULL;
+
+    remove_free_block(t, b, fl, sl);
+    block_trim_free(t, b, size);
+    block_mark_used(b);
+    t->used_size += block_size(b);
+    return block_to_ptr(b);
+}
+
+void tlsf_free(struct tlsf *t, void *ptr) {
+    struct tlsf_block *b;
+
+    if (ptr == NULL)
+        return;
+
+    b = block_from_ptr(ptr);
+    rte_assert(!block_is_free(b));
+    t->used_size -= block_size(b);
+    block_mark_free(b);
+    b = block_merge_prev(t, b);
+    b = block_merge_next(t, b);
+    block_insert(t, b);
+}
+
+size_t tlsf_block_size(const void *ptr) {
+    return ptr? block_size(block_from_ptr(ptr)): 0;
+}
+
+void tlsf_get_stat(struct tlsf *t, struct heap_stat *stat) {
+    size_t largest = 0;
+    int fl, sl;
+
+    /* Only the highest non-empty list can hold the largest block */
+    if (t->fl_bitmap) {
+        fl = tlsf_fls(t->fl_bitmap);
+        sl = tlsf_fls(t->sl_bitmap[fl]);
+        for (struct tlsf_block *b = t->blocks[fl][sl];
+            b != &t->block_null; b = b->next_free) {
+            if (block_size(b) > largest)
+                largest = block_size(b);
+        }
+    }
+
+    stat->total_size   = t->total_size;
+    stat->used_size    = t->used_size;
+    stat->free_size    = t->total_size - t->used_size;
+    stat->largest_free = largest;
+    stat->free_blocks  = t->free_blocks;
+    stat->frag_percent = stat->free_size?
+        (unsigned int)(100 - (uint64_t)largest * 100 / stat->free_size): 0;
+}
+
+int tlsf_init(struct tlsf *t, void *mem, size_t bytes) {
+    struct tlsf_block *b, *next;
+    uintptr_t start = rte_roundup((uintptr_t)mem, TLSF_ALIGN);
+    size_t size;
+
+    if (t == NULL || mem == NULL)
+        return -EINVAL;
+
+    t->block_null.next_free = &t->block_null;
+    t->block_null.prev_free = &t->block_null;
+    t->fl_bitmap = 0;
+    for (int i = 0; i < TLSF_FL_INDEX_COUNT; i++) {
+        t->sl_bitmap[i] = 0;
+        for (int j = 0; j < TLSF_SL_INDEX_COUNT; j++)
+            t->blocks[i][j] = &t->block_null;
+    }
+    t->free_blocks = 0;
+    t->used_size = 0;
+    t->total_size = 0;
+
+    /* Reserve space for the first block header and the tail sentinel */
+    bytes -= start - (uintptr_t)mem;
+    if (bytes < 2 * BLOCK_OVERHEAD + BLOCK_SIZE_MIN)
+        return -EINVAL;
+
+    size = (bytes - 2 * BLOCK_OVERHEAD) & ~((size_t)TLSF_ALIGN - 1);
+    if (size >= BLOCK_SIZE_MAX)
+        size = BLOCK_SIZE_MAX - TLSF_ALIGN;
+
+    /*
+     * The prev_phys field of the first block is outside of the memory,
+     * it is never accessed because the previous block is marked as used
+     */
+    b = (struct tlsf_block *)(start - BLOCK_OVERHEAD);
+    b->size = size | BLOCK_FREE;
+    block_insert(t, b);
+
+    next = block_link_next(b);
+    next->size = BLOCK_PREV_FREE;
+
+    t->total_size = size;
+    return 0;
+}
@@ -6,6 +6,7 @@
 #define TX_API_EXTENSION_H_
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #include "basework/compiler_attributes.h"
@@ -55,6 +56,25 @@ extern "C"{
 
 UINT tx_os_nanosleep(uint64_t time);
 UINT tx_os_delay(uint64_t nano_sec);
+uint32_t tx_os_delay_latency(void);
+
+/*
+ * Tickless idle (CONFIG_TICKLESS). @wakeups counts the exits from a
+ * stopped tick, @skipped the ticks that were caught up instead of being
+ * taken as interrupts.
+ */
+struct tickless_stat {
+    uint32_t entries;
+    uint32_t wakeups;
+    uint64_t skipped;
+    bool enabled;
+};
+
+void tickless_enter(ULONG ticks);
+ULONG tickless_exit(void);
+bool tickless_wakeup_pending(void);
+void tickless_enable(bool enable);
+void tickless_get_stat(struct tickless_stat *stat);
 
 
 /*
@@ -91,25 +111,160 @@ void object_free(struct object_pool *pool, void *obj);
 int  object_pool_initialize(struct object_pool *pool, void *buffer, size_t size, 
     size_t objsize);
 
+/*
+ * Lock-free object pool
+ *
+ * The free list head is a tagged index (tag:index) that is updated with
+ * compare-and-swap, the tag is bumped on every update to defeat ABA.
+ * Index 0 means empty, so a pool can hold at most LOCKFREE_POOL_MAX_OBJECTS.
+ */
+#define LOCKFREE_POOL_INDEX_BITS   (sizeof(uintptr_t) * 4)
+#define LOCKFREE_POOL_INDEX_MASK   (((uintptr_t)1 << LOCKFREE_POOL_INDEX_BITS) - 1)
+#define LOCKFREE_POOL_MAX_OBJECTS  LOCKFREE_POOL_INDEX_MASK
+
+struct object_pool_stat {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures;
+    unsigned long inuse;
+    unsigned long peak;
+};
+
+struct lockfree_pool {
+    uintptr_t head;
+    char *base;
+    size_t objsize;
+    size_t nobjs;
+    struct object_pool_stat stat;
+};
+
+void *lockfree_allocate(struct lockfree_pool *pool);
+void lockfree_free(struct lockfree_pool *pool, void *obj);
+int  lockfree_pool_initialize(struct lockfree_pool *pool, void *buffer, size_t size, 
+    size_t objsize);
+void lockfree_pool_get_stat(struct lockfree_pool *pool, struct object_pool_stat *stat);
+
 /*
  * Task Runner
+ *
+ * Each runner has one pending list per priority level (0 is the highest),
+ * a bitmap of the non-empty lists selects the next task in O(1).
+ *
+ * Tasks are posted to a wait-free multi-producer submission queue without
+ * disabling interrupts, the runner thread moves them to the pending lists.
+ * The runner semaphore is only signalled when the runner goes to sleep.
+ *
+ * Delayed tasks are kept in a hierarchical timer wheel owned by the runner
+ * and driven by a single one-shot kernel timer programmed for the next
+ * occupied slot, an idle wheel does not cost a tick interrupt. Insert and
+ * cancel are O(1).
  */
+#ifndef CONFIG_TASK_RUNNER_PRIO_LEVELS
+#define CONFIG_TASK_RUNNER_PRIO_LEVELS 4
+#endif
+#ifndef CONFIG_TASK_RUNNER_WHEEL_BITS
+#define CONFIG_TASK_RUNNER_WHEEL_BITS 5
+#endif
+
+#define TASK_WHEEL_LEVELS 4
+#define TASK_WHEEL_BITS   CONFIG_TASK_RUNNER_WHEEL_BITS
+#define TASK_WHEEL_SLOTS  (1u << TASK_WHEEL_BITS)
+
+#define TASK_PRIO_LEVELS  CONFIG_TASK_RUNNER_PRIO_LEVELS
+#define TASK_PRIO_HIGHEST 0
+#define TASK_PRIO_LOWEST  (TASK_PRIO_LEVELS - 1)
+#define TASK_PRIO_NORMAL  (TASK_PRIO_LEVELS / 2)
+
+struct task_queue_stat {
+    unsigned long posted;
+    unsigned long executed;
+    unsigned int depth;
+    unsigned int max_depth;
+    uint32_t wait_max;          /* TX_TASK_RUNNER_TIMESTAMP() units */
+    unsigned long long wait_total;
+};
+
+struct task_wheel {
+    TX_TIMER timer;
+    uint32_t now;               /* The next tick to be processed */
+    uint32_t expires;           /* The tick the timer is programmed for */
+    unsigned int count;
+    bool running;
+    struct rte_list slots[TASK_WHEEL_LEVELS][TASK_WHEEL_SLOTS];
+};
+
+struct task_link {
+    struct task_link *next;
+};
+
+/*
+ * Per handler accounting (CONFIG_TASK_RUNNER_TRACE). Times are in
+ * microseconds, histogram bucket 0 counts runs below 1us and bucket n
+ * counts [2^(n-1), 2^n) us, the last bucket is open ended.
+ */
+#ifndef CONFIG_TASK_RUNNER_TRACE_SITES
+#define CONFIG_TASK_RUNNER_TRACE_SITES 32
+#endif
+#ifndef CONFIG_TASK_RUNNER_WATCHDOG_BUDGET
+#define CONFIG_TASK_RUNNER_WATCHDOG_BUDGET 10000
+#endif
+
+#define TASK_TRACE_BUCKETS 16
+
+struct task;
+struct task_runner;
+
+struct task_handler_stat {
+    void (*handler)(struct task *);
+    struct task_runner *runner;
+    unsigned long count;
+    unsigned long overruns;
+    uint32_t run_max;
+    uint32_t wait_max;
+    unsigned long long run_total;
+    unsigned long long wait_total;
+    uint32_t run_hist[TASK_TRACE_BUCKETS];
+    uint32_t wait_hist[TASK_TRACE_BUCKETS];
+};
+
 struct task_runner {
     TX_THREAD pid;
     TX_SEMAPHORE sem;
-    struct rte_list pending;
+    struct task_link *inbox_tail;   /* Producers, lock-free */
+    struct task_link *inbox_head;   /* Runner thread only */
+    struct task_link inbox_stub;
+    int sleeping;
+    uint32_t ready_map;
+    struct rte_list pending[TASK_PRIO_LEVELS];
     struct task *curr;
+    struct task_queue_stat stat[TASK_PRIO_LEVELS];
+    struct task_wheel wheel;
+#ifdef CONFIG_TASK_RUNNER_TRACE
+    struct rte_list trace_node;
+    struct task *stalled;       /* Last task reported by the watchdog */
+    uint32_t curr_start;        /* TX_TASK_RUNNER_TIMESTAMP() units */
+    uint32_t budget;            /* Microseconds, 0 disables the watchdog */
+    unsigned int depth;
+    unsigned int max_depth;
+#endif
 };
 
 struct task {
     struct rte_list node;
+    struct task_link link;
     void (*handler)(struct task *);
     struct task_runner *runner;
+    uint32_t timestamp;
+    uint8_t prio;
+    uint8_t state;
 };
 
 struct delayed_task {
     struct task base;
-    TX_TIMER timer;
+    struct rte_list tnode;
+    uint32_t expires;
+    uint32_t period;
+    uint8_t prio;
 };
 
 #define to_delayedtask(_task) \
@@ -117,12 +272,29 @@ struct delayed_task {
 
 extern struct task_runner _system_taskrunner;
 
+int __task_post_prio(struct task_runner *runner, struct task *task, 
+    unsigned int prio);
+int task_post_prio(struct task_runner *runner, struct task *task, 
+    unsigned int prio);
 int __task_post(struct task_runner *runner, struct task *task);
 int task_post(struct task_runner *runner, struct task *task);
 int __delayed_task_post(struct task_runner *runner, struct delayed_task *task, 
-    unsigned long ticks);
+    unsigned long ticks, unsigned int prio);
 int delayed_task_post(struct task_runner *runner, struct delayed_task *task, 
     unsigned long ticks);
+int delayed_task_post_prio(struct task_runner *runner, struct delayed_task *task, 
+    unsigned long ticks, unsigned int prio);
+int delayed_task_post_periodic(struct task_runner *runner, struct delayed_task *task, 
+    unsigned long ticks, unsigned long period);
+
+/*
+ * Cancel a task that has not started yet. With @wait the call also waits
+ * for a running handler to return and for the runner to drop the task, the
+ * memory of the task can be reused afterwards. Without @wait a task that
+ * was still in the submission queue stays referenced by the runner until it
+ * is drained, it must not be freed or initialized again until its state is
+ * back to idle (a new post of the same task is fine).
+ */
 int __task_cancel(struct task *task, bool wait);
 int task_cancel(struct task *task, bool wait);
 int __delayed_task_cancel(struct delayed_task *task, bool wait);
@@ -131,6 +303,15 @@ void init_task(struct task *task, void (*handler)(struct task *));
 void init_delayed_task(struct delayed_task *task, void (*handler)(struct task *));
 int task_runner_construct(struct task_runner *runner, const char *name, void *stack, 
     size_t stack_size, unsigned int prio, int cpu);
+int task_runner_get_stat(struct task_runner *runner, unsigned int prio, 
+    struct task_queue_stat *stat);
+int task_thread_bind_cpu(TX_THREAD *thread, int cpu);
+#ifdef CONFIG_TASK_RUNNER_TRACE
+void task_runner_foreach(bool (*iterator)(struct task_runner *, void *), void *arg);
+int task_runner_set_budget(struct task_runner *runner, uint32_t budget_us);
+int task_runner_get_handlers(struct task_handler_stat *stats, int max);
+void task_runner_reset_trace(void);
+#endif
 
 #define ktask_post(_task) \
     task_post(&_system_taskrunner, (_task))
@@ -138,6 +319,55 @@ int task_runner_construct(struct task_runner *runner, const char *name, void *st
 #define delayed_ktask_post(_task, _delay) \
     delayed_task_post(&_system_taskrunner, (_task), (_delay))
 
+#define ktask_post_prio(_task, _prio) \
+    task_post_prio(&_system_taskrunner, (_task), (_prio))
+
+#define delayed_ktask_post_prio(_task, _delay, _prio) \
+    delayed_task_post_prio(&_system_taskrunner, (_task), (_delay), (_prio))
+
+#define delayed_ktask_post_periodic(_task, _delay, _period) \
+    delayed_task_post_periodic(&_system_taskrunner, (_task), (_delay), (_period))
+
+/*
+ * Task Pool
+ *
+ * A group of worker threads that each own a deque of tasks. A worker pops
+ * its newest task from the head, idle workers steal the oldest task from
+ * the tail of a busy worker. Tasks posted to a pool can not be cancelled.
+ */
+#ifndef CONFIG_TASK_POOL_MAX_CHUNKS
+#define CONFIG_TASK_POOL_MAX_CHUNKS 16
+#endif
+
+#define TASK_POOL_MAX_WORKERS 32
+
+struct task_pool;
+
+struct task_pool_worker {
+    TX_THREAD pid;
+    TX_SEMAPHORE sem;
+    struct rte_list deque;
+    struct task_pool *pool;
+    unsigned int depth;
+    unsigned long executed;
+    unsigned long stolen;
+};
+
+struct task_pool {
+    struct task_pool_worker *workers;
+    unsigned int nr_workers;
+    unsigned int next;
+    uint32_t idle_map;
+};
+
+int task_pool_construct(struct task_pool *pool, struct task_pool_worker *workers,
+    unsigned int nr_workers, const char *name, void *stack, size_t stack_size,
+    unsigned int prio, int cpu);
+int task_pool_destroy(struct task_pool *pool);
+int task_pool_post(struct task_pool *pool, struct task *task);
+int task_pool_parallel_for(struct task_pool *pool, size_t begin, size_t end,
+    size_t grain, void (*fn)(size_t begin, size_t end, void *arg), void *arg);
+
 
 
 /*
@@ -188,9 +418,35 @@ void __do_init_array(void);
  * System intitialize 
  */
 #if TX_USE_USE_SYSINIT_API_EXTENSION
+struct sysinit_item;
+
+struct sysinit_state {
+#ifdef CONFIG_SYSINIT_PARALLEL
+   struct task task;
+   const struct sysinit_item *item;
+   ULONG start;   /* Ticks since do_sysinit() started */
+   ULONG end;
+#endif
+   int err;
+   uint8_t status;
+};
+
 struct sysinit_item {
    int (*handler)(void);
    const char *name;
+   const char *const *depends;  /* NULL terminated handler names */
+   struct sysinit_state *state;
+   uint16_t order;
+   uint16_t flags;
+};
+
+#define SYSINIT_F_ASYNC 0x0001
+
+struct sysinit_stat {
+   uint32_t items;
+   uint32_t async;
+   uint32_t boot_ms;      /* Time spent in do_sysinit() */
+   uint32_t serial_ms;    /* Sum of the handler times */
 };
 
 /* 
@@ -204,20 +460,40 @@ struct sysinit_item {
 #define SI_FILESYSTEM_LEVEL    90
 #define SI_APPLICATION_LEVEL   99
 
+/*
+ * A level starts when every item of the previous levels has completed.
+ * SYSINIT items of a level run in order and do not wait for the
+ * SYSINIT_ASYNC or SYSINIT_DEPENDS items of their level, which run
+ * concurrently with the rest of the level. A SYSINIT_DEPENDS item starts
+ * once the named handlers of its level have completed.
+ */
 #define SYSINIT(_handler, _level, _order) \
-    __SYSINIT(_handler, _level, _order)
+    __SYSINIT(_handler, _level, _order, 0, NULL)
 
-#define __SYSINIT(_handler, _level, _order) \
-    ___SYSINIT(_handler, 0x##_level##_order)
+#define SYSINIT_ASYNC(_handler, _level, _order) \
+    __SYSINIT(_handler, _level, _order, SYSINIT_F_ASYNC, NULL)
 
-#define ___SYSINIT(_handler, _order) \
+#define SYSINIT_DEPENDS(_handler, _level, _order, ...) \
+    __SYSINIT(_handler, _level, _order, SYSINIT_F_ASYNC, \
+        ((const char *const []){__VA_ARGS__, NULL}))
+
+#define __SYSINIT(_handler, _level, _order, _flags, _depends) \
+    ___SYSINIT(_handler, 0x##_level##_order, _flags, _depends)
+
+#define ___SYSINIT(_handler, _order, _flags, _depends) \
     enum { __enum_##_handler = _order}; \
+    static struct sysinit_state __sysinit_state_##_handler; \
     static LINKER_ROSET_ITEM_ORDERED(sysinit, struct sysinit_item, \
         _handler, _order) = { \
         .handler = _handler, \
-        .name = #_handler \
+        .name = #_handler, \
+        .depends = _depends, \
+        .state = &__sysinit_state_##_handler, \
+        .order = _order, \
+        .flags = _flags \
    }
 
+void sysinit_get_stat(struct sysinit_stat *stat);
 void do_sysinit(void);
 #endif /* TX_USE_USE_SYSINIT_API_EXTENSION */
 /*
@@ -230,16 +506,181 @@ void *__kmalloc(size_t size, unsigned int gmf);
 void *__kzalloc(size_t size, unsigned int gmf);
 void  __kfree(void *ptr);
 
+/*
+ * Slab size class statistics (CONFIG_KMALLOC_SLAB)
+ */
+struct kmem_class_stat {
+    size_t objsize;
+    unsigned long pages;
+    unsigned long total;
+    unsigned long inuse;
+    unsigned long peak;
+    unsigned long allocs;
+};
+
+int kmalloc_get_class_stat(unsigned int idx, struct kmem_class_stat *stat);
+unsigned long kmalloc_get_large_allocs(void);
+
 #define kmalloc(s, f) __kmalloc(s, f)
 #define kzalloc(s, f) __kzalloc(s, f)
 #define kfree(p)      __kfree(p)
 
+/*
+ * Heap statistics
+ */
+struct heap_stat {
+    size_t total_size;
+    size_t used_size;
+    size_t free_size;
+    size_t largest_free;
+    unsigned long free_blocks;
+    unsigned int frag_percent; /* 100 - largest_free * 100 / free_size */
+};
+
+/*
+ * Two-Level Segregated Fit allocator (not thread safe)
+ */
+#ifndef TLSF_FL_INDEX_MAX
+#define TLSF_FL_INDEX_MAX    24  /* Maximum block size is 16MB */
+#endif
+#define TLSF_SL_INDEX_LOG2   4
+#define TLSF_SL_INDEX_COUNT  (1 << TLSF_SL_INDEX_LOG2)
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define TLSF_ALIGN_SHIFT     3
+#else
+#define TLSF_ALIGN_SHIFT     2
+#endif
+#define TLSF_FL_INDEX_SHIFT  (TLSF_SL_INDEX_LOG2 + TLSF_ALIGN_SHIFT)
+#define TLSF_FL_INDEX_COUNT  (TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+
+struct tlsf_block {
+    struct tlsf_block *prev_phys;
+    size_t size;
+    struct tlsf_block *next_free;
+    struct tlsf_block *prev_free;
+};
+
+struct tlsf {
+    struct tlsf_block block_null;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_INDEX_COUNT];
+    struct tlsf_block *blocks[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+    size_t total_size;
+    size_t used_size;
+    unsigned long free_blocks;
+};
+
+int   tlsf_init(struct tlsf *t, void *mem, size_t bytes);
+void *tlsf_malloc(struct tlsf *t, size_t size);
+void  tlsf_free(struct tlsf *t, void *ptr);
+size_t tlsf_block_size(const void *ptr);
+void  tlsf_get_stat(struct tlsf *t, struct heap_stat *stat);
+
+/*
+ * General memory allocate interface (CONFIG_MALLOC)
+ */
+void *__general_malloc(size_t size);
+void *__general_calloc(size_t n, size_t size);
+void  __general_free(void *ptr);
+void  __general_tcache_drain(TX_THREAD *thread);
+int   malloc_get_heap_stat(struct heap_stat *stat);
+
+/*
+ * Heap allocation profiler (CONFIG_HEAP_PROFILE)
+ */
+#define HEAP_PROFILE_KERNEL   0
+#define HEAP_PROFILE_GENERAL  1
+#define HEAP_PROFILE_MAX      2
+#define HEAP_PROFILE_HEADER_SIZE 8
+
+struct heap_site_stat {
+    uintptr_t caller;     /* 0: sites that overflow the table */
+    unsigned int heap;
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long live_count;
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+struct heap_profile_total {
+    size_t live_bytes;
+    size_t peak_bytes;
+};
+
+void *heap_profile_record(void *block, size_t size, unsigned int heap,
+    void *caller);
+void *heap_profile_release(void *ptr);
+int heap_profile_get_sites(struct heap_site_stat *sites, int max);
+int heap_profile_get_total(unsigned int heap, struct heap_profile_total *total);
+
+/*
+ * DMA coherent memory (CONFIG_DMA_COHERENT)
+ * The returned buffer is at least cache line aligned and the size is 
+ * rounded up to power of two
+ */
+void *__dma_coherent_alloc(size_t size, unsigned int gmf);
+void  __dma_coherent_free(void *ptr);
+size_t dma_coherent_free_size(void);
+size_t dma_coherent_min_free_size(void);
+
+#define dma_coherent_alloc(s, f) __dma_coherent_alloc(s, f)
+#define dma_coherent_free(p)     __dma_coherent_free(p)
+
 /*
  * Platform interface
  */
 int printk(const char *fmt, ...) __rte_printf(1, 2);
 int vprintk(const char *fmt, va_list ap);
 
+/*
+ * Deferred printk (CONFIG_PRINTK_DEFERRED)
+ *
+ * printk() queues a record and returns 0, the printk thread formats it
+ * later. printk_panic() outputs the queued records in the caller context
+ * and makes printk synchronous, it is meant for fault handlers.
+ *
+ * The record keeps a pointer to the format, so the format of printk() must
+ * be a string literal. The printk() macro below places it in the .log_dict
+ * section and any other format fails to build. vprintk() takes any format
+ * and outputs it synchronously when it is not in the section. Only printk()
+ * is deferred: pr_err(), pr_info() and the other basework log macros reach
+ * vprintk() through the board printer and are always printed synchronously.
+ */
+struct printk_stat {
+	uint32_t records;  /* Records written to the console */
+	uint32_t dropped;  /* Records dropped because the ring was full */
+	uint32_t pending;  /* Bytes */
+	uint32_t peak;     /* Bytes */
+	uint32_t size;     /* Bytes */
+};
+
+int  __printk_log(const char *fmt, va_list ap);
+void printk_flush(void);
+void printk_panic(void);
+bool printk_set_deferred(bool enable);
+void printk_get_stat(struct printk_stat *stat);
+
+/*
+ * Log dictionary (CONFIG_PRINTK_DICTIONARY)
+ *
+ * The printk() formats are collected in the .log_dict section and the
+ * deferred records are sent as the format offset in the dictionary and
+ * the binary arguments. scripts/log_decoder.py rebuilds the text from the
+ * ELF file. Output of the pr_*() macros stays text.
+ */
+#ifdef CONFIG_PRINTK_DEFERRED
+static inline void __rte_printf(1, 2) __printk_check(const char *fmt, ...) {
+	(void) fmt;
+}
+
+#define printk(fmt, ...) ({ \
+	static const char __printk_fmt[] __rte_section(".log_dict") = fmt; \
+	(void) sizeof(__printk_check(fmt, ##__VA_ARGS__), 0); \
+	printk(__printk_fmt, ##__VA_ARGS__); \
+})
+#endif /* CONFIG_PRINTK_DEFERRED */
+
 int init_irq(void);
 int enable_irq(int irq);
 int disable_irq(int irq);
@@ -250,6 +691,59 @@ int gpio_request_irq(uint32_t gpio, void (*fn)(int line, void *arg), void *arg,
 					 bool rising_edge, bool falling_edge);
 int gpio_remove_irq(uint32_t gpio, void (*fn)(int line, void *arg), void *arg);
 
+/*
+ * Threaded interrupt (CONFIG_IRQ_THREAD)
+ *
+ * @handler runs in interrupt context and returns IRQ_WAKE_THREAD to schedule
+ * @thread_fn on the interrupt task runner (NULL always wakes the thread).
+ * Interrupts raised while @thread_fn is pending are coalesced.
+ */
+#define IRQ_NONE          0
+#define IRQ_HANDLED       1
+#define IRQ_WAKE_THREAD   2
+
+#define IRQF_ONESHOT      0x1 /* Keep the line masked until @thread_fn returns */
+
+struct irq_thread {
+	struct task task;
+	int (*handler)(void *arg);
+	void (*thread_fn)(void *arg);
+	void *arg;
+	int irq;
+	unsigned int flags;
+	unsigned long raised;
+	unsigned long coalesced;
+	unsigned long executed;
+};
+
+extern struct task_runner _irq_taskrunner;
+
+int request_threaded_irq(int irq, struct irq_thread *it, int (*handler)(void *),
+	void (*thread_fn)(void *), void *arg, unsigned int flags);
+int remove_threaded_irq(int irq, struct irq_thread *it);
+
+/*
+ * Per vector interrupt accounting (CONFIG_IRQ_STAT). Times are in
+ * IRQ_STAT_CYCLES() units, histogram bucket 0 counts handlers shorter
+ * than 2^IRQ_STAT_HIST_SHIFT cycles and bucket n counts
+ * [2^(n+IRQ_STAT_HIST_SHIFT-1), 2^(n+IRQ_STAT_HIST_SHIFT)) cycles, the last
+ * bucket is open ended.
+ */
+#define IRQ_STAT_BUCKETS     16
+#define IRQ_STAT_HIST_SHIFT  6
+
+struct irq_stat {
+	uint32_t count;
+	uint32_t max;
+	uint64_t total;
+	uint32_t hist[IRQ_STAT_BUCKETS];
+};
+
+int irq_stat_get(int irq, struct irq_stat *stat);
+void irq_stat_reset(void);
+uint32_t irq_stat_cycles_per_us(void);
+ULONG irq_stat_since(void);
+
 /*
  * Console interface
  */
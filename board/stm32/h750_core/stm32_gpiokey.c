@@ -30,7 +30,7 @@ static void stm32_gpiokey_isr(int line, void *arg) {
     struct stm32_gpiokey *key = arg;
     (void) line;
     key->state = stm32_pin_get(key->gpio);
-    delayed_ktask_post(&key->task, TX_MSEC(10));
+    delayed_ktask_post_prio(&key->task, TX_MSEC(10), TASK_PRIO_HIGHEST);
 }
 
 
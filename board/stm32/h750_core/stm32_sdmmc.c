@@ -30,6 +30,7 @@ struct stm32_sdmmc {
     TX_SEMAPHORE sdio_idle;
     volatile uint32_t status;
     uint32_t mclk;
+    uint8_t *dma_buffer;
     const struct stm32_sdmmc_config *config;
 };
 
@@ -138,7 +139,6 @@ stm32_sdmmc_wait_complete(struct stm32_sdmmc *sd, struct mmcsd_cmd *cmd) {
 static int 
 stm32_sdmmc_sendcmd(struct stm32_sdmmc *sd, struct mmcsd_cmd *cmd, 
     struct mmcsd_data *data) {
-    static uint8_t dma_buffer[SDIO_BUFF_SIZE] __rte_aligned(RTE_CACHE_LINE_SIZE);
     SDMMC_TypeDef *reg = sd->reg;
     void *pbuffer = NULL;
     uint32_t regcmd;
@@ -171,15 +171,15 @@ stm32_sdmmc_sendcmd(struct stm32_sdmmc *sd, struct mmcsd_cmd *cmd,
         rte_assert(bytes <= SDIO_BUFF_SIZE);
         pbuffer = data->buf;
         if ((uintptr_t)pbuffer & (RTE_CACHE_LINE_SIZE - 1)) {
-            pbuffer = dma_buffer;
+            /* The bounce buffer is non-cacheable, no cache maintenance needed */
+            pbuffer = sd->dma_buffer;
             if (data->flags & DATA_DIR_WRITE)
                 memcpy(pbuffer, data->buf, bytes);
-        }
-    
-        if (data->flags & DATA_DIR_WRITE)
+        } else if (data->flags & DATA_DIR_WRITE) {
             SCB_CleanDCache_by_Addr(pbuffer, bytes);
-        else
+        } else {
             SCB_InvalidateDCache_by_Addr(pbuffer, bytes);
+        }
         regcmd |= SDMMC_CMD_CMDTRANS;
         reg->MASK &= ~(SDMMC_MASK_CMDRENDIE | SDMMC_MASK_CMDSENTIE);
         reg->DTIMER = UINT32_MAX;
@@ -211,7 +211,7 @@ stm32_sdmmc_sendcmd(struct stm32_sdmmc *sd, struct mmcsd_cmd *cmd,
             tx_thread_sleep(TX_MSEC(1));
         }
 
-        if (pbuffer == dma_buffer && (data->flags & DATA_DIR_READ)) 
+        if (pbuffer == sd->dma_buffer && (data->flags & DATA_DIR_READ)) 
             memcpy(data->buf, pbuffer, bytes);
     }
 
@@ -260,6 +260,12 @@ static int _stm32_sdmmc_init(struct stm32_sdmmc *sd) {
     struct mmcsd_host *host = &sd->host;
     int err;
 
+    sd->dma_buffer = dma_coherent_alloc(SDIO_BUFF_SIZE, 0);
+    if (sd->dma_buffer == NULL) {
+        pr_err("failed to allocate dma buffer\n");
+        return -ENOMEM;
+    }
+
     mmcsd_host_init(&sd->host);
     err = request_irq(config->irq, stm32_sdmmc_isr, sd);
     if (err) {
@@ -294,6 +300,7 @@ static int _stm32_sdmmc_init(struct stm32_sdmmc *sd) {
 
 _remove_host:
     mmcsd_host_uninit(&sd->host);
+    dma_coherent_free(sd->dma_buffer);
     return err;
 }
 
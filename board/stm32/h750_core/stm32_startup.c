@@ -22,6 +22,7 @@ extern void PendSV_Handler(void);
 void _stm32_exception_handler(void);
 void _stm32_reset(void);
 static void stm32_clock_setup(void);
+static void stm32_mpu_setup(void);
 static void early_console_init(void);
 
 static char _main_stack[4096] __rte_section(".dtcm") __rte_aligned(8);
@@ -92,6 +93,9 @@ _stm32_reset(void) {
 	stm32_clock_setup();
 	early_console_init();
 
+	/* Setup memory attributes before cache enabled */
+	stm32_mpu_setup();
+
 	/* Enable I- and D-Caches */
 	SCB_EnableICache();
 	SCB_EnableDCache();
@@ -109,6 +113,31 @@ _stm32_reset(void) {
 	while (1);
 }
 
+static void stm32_mpu_setup(void) {
+#ifdef CONFIG_DMA_COHERENT
+	extern char _dma_coherent_start[];
+	MPU_Region_InitTypeDef region = {0};
+
+	HAL_MPU_Disable();
+
+	/* DMA coherent region: 64KB, normal memory, non-cacheable, shareable */
+	region.Enable = MPU_REGION_ENABLE;
+	region.Number = MPU_REGION_NUMBER0;
+	region.BaseAddress = (uint32_t)_dma_coherent_start;
+	region.Size = MPU_REGION_SIZE_64KB;
+	region.SubRegionDisable = 0;
+	region.TypeExtField = MPU_TEX_LEVEL1;
+	region.AccessPermission = MPU_REGION_FULL_ACCESS;
+	region.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+	region.IsShareable = MPU_ACCESS_SHAREABLE;
+	region.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+	region.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+	HAL_MPU_ConfigRegion(&region);
+
+	HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+#endif /* CONFIG_DMA_COHERENT */
+}
+
 static void stm32_clock_setup(void) {
 	RCC_OscInitTypeDef RCC_OscInitStruct = {0};
 	RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
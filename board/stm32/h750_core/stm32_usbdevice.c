@@ -1401,4 +1401,4 @@ static int stm32_usbdevice_init(void) {
     return 0;
 }
 
-SYSINIT(stm32_usbdevice_init, SI_BUSDRIVER_LEVEL, 60);
+SYSINIT_ASYNC(stm32_usbdevice_init, SI_BUSDRIVER_LEVEL, 60);
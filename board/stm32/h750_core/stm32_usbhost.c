@@ -2326,4 +2326,4 @@ static int stm32_usbhost_init(void) {
 	return 0;
 }
 
-SYSINIT(stm32_usbhost_init, SI_BUSDRIVER_LEVEL, 60);
+SYSINIT_ASYNC(stm32_usbhost_init, SI_BUSDRIVER_LEVEL, 60);
@@ -43,6 +43,7 @@ static UINT sd_media_read(VOID *storage, ULONG lun, UCHAR *data_pointer,
     req.blkno  = lba;
     req.blkcnt = number_blocks;
     req.buffer = data_pointer;
+    req.nsegs  = 0;
     return blkdev_request(storage_devlist[STORAGE_SD], &req);
 }
 
@@ -59,6 +60,7 @@ static UINT sd_media_write(VOID *storage, ULONG lun, UCHAR *data_pointer,
     req.blkno  = lba;
     req.blkcnt = number_blocks;
     req.buffer = data_pointer;
+    req.nsegs  = 0;
     return blkdev_request(storage_devlist[STORAGE_SD], &req);
 }
 
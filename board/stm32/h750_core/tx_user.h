@@ -41,6 +41,12 @@
 /* Task runner */
 #define TX_TASK_RUNNER_STACK_SIZE 1024
 #define TX_TASK_RUNNER_PRIO 12
+#define TX_TASK_RUNNER_TIMESTAMP() HRTIMER_JIFFIES /* Wait time in timer cycles */
+#define TX_TASK_RUNNER_TIMESTAMP_US(n) HRTIMER_CYCLE_TO_US(n)
+
+/* Threaded interrupt */
+#define TX_IRQ_THREAD_STACK_SIZE 1024
+#define TX_IRQ_THREAD_PRIO 1
 
 /* */
 #define __fastcode  __rte_section(".itcm")
@@ -53,6 +59,13 @@
 #define HRTIMER_JIFFIES  *((volatile uint32_t *)0x40000024UL)
 #define HRTIMER_CYCLE_TO_US(n) ((n) / (240 / HR_TIMER_PRESCALER))
 
+/* Tickless idle, SysTick is stopped while WFI waits (tickless.c) */
+#ifdef CONFIG_TICKLESS
+#define TX_LOW_POWER
+#define TX_LOW_POWER_TIMER_SETUP(_ticks) tickless_enter(_ticks)
+#define TX_LOW_POWER_USER_TIMER_ADJUST   tickless_exit()
+#endif
+
 /*
  * FileX for filesystem
  */
@@ -83,8 +96,36 @@
 #define BOARD_IRQ_MAX 150
 #define BOARD_SYSTICK_CLKFREQ HAL_RCCEx_GetD1SysClockFreq()
 
+/*
+ * Tick control for the tickless idle. The phase is the time since the
+ * last tick in nanoseconds, a tick that is already pending still fires
+ * after the counter is stopped.
+ */
+#define TICKLESS_TICK_STOP() \
+({ \
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk; \
+	(uint32_t)((uint64_t)(SysTick->LOAD - SysTick->VAL) * 1000000000ull / \
+		BOARD_SYSTICK_CLKFREQ); \
+})
+#define TICKLESS_TICK_START() \
+do { \
+	SysTick->VAL = 0; \
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk; \
+} while (0)
+
 #define IRQ_VECTOR_GET()  ((SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) - 16)
 
+/* Interrupt accounting (DWT cycle counter) */
+#define IRQ_STAT_CYCLES() DWT->CYCCNT
+#define IRQ_STAT_CYCLES_PER_US (SystemCoreClock / 1000000)
+#define IRQ_STAT_INIT() \
+do { \
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+	DWT->LAR = 0xC5ACCE55; \
+	DWT->CYCCNT = 0; \
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+} while (0)
+
 /* Console */
 #define CONSOLE_DEFAULT_SPEED 2000000
 
@@ -292,6 +292,9 @@ static void __rte_used stm32_fault_process(void *msp, void *psp, __u32 exec_ret,
     int fault = SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
     struct excep_frame *esf;
 
+#ifdef CONFIG_PRINTK_DEFERRED
+    printk_panic();
+#endif
     if (exec_ret & (1 << 3))
         esf = psp;
     else
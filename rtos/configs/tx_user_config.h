@@ -112,7 +112,12 @@
 
 #define TX_MAX_PRIORITIES                       CONFIG_TX_MAX_PRIORITIES
 #define TX_MINIMUM_STACK                        CONFIG_TX_MINIMUM_STACK
+#ifdef CONFIG_MALLOC_TCACHE
+#define TX_THREAD_USER_EXTENSION                VOID *tx_thread_tcache;
+#define TX_THREAD_DELETE_EXTENSION(thread_ptr)  __general_tcache_drain(thread_ptr);
+#else
 // #define TX_THREAD_USER_EXTENSION
+#endif
 #define TX_TIMER_THREAD_STACK_SIZE              CONFIG_TX_TIMER_THREAD_STACK_SIZE
 #define TX_TIMER_THREAD_PRIORITY                CONFIG_TX_TIMER_THREAD_PRIORITY
 
@@ -290,8 +290,10 @@ void    __iar_Initlocks(void);
 #endif
 #else
 #define TX_THREAD_CREATE_EXTENSION(thread_ptr)
+#ifndef TX_THREAD_DELETE_EXTENSION
 #define TX_THREAD_DELETE_EXTENSION(thread_ptr)
 #endif
+#endif
 
 #if defined(__ARMVFP__) || defined(__ARM_PCS_VFP) || defined(__ARM_FP) || defined(__TARGET_FPU_VFP) || defined(__VFP__)
 
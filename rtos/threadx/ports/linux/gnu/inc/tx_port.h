@@ -425,7 +425,9 @@ void    _tx_initialize_start_interrupts(void);
 
 
 #define TX_THREAD_CREATE_EXTENSION(thread_ptr)
+#ifndef TX_THREAD_DELETE_EXTENSION
 #define TX_THREAD_DELETE_EXTENSION(thread_ptr)
+#endif
 #define TX_THREAD_COMPLETED_EXTENSION(thread_ptr)
 #define TX_THREAD_TERMINATED_EXTENSION(thread_ptr)
 
@@ -61,6 +61,13 @@ sem_t               _tx_linux_timer_semaphore;
 sem_t               _tx_linux_isr_semaphore;
 void               *_tx_linux_timer_interrupt(void *p);
 
+#ifdef TX_LOW_POWER
+/* The tick is stopped by the low power (tickless) idle.  */
+static volatile int _tx_linux_tick_stopped;
+static sem_t        _tx_linux_tick_semaphore;
+static struct timespec _tx_linux_tick_last;
+#endif /* TX_LOW_POWER */
+
 void    _tx_linux_thread_resume_handler(int sig);
 void    _tx_linux_thread_suspend_handler(int sig);
 void    _tx_linux_thread_suspend(pthread_t thread_id);
@@ -280,6 +287,12 @@ cpu_set_t mask;
     /* Create semaphore for ISR thread. */
     sem_init(&_tx_linux_isr_semaphore, 0, 0);
 
+#ifdef TX_LOW_POWER
+    /* Create semaphore to restart a stopped tick.  */
+    sem_init(&_tx_linux_tick_semaphore, 0, 0);
+    clock_gettime(CLOCK_MONOTONIC, &_tx_linux_tick_last);
+#endif /* TX_LOW_POWER */
+
     /* Setup periodic timer interrupt.  */
     if(pthread_create(&_tx_linux_timer_id, NULL, _tx_linux_timer_interrupt, NULL))
     {
@@ -351,6 +364,23 @@ int err;
             err = errno;
         } while (err != ETIMEDOUT);
 
+#ifdef TX_LOW_POWER
+        /* Skip the tick while it is stopped, the elapsed ticks are caught
+           up when the tick is restarted.  */
+        tx_linux_mutex_lock(_tx_linux_mutex);
+        if (_tx_linux_tick_stopped)
+        {
+            tx_linux_mutex_unlock(_tx_linux_mutex);
+            do
+            {
+                tx_linux_sem_wait(&_tx_linux_tick_semaphore);
+            } while (_tx_linux_tick_stopped);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &_tx_linux_tick_last);
+        tx_linux_mutex_unlock(_tx_linux_mutex);
+#endif /* TX_LOW_POWER */
+
         /* Call ThreadX context save for interrupt preparation.  */
         _tx_thread_context_save();
 
@@ -447,4 +477,37 @@ struct sigaction sa;
     sigaction(SUSPEND_SIG, &sa, NULL);
 }
 
+#ifdef TX_LOW_POWER
+/* Stop the tick, returns the nanoseconds since the last tick. Called with
+   the Linux mutex held.  */
+unsigned int _tx_linux_tick_stop(void)
+{
+struct timespec now;
+long long       phase;
+
+    _tx_linux_tick_stopped = 1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    phase = (now.tv_sec - _tx_linux_tick_last.tv_sec) * 1000000000LL +
+            (now.tv_nsec - _tx_linux_tick_last.tv_nsec);
+    if (phase < 0)
+    {
+        phase = 0;
+    }
+    if (phase >= 1000000000LL / TX_TIMER_TICKS_PER_SECOND)
+    {
+        phase = 1000000000LL / TX_TIMER_TICKS_PER_SECOND - 1;
+    }
+    return (unsigned int)phase;
+}
 
+/* Restart the tick, the next tick is one period from now.  */
+void _tx_linux_tick_start(void)
+{
+    if (_tx_linux_tick_stopped)
+    {
+        _tx_linux_tick_stopped = 0;
+        clock_gettime(CLOCK_MONOTONIC, &_tx_linux_tick_last);
+        sem_post(&_tx_linux_tick_semaphore);
+    }
+}
+#endif /* TX_LOW_POWER */
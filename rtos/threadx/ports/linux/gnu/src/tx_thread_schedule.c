@@ -30,6 +30,11 @@
 #include "tx_timer.h"
 #include <stdio.h>
 #include <errno.h>
+#ifdef TX_LOW_POWER
+#include "tx_low_power.h"
+
+extern UINT tx_low_power_entered;
+#endif /* TX_LOW_POWER */
 
 extern sem_t _tx_linux_timer_semaphore;
 extern sem_t _tx_linux_isr_semaphore;
@@ -80,6 +85,24 @@ extern pthread_t _tx_linux_timer_id;
 /*  09-30-2020     William E. Lamie         Initial Version 6.1           */
 /*                                                                        */
 /**************************************************************************/
+#ifdef TX_LOW_POWER
+/* The low power services disable interrupts, which only works from a thread
+   or an ISR in this port, so they are called in a pseudo interrupt context
+   from the scheduler.  */
+static VOID _tx_linux_low_power(VOID (*service)(VOID))
+{
+    tx_linux_mutex_lock(_tx_linux_mutex);
+    _tx_thread_system_state++;
+    tx_linux_mutex_unlock(_tx_linux_mutex);
+
+    service();
+
+    tx_linux_mutex_lock(_tx_linux_mutex);
+    _tx_thread_system_state--;
+    tx_linux_mutex_unlock(_tx_linux_mutex);
+}
+#endif /* TX_LOW_POWER */
+
 VOID   _tx_thread_schedule(VOID)
 {
 struct timespec ts;
@@ -104,6 +127,16 @@ struct timespec ts;
             if ((_tx_thread_execute_ptr != TX_NULL) && (_tx_thread_system_state == 0))
             {
 
+#ifdef TX_LOW_POWER
+                /* Catch up the ThreadX clock if the tick was stopped.  */
+                if (tx_low_power_entered)
+                {
+                    tx_linux_mutex_unlock(_tx_linux_mutex);
+                    _tx_linux_low_power(tx_low_power_exit);
+                    continue;
+                }
+#endif /* TX_LOW_POWER */
+
                 /* Get out of this loop and schedule the thread!  */
                 break;
             }
@@ -113,6 +146,19 @@ struct timespec ts;
                 /* Unlock linux mutex. */
                 tx_linux_mutex_unlock(_tx_linux_mutex);
 
+#ifdef TX_LOW_POWER
+                /* Nothing to run, stop the tick until the next timer expiry.
+                   The idle loop keeps polling, so low power mode is left only
+                   when the wakeup timer fired or a thread became ready.  */
+#ifdef TX_LOW_POWER_WAKEUP_PENDING
+                if (TX_LOW_POWER_WAKEUP_PENDING())
+                {
+                    _tx_linux_low_power(tx_low_power_exit);
+                }
+#endif /* TX_LOW_POWER_WAKEUP_PENDING */
+                _tx_linux_low_power(tx_low_power_enter);
+#endif /* TX_LOW_POWER */
+
                 /* Don't waste all the processor time here in the master thread...  */
 #ifdef TX_LINUX_NO_IDLE_ENABLE
                 while(!sem_trywait(&_tx_linux_timer_semaphore));
@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+#
+# Copyright 2024 wtcat
+#
+# log_decoder - rebuild printk text from dictionary log frames
+#
+# The target is built with CONFIG_PRINTK_DICTIONARY, its console output
+# (a serial port capture or a file) is decoded against the ELF image:
+#
+#   log_decoder.py firmware.elf console.bin
+#   ./simulator | log_decoder.py simulator
+#
+# Bytes that are not part of a valid frame are copied to the output as is,
+# so text printed before the printk thread starts or after a panic is kept.
+#
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_MAGIC = 0xA5
+FRAME_DICT = 0
+FRAME_TEXT = 1
+FRAME_DROP = 2
+
+SPEC_RE = re.compile(rb'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?([hlqjzLt]*)([a-zA-Z%])')
+
+
+class Elf:
+    """Just enough of an ELF reader to find the log dictionary"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError('%s is not an ELF file' % path)
+        self.is64 = self.data[4] == 2
+        if self.data[5] != 1:
+            raise ValueError('only little endian images are supported')
+        self.sections = self._read_sections()
+
+    def _read_sections(self):
+        if self.is64:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x3a)
+            fmt = '<IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x2e)
+            fmt = '<IIIIIIIIII'
+        sections = []
+        for i in range(shnum):
+            name, stype, flags, addr, offset, size, link, info, align, entsize = \
+                struct.unpack_from(fmt, self.data, shoff + i * shentsize)
+            sections.append(dict(name=name, type=stype, addr=addr, offset=offset,
+                                 size=size, link=link, entsize=entsize))
+        return sections
+
+    def symbol(self, wanted):
+        for sec in self.sections:
+            if sec['type'] != 2:  # SHT_SYMTAB
+                continue
+            strtab = self.sections[sec['link']]
+            for off in range(sec['offset'], sec['offset'] + sec['size'], sec['entsize']):
+                if self.is64:
+                    name, info, other, shndx, value, size = \
+                        struct.unpack_from('<IBBHQQ', self.data, off)
+                else:
+                    name, value, size, info, other, shndx = \
+                        struct.unpack_from('<IIIBBH', self.data, off)
+                start = strtab['offset'] + name
+                end = self.data.index(b'\0', start)
+                if self.data[start:end] == wanted:
+                    return value
+        raise KeyError(wanted.decode())
+
+    def read(self, addr, size):
+        for sec in self.sections:
+            if sec['type'] == 8:  # SHT_NOBITS
+                continue
+            if sec['addr'] <= addr and addr + size <= sec['addr'] + sec['size']:
+                start = sec['offset'] + addr - sec['addr']
+                return self.data[start:start + size]
+        raise ValueError('address 0x%x is not in the image' % addr)
+
+
+class Dictionary:
+    def __init__(self, elf):
+        start = elf.symbol(b'__log_dict_start')
+        end = elf.symbol(b'__log_dict_end')
+        self.data = elf.read(start, end - start) if end > start else b''
+        self.long_bits = 64 if elf.is64 else 32
+
+    def format(self, offset):
+        end = self.data.index(b'\0', offset)
+        return self.data[offset:end]
+
+
+class Reader:
+    def __init__(self, payload):
+        self.data = payload
+        self.pos = 0
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    def bytes(self, size):
+        if self.pos + size > len(self.data):
+            raise IndexError('frame too short')
+        value = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return value
+
+
+def signed(value, bits):
+    value &= (1 << bits) - 1
+    return value - (1 << bits) if value >> (bits - 1) else value
+
+
+def int_bits(length, long_bits):
+    if length.count(b'l') >= 2 or any(c in length for c in b'qjL'):
+        return 64
+    if b'l' in length or b'z' in length or b't' in length:
+        return long_bits
+    return 32
+
+
+def render(fmt, reader, long_bits):
+    out = []
+    pos = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()].decode(errors='replace'))
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+        if conv == b'%':
+            out.append('%')
+            continue
+        if width == b'*':
+            width = str(signed(reader.varint(), 32)).encode()
+        if prec == b'*':
+            prec = str(signed(reader.varint(), 32)).encode()
+        spec = '%' + flags.decode() + (width or b'').decode()
+        if prec is not None:
+            spec += '.' + prec.decode()
+
+        if conv in b'di':
+            out.append((spec + 'd') % signed(reader.varint(), int_bits(length, long_bits)))
+        elif conv in b'uxXo':
+            value = reader.varint() & ((1 << int_bits(length, long_bits)) - 1)
+            out.append((spec + ('d' if conv == b'u' else conv.decode())) % value)
+        elif conv == b'c':
+            out.append((spec + 'c') % chr(reader.varint() & 0xff))
+        elif conv == b'p':
+            out.append((spec + 's') % ('0x%x' % reader.varint()))
+        elif conv in b'eEfFgG':
+            value, = struct.unpack('<d', reader.bytes(8))
+            out.append((spec + conv.decode()) % value)
+        elif conv == b's':
+            text = reader.bytes(reader.varint()).decode(errors='replace')
+            out.append((spec + 's') % text)
+        else:
+            out.append(m.group(0).decode())
+    out.append(fmt[pos:].decode(errors='replace'))
+    return ''.join(out)
+
+
+class Decoder:
+    def __init__(self, dictionary, show_ticks):
+        self.dict = dictionary
+        self.show_ticks = show_ticks
+        self.tick = 0
+
+    def frame(self, payload):
+        reader = Reader(payload)
+        head = reader.varint()
+        kind, value = head & 3, head >> 2
+        if kind == FRAME_TEXT:
+            return payload[reader.pos:].decode(errors='replace')
+        if kind == FRAME_DROP:
+            return '*** printk: %d messages dropped ***\r\n' % value
+        if kind != FRAME_DICT:
+            raise ValueError('unknown frame type %d' % kind)
+        self.tick = (self.tick + reader.varint()) & 0xffffffff
+        text = render(self.dict.format(value), reader, self.dict.long_bits)
+        if reader.pos != len(payload):
+            raise ValueError('frame length mismatch')
+        if self.show_ticks:
+            text = '[%u] %s' % (self.tick, text)
+        return text
+
+    def decode(self, data, out):
+        """Decode @data, returns the bytes of a trailing incomplete frame"""
+        pos = 0
+        while pos < len(data):
+            start = data.find(bytes([FRAME_MAGIC]), pos)
+            if start < 0:
+                start = len(data)
+            if start > pos:
+                out.write(data[pos:start].decode(errors='replace'))
+            if start + 2 > len(data):
+                return data[start:]
+            length = data[start + 1]
+            if start + 3 + length > len(data):
+                return data[start:]
+            payload = data[start + 2:start + 2 + length]
+            if (length + sum(payload)) & 0xff == data[start + 2 + length]:
+                try:
+                    out.write(self.frame(payload))
+                    pos = start + 3 + length
+                    continue
+                except (IndexError, ValueError):
+                    pass
+            out.write(chr(data[start]))
+            pos = start + 1
+        return b''
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Decode printk dictionary log frames')
+    parser.add_argument('elf', help='ELF image the log was produced by')
+    parser.add_argument('input', nargs='?',
+                        help='captured log (default: standard input)')
+    parser.add_argument('-t', '--ticks', action='store_true',
+                        help='prefix every record with its tick count')
+    args = parser.parse_args()
+
+    decoder = Decoder(Dictionary(Elf(args.elf)), args.ticks)
+    stream = open(args.input, 'rb') if args.input else sys.stdin.buffer
+    pending = b''
+    while True:
+        chunk = stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+        if not chunk:
+            break
+        pending = decoder.decode(pending + chunk, sys.stdout)
+        sys.stdout.flush()
+    if pending:
+        sys.stdout.write(pending.decode(errors='replace'))
+
+
+if __name__ == '__main__':
+    main()
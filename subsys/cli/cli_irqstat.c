@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 wtcat
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "subsys/cli/cli.h"
+
+static unsigned int cycles_to_us(uint64_t cycles) {
+	return (unsigned int)(cycles / irq_stat_cycles_per_us());
+}
+
+static int irqstat_show(struct cli_process *cli) {
+	struct irq_stat stat;
+	uint64_t elapsed;
+
+	/* Elapsed time since the last reset in cycles */
+	elapsed = (uint64_t)(tx_time_get() - irq_stat_since()) * 1000000 /
+		TX_TIMER_TICKS_PER_SECOND * irq_stat_cycles_per_us();
+	if (elapsed == 0)
+		elapsed = 1;
+
+	cli_println(cli,
+	"\n"
+		" IRQ | COUNT      | TOTAL(us)  | AVG(us)  | MAX(us)  | CPU(%%)\n"
+		"-----+------------+------------+----------+----------+-------\n"
+	);
+	for (int irq = 0; irq_stat_get(irq, &stat) == 0; irq++) {
+		unsigned int load;
+
+		if (stat.count == 0)
+			continue;
+		load = (unsigned int)(stat.total * 10000 / elapsed);
+		cli_println(cli, " %-3d | %-10u | %-10u | %-8u | %-8u | %u.%02u\n",
+			irq, (unsigned int)stat.count, cycles_to_us(stat.total),
+			cycles_to_us(stat.total / stat.count), cycles_to_us(stat.max),
+			load / 100, load % 100);
+	}
+	return 0;
+}
+
+static int irqstat_show_hist(struct cli_process *cli, int argc, char *argv[]) {
+	struct irq_stat stat;
+	int only = -1;
+
+	if (argc >= 3)
+		only = (int)strtol(argv[2], NULL, 10);
+
+	cli_println(cli, "\n cycles");
+	for (int i = 0; i < IRQ_STAT_BUCKETS - 1; i++)
+		cli_println(cli, " <%-6u", 1u << (i + IRQ_STAT_HIST_SHIFT));
+	cli_println(cli, " >=%u\n", 1u << (IRQ_STAT_BUCKETS + IRQ_STAT_HIST_SHIFT - 2));
+
+	for (int irq = 0; irq_stat_get(irq, &stat) == 0; irq++) {
+		if (stat.count == 0 || (only >= 0 && irq != only))
+			continue;
+		cli_println(cli, " %-6d", irq);
+		for (int i = 0; i < IRQ_STAT_BUCKETS; i++)
+			cli_println(cli, " %7u", (unsigned int)stat.hist[i]);
+		cli_println(cli, "\n");
+	}
+	return 0;
+}
+
+static int cli_cmd_irqstat(struct cli_process *cli, int argc, char *argv[]) {
+	if (argc >= 2 && !strcmp(argv[1], "hist"))
+		return irqstat_show_hist(cli, argc, argv);
+
+	if (argc >= 2 && !strcmp(argv[1], "reset")) {
+		irq_stat_reset();
+		return 0;
+	}
+
+	if (argc >= 2)
+		return -EINVAL;
+
+	return irqstat_show(cli);
+}
+CLI_CMD(irqstat, "irqstat [hist [irq] | reset]",
+    "Show interrupt count and handler time per vector",
+    cli_cmd_irqstat
+)
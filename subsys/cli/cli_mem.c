@@ -5,7 +5,9 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "tx_api.h"
 #include "subsys/cli/cli.h"
 
 #define MAX_LINE_LENGTH_BYTES (64)
@@ -198,3 +200,130 @@ CLI_CMD(mwb, "mwb address [,count]",
     "Write memory by byte",
     cli_cmd_mwb
 )
+
+#ifdef CONFIG_KMALLOC_SLAB
+static int cli_cmd_kmem(struct cli_process *cli, int argc, char *argv[]) {
+	struct kmem_class_stat stat;
+
+	cli_println(cli,
+	"\n"
+		" SIZE   | PAGES  | TOTAL  | INUSE  | PEAK   | ALLOCS     \n"
+		"--------+--------+--------+--------+--------+------------\n"
+	);
+	for (unsigned int i = 0; !kmalloc_get_class_stat(i, &stat); i++) {
+		cli_println(cli, " %-6u | %-6lu | %-6lu | %-6lu | %-6lu | %lu\n",
+			(unsigned int)stat.objsize, stat.pages, stat.total, 
+			stat.inuse, stat.peak, stat.allocs);
+	}
+	cli_println(cli, "\nLarge allocations: %lu\n", kmalloc_get_large_allocs());
+	return 0;
+}
+CLI_CMD(kmem, "kmem",
+    "Show kernel slab usage",
+    cli_cmd_kmem
+)
+#endif /* CONFIG_KMALLOC_SLAB */
+
+#if defined(CONFIG_MALLOC_TLSF) || defined(CONFIG_HEAP_PROFILE)
+#ifdef CONFIG_HEAP_PROFILE
+#define HEAP_TOP_DEFAULT 10
+
+static struct heap_site_stat heap_site_buffer[CONFIG_HEAP_PROFILE_SITES];
+static const char *const heap_names[HEAP_PROFILE_MAX] = {
+	[HEAP_PROFILE_KERNEL]  = "kernel",
+	[HEAP_PROFILE_GENERAL] = "general"
+};
+
+/* Snapshot all call sites sorted by live bytes (descending) */
+static int heap_sites_sorted(void) {
+	struct heap_site_stat tmp;
+	int n, i, j;
+
+	n = heap_profile_get_sites(heap_site_buffer, rte_array_size(heap_site_buffer));
+	for (i = 1; i < n; i++) {
+		tmp = heap_site_buffer[i];
+		for (j = i; j > 0 && heap_site_buffer[j - 1].live_bytes < tmp.live_bytes; j--)
+			heap_site_buffer[j] = heap_site_buffer[j - 1];
+		heap_site_buffer[j] = tmp;
+	}
+	return n;
+}
+
+static int heap_show_top(struct cli_process *cli, int top) {
+	struct heap_profile_total total;
+	int n;
+
+	for (unsigned int i = 0; i < HEAP_PROFILE_MAX; i++) {
+		heap_profile_get_total(i, &total);
+		cli_println(cli, "%-8s live: %u  peak: %u\n", heap_names[i],
+			(unsigned int)total.live_bytes, (unsigned int)total.peak_bytes);
+	}
+
+	n = heap_sites_sorted();
+	if (n > top)
+		n = top;
+	cli_println(cli,
+	"\n"
+		" CALLER     | HEAP    | LIVE BYTES | LIVE OBJS  \n"
+		"------------+---------+------------+------------\n"
+	);
+	for (int i = 0; i < n; i++) {
+		struct heap_site_stat *site = &heap_site_buffer[i];
+		cli_println(cli, " 0x%08lx | %-7s | %-10u | %lu\n",
+			(unsigned long)site->caller, heap_names[site->heap],
+			(unsigned int)site->live_bytes, site->live_count);
+	}
+	return 0;
+}
+
+static int heap_show_sites(struct cli_process *cli) {
+	int n = heap_sites_sorted();
+
+	cli_println(cli,
+	"\n"
+		" CALLER     | HEAP    | ALLOCS     | FREES      | LIVE BYTES | PEAK BYTES \n"
+		"------------+---------+------------+------------+------------+------------\n"
+	);
+	for (int i = 0; i < n; i++) {
+		struct heap_site_stat *site = &heap_site_buffer[i];
+		cli_println(cli, " 0x%08lx | %-7s | %-10lu | %-10lu | %-10u | %u\n",
+			(unsigned long)site->caller, heap_names[site->heap],
+			site->allocs, site->frees, (unsigned int)site->live_bytes,
+			(unsigned int)site->peak_bytes);
+	}
+	cli_println(cli, "\n(caller 0x00000000 collects sites that overflow the table)\n");
+	return 0;
+}
+#endif /* CONFIG_HEAP_PROFILE */
+
+static int cli_cmd_heap(struct cli_process *cli, int argc, char *argv[]) {
+#ifdef CONFIG_HEAP_PROFILE
+	if (argc >= 2 && !strcmp(argv[1], "top"))
+		return heap_show_top(cli, 
+			argc >= 3? (int)strtoul(argv[2], NULL, 10): HEAP_TOP_DEFAULT);
+	if (argc >= 2 && !strcmp(argv[1], "sites"))
+		return heap_show_sites(cli);
+#endif
+#ifdef CONFIG_MALLOC_TLSF
+	struct heap_stat stat;
+	int err;
+
+	err = malloc_get_heap_stat(&stat);
+	if (err)
+		return err;
+
+	cli_println(cli, "\nTotal: %u  Used: %u  Free: %u\n",
+		(unsigned int)stat.total_size, (unsigned int)stat.used_size, 
+		(unsigned int)stat.free_size);
+	cli_println(cli, "Largest free block: %u  Free blocks: %lu  Fragmentation: %u%%\n",
+		(unsigned int)stat.largest_free, stat.free_blocks, stat.frag_percent);
+	return 0;
+#else
+	return -EINVAL;
+#endif
+}
+CLI_CMD(heap, "heap [top [n] | sites]",
+    "Show heap usage and allocation call sites",
+    cli_cmd_heap
+)
+#endif /* CONFIG_MALLOC_TLSF || CONFIG_HEAP_PROFILE */
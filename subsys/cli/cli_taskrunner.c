@@ -0,0 +1,149 @@
+/*
+ * Copyright 2024 wtcat
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "subsys/cli/cli.h"
+
+static struct task_handler_stat handler_buffer[CONFIG_TASK_RUNNER_TRACE_SITES];
+
+/* Snapshot all handlers sorted by total run time (descending) */
+static int handlers_sorted(void) {
+	struct task_handler_stat tmp;
+	int n, i, j;
+
+	n = task_runner_get_handlers(handler_buffer, rte_array_size(handler_buffer));
+	for (i = 1; i < n; i++) {
+		tmp = handler_buffer[i];
+		for (j = i; j > 0 && handler_buffer[j - 1].run_total < tmp.run_total; j--)
+			handler_buffer[j] = handler_buffer[j - 1];
+		handler_buffer[j] = tmp;
+	}
+	return n;
+}
+
+static const char *runner_name(struct task_runner *runner) {
+	return runner? (const char *)runner->pid.tx_thread_name: "-";
+}
+
+static bool show_runner(struct task_runner *runner, void *arg) {
+	struct cli_process *cli = arg;
+	struct task_queue_stat stat;
+
+	cli_println(cli, "%s: depth %u  max depth %u  budget %u us\n",
+		runner_name(runner), runner->depth, runner->max_depth,
+		(unsigned int)runner->budget);
+	for (unsigned int prio = 0; prio < TASK_PRIO_LEVELS; prio++) {
+		task_runner_get_stat(runner, prio, &stat);
+		if (stat.posted == 0)
+			continue;
+		cli_println(cli, "  level %u: posted %lu  executed %lu  max depth %u\n",
+			prio, stat.posted, stat.executed, stat.max_depth);
+	}
+	return false;
+}
+
+static int taskrunner_show(struct cli_process *cli) {
+	int n;
+
+	task_runner_foreach(show_runner, cli);
+
+	n = handlers_sorted();
+	cli_println(cli,
+	"\n"
+		" HANDLER    | RUNNER           | COUNT      | WAIT AVG | WAIT MAX | RUN AVG  | RUN MAX  | OVERRUN \n"
+		"------------+------------------+------------+----------+----------+----------+----------+---------\n"
+	);
+	for (int i = 0; i < n; i++) {
+		struct task_handler_stat *site = &handler_buffer[i];
+		cli_println(cli, " 0x%08lx | %-16.16s | %-10lu | %-8u | %-8u | %-8u | %-8u | %lu\n",
+			(unsigned long)site->handler, runner_name(site->runner), site->count,
+			(unsigned int)(site->wait_total / site->count), (unsigned int)site->wait_max,
+			(unsigned int)(site->run_total / site->count), (unsigned int)site->run_max,
+			site->overruns);
+	}
+	cli_println(cli, "\n(times in us, handler 0x00000000 collects handlers that overflow the table)\n");
+	return 0;
+}
+
+static void show_histogram(struct cli_process *cli, const char *name,
+	const uint32_t *hist) {
+	cli_println(cli, "  %-4s", name);
+	for (int i = 0; i < TASK_TRACE_BUCKETS; i++)
+		cli_println(cli, " %6u", (unsigned int)hist[i]);
+	cli_println(cli, "\n");
+}
+
+static int taskrunner_show_hist(struct cli_process *cli, int argc, char *argv[]) {
+	unsigned long handler = 0;
+	int n;
+
+	if (argc >= 3)
+		handler = strtoul(argv[2], NULL, 16);
+
+	n = handlers_sorted();
+	cli_println(cli, "\n  us  ");
+	for (int i = 0; i < TASK_TRACE_BUCKETS - 1; i++)
+		cli_println(cli, " <%-5u", 1u << i);
+	cli_println(cli, " >=%-4u\n", 1u << (TASK_TRACE_BUCKETS - 2));
+
+	for (int i = 0; i < n; i++) {
+		struct task_handler_stat *site = &handler_buffer[i];
+
+		if (handler && (unsigned long)site->handler != handler)
+			continue;
+		cli_println(cli, "0x%08lx (%s)\n", (unsigned long)site->handler,
+			runner_name(site->runner));
+		show_histogram(cli, "wait", site->wait_hist);
+		show_histogram(cli, "run", site->run_hist);
+	}
+	return 0;
+}
+
+struct budget_param {
+	const char *name;
+	uint32_t budget;
+	int count;
+};
+
+static bool set_budget(struct task_runner *runner, void *arg) {
+	struct budget_param *bp = arg;
+
+	if (bp->name == NULL || !strcmp(bp->name, runner_name(runner))) {
+		task_runner_set_budget(runner, bp->budget);
+		bp->count++;
+	}
+	return false;
+}
+
+static int cli_cmd_taskrunner(struct cli_process *cli, int argc, char *argv[]) {
+	if (argc >= 2 && !strcmp(argv[1], "hist"))
+		return taskrunner_show_hist(cli, argc, argv);
+
+	if (argc >= 2 && !strcmp(argv[1], "reset")) {
+		task_runner_reset_trace();
+		return 0;
+	}
+
+	if (argc >= 2 && !strcmp(argv[1], "budget")) {
+		struct budget_param bp;
+
+		if (argc < 3)
+			return -EINVAL;
+		bp.budget = (uint32_t)strtoul(argv[2], NULL, 10);
+		bp.name = argc >= 4? argv[3]: NULL;
+		bp.count = 0;
+		task_runner_foreach(set_budget, &bp);
+		return bp.count? 0: -ENOENT;
+	}
+
+	return taskrunner_show(cli);
+}
+CLI_CMD(taskrunner, "taskrunner [hist [handler] | budget us [runner] | reset]",
+    "Show task runner queue latency and handler run time",
+    cli_cmd_taskrunner
+)
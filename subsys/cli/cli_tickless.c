@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 wtcat
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "tx_api.h"
+#include "subsys/cli/cli.h"
+
+/* Counters at the previous 'tickless' command */
+static struct tickless_stat last_stat;
+static ULONG last_clock;
+
+static int tickless_show(struct cli_process *cli) {
+	struct tickless_stat stat;
+	ULONG clock, ticks;
+	uint32_t wakeups, interrupts;
+	uint64_t skipped;
+
+	clock = tx_time_get();
+	tickless_get_stat(&stat);
+
+	ticks = clock - last_clock;
+	skipped = stat.skipped - last_stat.skipped;
+	if (skipped > ticks)
+		skipped = ticks;
+
+	/* Every tick that was not skipped was taken as an interrupt */
+	interrupts = (uint32_t)(ticks - skipped);
+	wakeups = interrupts + (stat.wakeups - last_stat.wakeups);
+
+	cli_println(cli, "\n tickless idle: %s\n", stat.enabled? "on": "off");
+	cli_println(cli, " elapsed:       %u ticks\n", (unsigned int)ticks);
+	cli_println(cli, " tick irqs:     %u\n", (unsigned int)interrupts);
+	cli_println(cli, " idle wakeups:  %u (%u entries)\n",
+		(unsigned int)(stat.wakeups - last_stat.wakeups),
+		(unsigned int)(stat.entries - last_stat.entries));
+	cli_println(cli, " skipped ticks: %u\n", (unsigned int)skipped);
+	if (ticks > 0)
+		cli_println(cli, " wakeups/s:     %u\n",
+			(unsigned int)((uint64_t)wakeups * TX_TIMER_TICKS_PER_SECOND / ticks));
+
+	last_stat = stat;
+	last_clock = clock;
+	return 0;
+}
+
+static int cli_cmd_tickless(struct cli_process *cli, int argc, char *argv[]) {
+	if (argc >= 2 && !strcmp(argv[1], "on")) {
+		tickless_enable(true);
+		return 0;
+	}
+
+	if (argc >= 2 && !strcmp(argv[1], "off")) {
+		tickless_enable(false);
+		return 0;
+	}
+
+	if (argc >= 2)
+		return -EINVAL;
+
+	return tickless_show(cli);
+}
+CLI_CMD(tickless, "tickless [on | off]",
+    "Show the tick wakeups per second since the last call",
+    cli_cmd_tickless
+)
@@ -2,6 +2,18 @@
  * Copyright (c) 2024 wtcat(wt1454246140@gmail.com)
  *
  * Virtual Filesystem (borrowed from zephyr)
+ *
+ * Mount points are resolved through a table of pre-hashed mount paths
+ * that is read without any lock: the path is hashed one component at a
+ * time and every component boundary is looked up in the table, the last
+ * hit is the longest matching mount point. Writers update the table under
+ * fs_manager.mtx inside a sequence count, readers retry when it changed.
+ * The table keeps its own copy of the mount paths, a reader never touches
+ * a fs_class that may be gone.
+ *
+ * Path operations pin the table slot of their mount with a reference
+ * count and call the file system without holding any lock. Unmount takes
+ * the slot out of the table and waits for the references to drain.
  */
 
 #include <stdlib.h>
@@ -16,9 +28,38 @@
 #include "basework/log.h"
 
 
+#ifndef CONFIG_FS_MAX_MOUNTS
+#define CONFIG_FS_MAX_MOUNTS 8
+#endif
+
+#ifndef CONFIG_FS_MOUNT_NAME_MAX
+#define CONFIG_FS_MOUNT_NAME_MAX 16
+#endif
+
+#define FS_HASH_INIT  2166136261u
+#define FS_HASH_PRIME 16777619u
+
+/*
+ * A slot is free when @len is 0. @fs is NULL while the slot is being
+ * unmounted, @refs counts the operations that pinned it.
+ */
+struct fs_mount_entry {
+	uint32_t hash;
+	uint32_t refs;
+	size_t len;
+	struct fs_class *fs;
+	char name[CONFIG_FS_MOUNT_NAME_MAX];
+};
+
+struct fs_mount_table {
+	uint32_t seq;
+	struct fs_mount_entry entries[CONFIG_FS_MAX_MOUNTS];
+};
+
 struct fs_manager {
 	struct rte_list list;
 	struct rte_list mnt_list;
+	struct fs_mount_table table;
 	TX_MUTEX mtx;
 };
 
@@ -73,74 +114,187 @@ static const struct fs_operations *fs_type_get(int type) {
 	return (ep != NULL)? ep->fs_ops: NULL;
 }
 
-static struct fs_class *fs_mounted_get(const char *mnt) {
-	struct fs_class *iter;
-	rte_list_foreach_entry(iter, &fs_manager.mnt_list, node) {
-		if (!strcmp(mnt, iter->mnt_point))
-			return iter;
+static inline uint32_t fs_hash_step(uint32_t hash, char c) {
+	return (hash ^ (uint8_t)c) * FS_HASH_PRIME;
+}
+
+static uint32_t fs_path_hash(const char *path, size_t len) {
+	uint32_t hash = FS_HASH_INIT;
+
+	for (size_t i = 0; i < len; i++)
+		hash = fs_hash_step(hash, path[i]);
+	return hash;
+}
+
+static struct fs_mount_entry *fs_mount_table_find(struct fs_mount_table *table,
+	const char *name, size_t len, uint32_t hash) {
+	for (unsigned int i = 0; i < CONFIG_FS_MAX_MOUNTS; i++) {
+		struct fs_mount_entry *e = &table->entries[i];
+
+		if (e->fs != NULL && e->hash == hash && e->len == len &&
+			!strncmp(name, e->name, len))
+			return e;
 	}
 	return NULL;
 }
 
-static int fs_get_mnt_point(struct fs_class **mnt_pntp, const char *name,
-							size_t *match_len) {
-	struct fs_class *mnt_p = NULL, *itr;
-	size_t longest_match = 0;
-	size_t len, name_len = strlen(name);
-	struct rte_list *node;
+/* Publish @fs in @e, must be called with fs_manager.mtx held */
+static void fs_mount_table_set(struct fs_mount_entry *e, struct fs_class *fs) {
+	struct fs_mount_table *table = &fs_manager.table;
 
-	tx_mutex_get(&fs_manager.mtx, TX_WAIT_FOREVER);
-	rte_list_foreach(node, &fs_manager.mnt_list) {
-		itr = rte_container_of(node, struct fs_class, node);
-		len = itr->mountp_len;
+	scoped_guard(os_irq) {
+		__atomic_store_n(&table->seq, table->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		e->fs = fs;
+		__atomic_store_n(&table->seq, table->seq + 1, __ATOMIC_SEQ_CST);
+	}
+}
 
-		/*
-		 * Move to next node if mount point length is
-		 * shorter than longest_match match or if path
-		 * name is shorter than the mount point name.
-		 */
-		if ((len < longest_match) || (len > name_len))
-			continue;
+/* Must be called with fs_manager.mtx held */
+static int fs_mount_table_add(struct fs_class *fs, size_t len) {
+	struct fs_mount_table *table = &fs_manager.table;
+	uint32_t hash = fs_path_hash(fs->mnt_point, len);
 
-		/*
-		 * Move to next node if name does not have a directory
-		 * separator where mount point name ends.
-		 */
-		if ((len > 1) && (name[len] != '/') && (name[len] != '\0'))
+	if (len > CONFIG_FS_MOUNT_NAME_MAX)
+		return -ENAMETOOLONG;
+	if (fs_mount_table_find(table, fs->mnt_point, len, hash) != NULL)
+		return -EBUSY;
+
+	for (unsigned int i = 0; i < CONFIG_FS_MAX_MOUNTS; i++) {
+		struct fs_mount_entry *e = &table->entries[i];
+
+		if (e->len != 0)
 			continue;
 
-		/* Check for mount point match */
-		if (strncmp(name, itr->mnt_point, len) == 0) {
-			mnt_p = itr;
-			longest_match = len;
+		e->hash = hash;
+		e->len = len;
+		memcpy(e->name, fs->mnt_point, len);
+		fs->mnt_entry = e;
+		return 0;
+	}
+	return -ENOSPC;
+}
+
+/*
+ * Take @fs out of the table and wait for the operations that pinned it.
+ * Must be called with fs_manager.mtx held.
+ */
+static void fs_mount_table_drain(struct fs_class *fs) {
+	struct fs_mount_entry *e = fs->mnt_entry;
+
+	fs_mount_table_set(e, NULL);
+	while (__atomic_load_n(&e->refs, __ATOMIC_SEQ_CST) != 0)
+		tx_thread_sleep(1);
+}
+
+/*
+ * Find the longest mount point of @name, false if the table changed since
+ * @seq was read. The entry is only a hint until it is pinned.
+ */
+static bool fs_mount_lookup(const char *name, uint32_t seq,
+	struct fs_mount_entry **entry, size_t *match_len) {
+	struct fs_mount_table *table = &fs_manager.table;
+	struct fs_mount_entry *mnt_p = NULL;
+	uint32_t hash;
+	size_t len = 0;
+
+	hash = fs_hash_step(FS_HASH_INIT, name[0]);
+	for (size_t i = 1; ; i++) {
+		char c = name[i];
+
+		/* Mount point names end at a directory separator */
+		if (c == '/' || c == '\0') {
+			struct fs_mount_entry *e = fs_mount_table_find(table, name, i, hash);
+			if (e != NULL) {
+				mnt_p = e;
+				len = i;
+			}
+			if (c == '\0')
+				break;
 		}
+		hash = fs_hash_step(hash, c);
 	}
-	tx_mutex_put(&fs_manager.mtx);
 
-	if (mnt_p == NULL) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&table->seq, __ATOMIC_RELAXED) != seq)
+		return false;
+
+	*entry = mnt_p;
+	*match_len = len;
+	return true;
+}
+
+/* Must be called with fs_manager.mtx held */
+static struct fs_class *fs_mounted_get(const char *mnt) {
+	struct fs_mount_table *table = &fs_manager.table;
+	size_t len = strlen(mnt);
+	struct fs_mount_entry *e;
+
+	e = fs_mount_table_find(table, mnt, len, fs_path_hash(mnt, len));
+	return (e != NULL)? e->fs: NULL;
+}
+
+/*
+ * Resolve @name and pin its mount. The reference is taken on the table
+ * slot and is valid if the table did not change since the lookup, the
+ * unmount that changed it then waits for the reference.
+ */
+static int fs_mount_get(struct fs_class **mnt_pntp, const char *name,
+						size_t *match_len) {
+	struct fs_mount_table *table = &fs_manager.table;
+	struct fs_mount_entry *e;
+	struct fs_class *fs;
+	uint32_t seq;
+	size_t len;
+
+	if (name[0] == '\0')
 		return -ENOENT;
-	}
 
-	*mnt_pntp = mnt_p;
-	if (match_len) {
-		*match_len = mnt_p->mountp_len;
+	for ( ; ; ) {
+		seq = __atomic_load_n(&table->seq, __ATOMIC_ACQUIRE);
+		if (rte_unlikely(seq & 1))
+			continue;
+
+		if (!fs_mount_lookup(name, seq, &e, &len))
+			continue;
+		if (e == NULL)
+			return -ENOENT;
+
+		fs = e->fs;
+		__atomic_fetch_add(&e->refs, 1, __ATOMIC_SEQ_CST);
+		if (rte_likely(__atomic_load_n(&table->seq, __ATOMIC_SEQ_CST) == seq))
+			break;
+		__atomic_fetch_sub(&e->refs, 1, __ATOMIC_RELEASE);
 	}
 
+	if (match_len)
+		*match_len = len;
+	*mnt_pntp = fs;
 	return 0;
 }
 
+static inline void fs_mount_put(struct fs_class *fs) {
+	__atomic_fetch_sub(&fs->mnt_entry->refs, 1, __ATOMIC_RELEASE);
+}
+
 /* File operations */
 int fs_open(struct fs_file *fp, const char *file_name, fs_mode_t flags) {
 	struct fs_class *fs;
 	int rc = -EINVAL;
 	bool truncate_file = false;
 
-	if ((file_name == NULL) || (strlen(file_name) <= 1) || (file_name[0] != '/')) {
+	if ((file_name == NULL) || (file_name[0] != '/') || (file_name[1] == '\0')) {
 		pr_err("invalid file name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, file_name, NULL);
+	if (((flags & FS_O_TRUNC) != 0) && ((flags & FS_O_WRITE) == 0)) {
+		/** Truncate not allowed when file is not opened for write */
+		pr_err("file should be opened for write to truncate!!");
+		return -EACCES;
+	}
+
+	rc = fs_mount_get(&fs, file_name, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
@@ -148,19 +302,15 @@ int fs_open(struct fs_file *fp, const char *file_name, fs_mode_t flags) {
 
 	if (((fs->flags & FS_MOUNT_FLAG_READ_ONLY) != 0) &&
 		(flags & FS_O_CREATE || flags & FS_O_WRITE)) {
-		return -EROFS;
+		rc = -EROFS;
+		goto _out;
 	}
 
 	if ((flags & FS_O_TRUNC) != 0) {
-		if ((flags & FS_O_WRITE) == 0) {
-			/** Truncate not allowed when file is not opened for write */
-			pr_err("file should be opened for write to truncate!!");
-			return -EACCES;
-		}
-
 		if (fs->fs_ops.truncate == NULL) {
 			pr_err("file truncation not supported!!");
-			return -ENOTSUP;
+			rc = -ENOTSUP;
+			goto _out;
 		}
 
 		truncate_file = true;
@@ -171,7 +321,7 @@ int fs_open(struct fs_file *fp, const char *file_name, fs_mode_t flags) {
 	if (rc < 0) {
 		pr_err("file open error (%d)", rc);
 		fp->vfs = NULL;
-		return rc;
+		goto _out;
 	}
 
 	/* Copy flags to fp for use with other fs_ API calls */
@@ -183,10 +333,11 @@ int fs_open(struct fs_file *fp, const char *file_name, fs_mode_t flags) {
 		if (rc < 0) {
 			pr_err("file truncation failed (%d)", rc);
 			fp->vfs = NULL;
-			return rc;
 		}
 	}
 
+_out:
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -226,6 +377,61 @@ ssize_t fs_write(struct fs_file *fp, const void *ptr, size_t size) {
 	return rc;
 }
 
+/* Transfer the segments one by one, stop at the first short transfer */
+static ssize_t fs_rw_segments(struct fs_file *fp, const struct fs_iovec *iov,
+	int iovcnt, bool write) {
+	ssize_t total = 0;
+
+	for (int i = 0; i < iovcnt; i++) {
+		ssize_t rc;
+
+		if (write)
+			rc = fp->vfs->fs_ops.write(fp, iov[i].iov_base, iov[i].iov_len);
+		else
+			rc = fp->vfs->fs_ops.read(fp, iov[i].iov_base, iov[i].iov_len);
+		if (rc < 0)
+			return (total > 0)? total: rc;
+
+		total += rc;
+		if ((size_t)rc < iov[i].iov_len)
+			break;
+	}
+
+	return total;
+}
+
+ssize_t fs_readv(struct fs_file *fp, const struct fs_iovec *iov, int iovcnt) {
+	ssize_t rc;
+
+	if (rte_unlikely(fp->vfs == NULL))
+		return -EBADF;
+
+	if ((iov == NULL && iovcnt > 0) || iovcnt < 0)
+		return -EINVAL;
+
+	rc = fs_rw_segments(fp, iov, iovcnt, false);
+	if (rc < 0)
+		pr_err("file readv error (%d)", (int)rc);
+
+	return rc;
+}
+
+ssize_t fs_writev(struct fs_file *fp, const struct fs_iovec *iov, int iovcnt) {
+	ssize_t rc;
+
+	if (rte_unlikely(fp->vfs == NULL))
+		return -EBADF;
+
+	if ((iov == NULL && iovcnt > 0) || iovcnt < 0)
+		return -EINVAL;
+
+	rc = fs_rw_segments(fp, iov, iovcnt, true);
+	if (rc < 0)
+		pr_err("file writev error (%d)", (int)rc);
+
+	return rc;
+}
+
 int fs_seek(struct fs_file *fp, off_t offset, int whence) {
 	if (rte_unlikely(fp->vfs == NULL))
 		return -EBADF;
@@ -275,7 +481,7 @@ int fs_opendir(struct fs_dir *dp, const char *abs_path) {
 	struct fs_class *fs;
 	int rc = -EINVAL;
 
-	if ((abs_path == NULL) || (strlen(abs_path) < 1) || (abs_path[0] != '/')) {
+	if ((abs_path == NULL) || (abs_path[0] != '/')) {
 		pr_err("invalid directory name!!");
 		return -EINVAL;
 	}
@@ -298,7 +504,7 @@ int fs_opendir(struct fs_dir *dp, const char *abs_path) {
 		return 0;
 	}
 
-	rc = fs_get_mnt_point(&fs, abs_path, NULL);
+	rc = fs_mount_get(&fs, abs_path, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
@@ -312,6 +518,7 @@ int fs_opendir(struct fs_dir *dp, const char *abs_path) {
 		pr_err("directory(%s) open error (%d)", abs_path, rc);
 	}
 
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -414,24 +621,28 @@ int fs_mkdir(const char *abs_path) {
 	struct fs_class *fs;
 	int rc = -EINVAL;
 
-	if ((abs_path == NULL) || (strlen(abs_path) <= 1) || (abs_path[0] != '/')) {
+	if ((abs_path == NULL) || (abs_path[0] != '/') || (abs_path[1] == '\0')) {
 		pr_err("invalid directory name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, abs_path, NULL);
+	rc = fs_mount_get(&fs, abs_path, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
 	}
 
-	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY)
-		return -EROFS;
+	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY) {
+		rc = -EROFS;
+		goto _out;
+	}
 
 	rc = fs->fs_ops.mkdir(fs, abs_path);
 	if (rc < 0)
 		pr_err("failed to create directory (%d)", rc);
 
+_out:
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -439,24 +650,28 @@ int fs_unlink(const char *abs_path) {
 	struct fs_class *fs;
 	int rc = -EINVAL;
 
-	if ((abs_path == NULL) || (strlen(abs_path) <= 1) || (abs_path[0] != '/')) {
+	if ((abs_path == NULL) || (abs_path[0] != '/') || (abs_path[1] == '\0')) {
 		pr_err("invalid file name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, abs_path, NULL);
+	rc = fs_mount_get(&fs, abs_path, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
 	}
 
-	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY)
-		return -EROFS;
+	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY) {
+		rc = -EROFS;
+		goto _out;
+	}
 
 	rc = fs->fs_ops.unlink(fs, abs_path);
 	if (rc < 0)
 		pr_err("failed to unlink path (%d)", rc);
 
+_out:
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -465,31 +680,37 @@ int fs_rename(const char *from, const char *to) {
 	size_t match_len;
 	int rc = -EINVAL;
 
-	if ((from == NULL) || (strlen(from) <= 1) || (from[0] != '/') || (to == NULL) ||
-		(strlen(to) <= 1) || (to[0] != '/')) {
+	if ((from == NULL) || (from[0] != '/') || (from[1] == '\0') || (to == NULL) ||
+		(to[0] != '/') || (to[1] == '\0')) {
 		pr_err("invalid file name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, from, &match_len);
+	rc = fs_mount_get(&fs, from, &match_len);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
 	}
 
-	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY)
-		return -EROFS;
+	if (fs->flags & FS_MOUNT_FLAG_READ_ONLY) {
+		rc = -EROFS;
+		goto _out;
+	}
 
 	/* Make sure both files are mounted on the same path */
-	if (strncmp(from, to, match_len) != 0) {
+	if (strncmp(from, to, match_len) != 0 ||
+		(to[match_len] != '/' && to[match_len] != '\0')) {
 		pr_err("mount point not same!!");
-		return -EINVAL;
+		rc = -EINVAL;
+		goto _out;
 	}
 
 	rc = fs->fs_ops.rename(fs, from, to);
 	if (rc < 0)
 		pr_err("failed to rename file or dir (%d)", rc);
 
+_out:
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -497,12 +718,12 @@ int fs_stat(const char *abs_path, struct fs_stat *stat) {
 	struct fs_class *fs;
 	int rc = -EINVAL;
 
-	if ((abs_path == NULL) || (strlen(abs_path) <= 1) || (abs_path[0] != '/')) {
+	if ((abs_path == NULL) || (abs_path[0] != '/') || (abs_path[1] == '\0')) {
 		pr_err("invalid file or dir name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, abs_path, NULL);
+	rc = fs_mount_get(&fs, abs_path, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
@@ -514,6 +735,8 @@ int fs_stat(const char *abs_path, struct fs_stat *stat) {
 	} else if (rc < 0) {
 		pr_err("failed get file or dir stat (%d)", rc);
 	}
+
+	fs_mount_put(fs);
 	return rc;
 }
 
@@ -521,12 +744,12 @@ int fs_statvfs(const char *abs_path, struct fs_statvfs *stat) {
 	struct fs_class *fs;
 	int rc;
 
-	if ((abs_path == NULL) || (strlen(abs_path) <= 1) || (abs_path[0] != '/')) {
+	if ((abs_path == NULL) || (abs_path[0] != '/') || (abs_path[1] == '\0')) {
 		pr_err("invalid file or dir name!!");
 		return -EINVAL;
 	}
 
-	rc = fs_get_mnt_point(&fs, abs_path, NULL);
+	rc = fs_mount_get(&fs, abs_path, NULL);
 	if (rc < 0) {
 		pr_err("mount point not found!!");
 		return rc;
@@ -537,13 +760,13 @@ int fs_statvfs(const char *abs_path, struct fs_statvfs *stat) {
 		pr_err("failed get file or dir stat (%d)", rc);
 	}
 
+	fs_mount_put(fs);
 	return rc;
 }
 
 int fs_mount(struct fs_class *fs) {
 	const struct fs_operations *fs_ops;
 	struct fs_class *itr;
-	struct rte_list *node;
 	int rc = -EINVAL;
 	size_t len = 0;
 
@@ -562,7 +785,7 @@ int fs_mount(struct fs_class *fs) {
 	}
 
 	len = strlen(fs->mnt_point);
-	if ((len <= 1) || (fs->mnt_point[0] != '/')) {
+	if ((len <= 1) || (fs->mnt_point[0] != '/') || (fs->mnt_point[len - 1] == '/')) {
 		pr_err("invalid mount point!!");
 		return -EINVAL;
 	}
@@ -578,34 +801,31 @@ int fs_mount(struct fs_class *fs) {
 	}
 
 	/* Check if mount point already exists */
-	rte_list_foreach(node, &fs_manager.mnt_list) {
-		itr = rte_container_of(node, struct fs_class, node);
-		/* continue if length does not match */
-		if (len != itr->mountp_len)
-			continue;
-
+	rte_list_foreach_entry(itr, &fs_manager.mnt_list, node) {
 		if (fs->fs_data == itr->fs_data) {
 			pr_err("file system already mounted!!");
 			rc = -EBUSY;
 			goto mount_err;
 		}
+	}
 
-		if (strncmp(fs->mnt_point, itr->mnt_point, len) == 0) {
-			pr_err("mount point already exists!!");
-			rc = -EBUSY;
-			goto mount_err;
-		}
+	fs->mountp_len = len;
+	rc = fs_mount_table_add(fs, len);
+	if (rc < 0) {
+		pr_err("mount point unavailable (%d)!!", rc);
+		goto mount_err;
 	}
 
 	fs_operations_copy(&fs->fs_ops, fs_ops);
 	rc = fs->fs_ops.mount(fs);
 	if (rc < 0) {
 		pr_err("fs mount error (%d)", rc);
+		fs->mnt_entry->len = 0;
 		goto mount_err;
 	}
 
-	/* Update mount point data and append it to the list */
-	fs->mountp_len = len;
+	/* Publish the mount point and append it to the list */
+	fs_mount_table_set(fs->mnt_entry, fs);
 	rte_list_add_tail(&fs->node, &fs_manager.mnt_list);
 	pr_dbg("fs mounted at %s", fs->mnt_point);
 
@@ -653,15 +873,18 @@ int fs_unmount(const char *mnt_point) {
 		goto unmount_err;
 	}
 
+	/* Wait for the operations in progress on the mount point */
+	fs_mount_table_drain(fs);
 	rc = fs->fs_ops.unmount(fs);
 	if (rc < 0) {
 		pr_err("fs unmount error (%d)", rc);
+		fs_mount_table_set(fs->mnt_entry, fs);
 		goto unmount_err;
 	}
 
-	/* clear file system interface */
-
-	/* remove mount node from the list */
+	/* remove mount point from the table and the list */
+	fs->mnt_entry->len = 0;
+	fs->mnt_entry = NULL;
 	rte_list_del(&fs->node);
 	pr_dbg("fs unmounted from %s", fs->mnt_point);
 
@@ -672,22 +895,24 @@ unmount_err:
 
 int fs_flush(const char *mnt_point) {
 	struct fs_class *fs;
+	size_t len;
+	int err;
 
 	if (mnt_point == NULL)
 		return -EINVAL;
 
-	tx_mutex_get(&fs_manager.mtx, TX_WAIT_FOREVER);
-	fs = fs_mounted_get(mnt_point);
-	tx_mutex_put(&fs_manager.mtx);
-
-	if (fs == NULL) {
-		pr_err("fs not mounted (fs == %p)", fs);
+	err = fs_mount_get(&fs, mnt_point, &len);
+	if (err < 0 || mnt_point[len] != '\0') {
+		if (err == 0)
+			fs_mount_put(fs);
+		pr_err("fs not mounted (%s)", mnt_point);
 		return -ENODATA;
 	}
-	
-	int err = fs->fs_ops.flush(fs);
+
+	err = fs->fs_ops.flush(fs);
 	if (err < 0)
-		pr_err("fs flush error(%s)\n", err);
+		pr_err("fs flush error(%d)\n", err);
+	fs_mount_put(fs);
 	return err;
 }
 
@@ -66,6 +66,16 @@ struct fs_dir {
 	struct fs_class *vfs;
 };
 
+/**
+ * @brief Buffer segment of a vectored read or write
+ */
+struct fs_iovec {
+	/** Start of the segment */
+	void *iov_base;
+	/** Length of the segment in bytes */
+	size_t iov_len;
+};
+
 /**
  * @brief File System interface structure
  */
@@ -313,6 +323,8 @@ enum {
  */
 #define FS_MOUNT_FLAG_USE_DISK_ACCESS (1 << 3)
 
+struct fs_mount_entry;
+
 /**
  * @brief File system mount info structure
  */
@@ -340,6 +352,9 @@ struct fs_class {
 	/** Pointer to file system specific data */
 	void *fs_data;
 
+	/** Mount table slot of the mount point */
+	struct fs_mount_entry *mnt_entry;
+
 	/** File system extension */
 	FS_PRIVATE_EXTENSION
 };
@@ -600,6 +615,44 @@ ssize_t fs_read(struct fs_file *fp, void *ptr, size_t size);
  */
 ssize_t fs_write(struct fs_file *fp, const void *ptr, size_t size);
 
+/**
+ * @brief Read file into a list of buffers
+ *
+ * Reads into the segments of @p iov in order, without a staging copy. This
+ * is a convenience over fs_read(): the segments are read one by one, so
+ * the file system sees one request per segment. The read stops at the end
+ * of file.
+ *
+ * @param fp Pointer to the file object
+ * @param iov Segment list
+ * @param iovcnt Number of segments
+ *
+ * @retval >=0 a number of bytes read, on success;
+ * @retval -EBADF when invoked on fp that represents unopened/closed file;
+ * @retval -EINVAL when the segment list is invalid;
+ * @retval <0 a negative errno code on error.
+ */
+ssize_t fs_readv(struct fs_file *fp, const struct fs_iovec *iov, int iovcnt);
+
+/**
+ * @brief Write a list of buffers to file
+ *
+ * Writes the segments of @p iov in order, without a staging copy. This is
+ * a convenience over fs_write(): the segments are written one by one, so
+ * the file system sees one request per segment. A value lower than the
+ * total length means the device may have no free space.
+ *
+ * @param fp Pointer to the file object
+ * @param iov Segment list
+ * @param iovcnt Number of segments
+ *
+ * @retval >=0 a number of bytes written, on success;
+ * @retval -EBADF when invoked on fp that represents unopened/closed file;
+ * @retval -EINVAL when the segment list is invalid;
+ * @retval <0 an other negative errno code on error.
+ */
+ssize_t fs_writev(struct fs_file *fp, const struct fs_iovec *iov, int iovcnt);
+
 /**
  * @brief Seek file
  *
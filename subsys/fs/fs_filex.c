@@ -36,13 +36,13 @@ extern UINT _fx_partition_offset_calculate(void  *partition_sector, UINT partiti
     ULONG *partition_start, ULONG *partition_size);
 
 static FX_FILE filex_fds[CONFIG_FS_FILEX_NUM_FILES];
-static struct object_pool filex_fds_pool;
+static struct lockfree_pool filex_fds_pool;
 
 static struct dir_private filex_dirs[CONFIG_FS_FILEX_NUM_DIRS];
-static struct object_pool filex_dirs_pool;
+static struct lockfree_pool filex_dirs_pool;
 
 static struct filex_instance filex_inst[CONFIG_FS_FILEX_NUM_INSTANCE];
-static struct object_pool filex_inst_pool;
+static struct lockfree_pool filex_inst_pool;
 
 static int filex_media_write(FX_MEDIA *media_ptr, ULONG sector_start, ULONG sector_num) {
     struct device *dev = (struct device *)media_ptr->fx_media_driver_info;
@@ -52,6 +52,7 @@ static int filex_media_write(FX_MEDIA *media_ptr, ULONG sector_start, ULONG sect
     req.blkno  = sector_start;
     req.blkcnt = sector_num;
     req.buffer = media_ptr->fx_media_driver_buffer;
+    req.nsegs  = 0;
     return blkdev_request(dev, &req);
 }
 
@@ -63,6 +64,7 @@ static int filex_media_read(FX_MEDIA *media_ptr, ULONG sector_start, ULONG secto
     req.blkno  = sector_start;
     req.blkcnt = sector_num;
     req.buffer = media_ptr->fx_media_driver_buffer;
+    req.nsegs  = 0;
     return blkdev_request(dev, &req);
 }
 
@@ -161,7 +163,7 @@ static int filex_fs_open(struct fs_file *fp, const char *file_name,
     if (!rw_flags && !created)
         return -EINVAL;
 
-    FX_FILE *fxp = object_allocate(&filex_fds_pool);
+    FX_FILE *fxp = lockfree_allocate(&filex_fds_pool);
     if (fxp) {
         UINT open_type;
 #ifndef FX_DISABLE_FAST_OPEN
@@ -180,7 +182,7 @@ static int filex_fs_open(struct fs_file *fp, const char *file_name,
         }
 
         pr_dbg("%s: open file(%s) failed(%d)\n", __func__, FX_PATH(file_name), err);
-        object_free(&filex_fds_pool, fxp);
+        lockfree_free(&filex_fds_pool, fxp);
         return _FX_ERR(err);
     }
 
@@ -193,7 +195,7 @@ static int filex_fs_close(struct fs_file *fp) {
 
     err = fx_file_close(fxp);
     if (err == FX_SUCCESS) {
-        object_free(&filex_fds_pool, fp->filep);
+        lockfree_free(&filex_fds_pool, fp->filep);
         return 0;
     }
     return _FX_ERR(err);
@@ -267,7 +269,7 @@ static int filex_fs_sync(struct fs_file *fp) {
 static int filex_fs_opendir(struct fs_dir *dp, const char *abs_path) {
     UINT err;
     
-     struct dir_private *dir = object_allocate(&filex_dirs_pool);
+     struct dir_private *dir = lockfree_allocate(&filex_dirs_pool);
     if (dir == NULL)
         return -ENOMEM;
 
@@ -280,7 +282,7 @@ static int filex_fs_opendir(struct fs_dir *dp, const char *abs_path) {
         return 0;
     }
 
-    object_free(&filex_dirs_pool, dir);
+    lockfree_free(&filex_dirs_pool, dir);
     return FX_ERR(err);
 }
 
@@ -319,7 +321,7 @@ static int filex_fs_closedir(struct fs_dir *dp) {
     if (dir) {
         struct fs_class *fs = dp->vfs;
         fx_directory_local_path_clear(fs->fs_data);
-        object_free(&filex_dirs_pool, dir);
+        lockfree_free(&filex_dirs_pool, dir);
         dp->dirp = NULL;
     }
 
@@ -339,7 +341,7 @@ static int filex_fs_mount(struct fs_class *fs) {
     if (blksz == 0 || blksz > 4096 || blksz > CONFIG_FS_FILEX_MEDIA_BUFFER_SIZE)
         return -EIO;
 
-    struct filex_instance *fx = object_allocate(&filex_inst_pool);
+    struct filex_instance *fx = lockfree_allocate(&filex_inst_pool);
     if (fx == NULL)
         return -ENOMEM;
 
@@ -347,7 +349,7 @@ static int filex_fs_mount(struct fs_class *fs) {
     err = fx_media_open(&fx->media, (CHAR *)dev->name, filex_fs_driver, 
         dev, fx->buffer, sizeof(fx->buffer));
     if (err) {
-        object_free(&filex_inst_pool, fx);
+        lockfree_free(&filex_inst_pool, fx);
         return _FX_ERR(err);
     }
 
@@ -364,7 +366,7 @@ static int filex_fs_unmount(struct fs_class *fs) {
 
     err = fx_media_close(fs->fs_data);
     if (err == FX_SUCCESS) {
-        object_free(&filex_inst_pool, fs->fs_data);
+        lockfree_free(&filex_inst_pool, fs->fs_data);
         fs->fs_data = NULL;
     }
     return FX_ERR(err);
@@ -467,7 +469,7 @@ static int filex_fs_mkfs(const char *devname, void *cfg, int flags) {
     if (blkcnt == 0 || blksz == 0 || blksz > 4096)
         return -EINVAL;
 
-    struct filex_instance *fx = object_allocate(&filex_inst_pool);
+    struct filex_instance *fx = lockfree_allocate(&filex_inst_pool);
     if (fx == NULL)
         return -ENOMEM;
 
@@ -522,7 +524,7 @@ static int filex_fs_mkfs(const char *devname, void *cfg, int flags) {
                     1,                            // Heads
                     1);               // Sectors per track
 #endif /* FX_ENABLE_EXFAT */
-    object_free(&filex_inst_pool, fx);
+    lockfree_free(&filex_inst_pool, fx);
 
     return FX_ERR(err);
 }
@@ -558,13 +560,13 @@ static const struct fs_operations fs_ops = {
 static int fs_filex_init(void) {
     fx_system_initialize();
 
-    object_pool_initialize(&filex_inst_pool, filex_inst, 
+    lockfree_pool_initialize(&filex_inst_pool, filex_inst, 
         sizeof(filex_inst), sizeof(filex_inst[0]));
 
-    object_pool_initialize(&filex_fds_pool, filex_fds, 
+    lockfree_pool_initialize(&filex_fds_pool, filex_fds, 
         sizeof(filex_fds), sizeof(filex_fds[0]));
 
-    object_pool_initialize(&filex_dirs_pool, filex_dirs, 
+    lockfree_pool_initialize(&filex_dirs_pool, filex_dirs, 
         sizeof(filex_dirs), sizeof(filex_dirs[0]));
 
     return fs_register(FS_EXFATFS, &fs_ops);
@@ -12,6 +12,7 @@
 #define pr_fmt(fmt) "[SDIO]: " fmt "\n"
 
 #include <errno.h>
+#include <string.h>
 #include <tx_api.h>
 #include <tx_timer.h>
 
@@ -21,12 +22,27 @@
 #include <drivers/blkdev.h>
 #include <drivers/blkdev.h>
 #include <drivers/sdio/mmcsd_core.h>
+#ifdef CONFIG_BLKQUEUE
+#include <drivers/blkqueue.h>
+#endif
 
 
 #ifndef CONFIG_SECTOR_SIZE
 #define CONFIG_SECTOR_SIZE  512
 #endif
 
+#ifndef CONFIG_MMCSD_QUEUE_STACK_SIZE
+#define CONFIG_MMCSD_QUEUE_STACK_SIZE 1024
+#endif
+
+#ifndef CONFIG_MMCSD_QUEUE_PRIO
+#define CONFIG_MMCSD_QUEUE_PRIO 10
+#endif
+
+#ifndef CONFIG_MMCSD_BOUNCE_BLOCKS
+#define CONFIG_MMCSD_BOUNCE_BLOCKS 32
+#endif
+
 struct mmcsd_blk_device {
     struct block_device blkdev;
 	struct mmcsd_card *card;
@@ -37,6 +53,24 @@ struct mmcsd_blk_device {
 
 #define raw_to_mmcsd_blk(raw) rte_container_of(raw, struct mmcsd_blk_device, blkdev)
 
+#ifdef CONFIG_BLKQUEUE
+/*
+ * The host runs one command at a time, so the queue has a single slot and
+ * only merges the contiguous requests queued behind the running one. A
+ * merged request goes through the bounce buffer, which bounds the merged
+ * size, and is sent as one multiple block command. Synchronous requests
+ * go straight to the card unless they overlap a queued or running request,
+ * blkdev_request() then queues them behind it.
+ */
+struct mmcsd_blk_queue {
+	struct block_device blkdev;
+	struct blkqueue queue;
+	struct blkqueue_rq slot;
+	ULONG stack[CONFIG_MMCSD_QUEUE_STACK_SIZE / sizeof(ULONG)];
+	ULONG bounce[CONFIG_MMCSD_BOUNCE_BLOCKS * CONFIG_SECTOR_SIZE / sizeof(ULONG)];
+};
+#endif
+
 static int __send_status(struct mmcsd_card *card, uint32_t *status, unsigned retries) {
 	int err;
 	struct mmcsd_cmd cmd;
@@ -228,10 +262,73 @@ int mmcsd_set_blksize(struct mmcsd_card *card) {
 
 static int mmcsd_blkdev_request(struct device *dev, struct blkdev_req *req) {
     struct mmcsd_card *card = dev_get_private(dev);
+	uint32_t max_blks = card->host->max_blk_count;
+	uint32_t blkno = req->blkno;
+	unsigned int i = 0;
+	int err;
+
+	if (req->op == BLKDEV_REQ_SYNC)
+		return 0;
+
+	if (req->nsegs == 0)
+		return mmcsd_req_blk(card, req->blkno, req->buffer, 
+			req->blkcnt, req->op);
+
+	/* Segments that follow each other in memory go in one transfer */
+	while (i < req->nsegs) {
+		uint8_t *buf = req->segs[i].buffer;
+		size_t blks = req->segs[i].blkcnt;
+
+		for (i++; i < req->nsegs; i++) {
+			if ((uint8_t *)req->segs[i].buffer != buf + blks * CONFIG_SECTOR_SIZE ||
+				blks + req->segs[i].blkcnt > max_blks)
+				break;
+			blks += req->segs[i].blkcnt;
+		}
+
+		err = mmcsd_req_blk(card, blkno, buf, blks, req->op);
+		if (err)
+			return err;
+		blkno += blks;
+	}
 
-	return mmcsd_req_blk(card, req->blkno, req->buffer, 
-        req->blkcnt, req->op);
+	return 0;
+}
+
+#ifdef CONFIG_BLKQUEUE
+/* The queue caps a merged request at the bounce buffer size */
+static int mmcsd_blkdev_queue_transfer(struct device *dev, struct blkdev_req *req) {
+	struct mmcsd_blk_queue *mq = (struct mmcsd_blk_queue *)dev;
+	struct mmcsd_card *card = dev_get_private(dev);
+	uint8_t *bounce = (uint8_t *)mq->bounce;
+	size_t offset = 0;
+	int err;
+
+	if (req->nsegs < 2 || req->blkcnt > CONFIG_MMCSD_BOUNCE_BLOCKS)
+		return mmcsd_blkdev_request(dev, req);
+
+	if (req->op == BLKDEV_REQ_WRITE) {
+		for (unsigned int i = 0; i < req->nsegs; i++) {
+			size_t len = req->segs[i].blkcnt * CONFIG_SECTOR_SIZE;
+
+			memcpy(bounce + offset, req->segs[i].buffer, len);
+			offset += len;
+		}
+	}
+
+	err = mmcsd_req_blk(card, req->blkno, bounce, req->blkcnt, req->op);
+	if (err || req->op != BLKDEV_REQ_READ)
+		return err;
+
+	for (unsigned int i = 0; i < req->nsegs; i++) {
+		size_t len = req->segs[i].blkcnt * CONFIG_SECTOR_SIZE;
+
+		memcpy(req->segs[i].buffer, bounce + offset, len);
+		offset += len;
+	}
+	return 0;
 }
+#endif
 
 static int mmcsd_blkdev_control(struct device *dev, unsigned int cmd, void *buf) {
     struct mmcsd_card *card = dev_get_private(dev);
@@ -257,6 +354,7 @@ int mmcsd_blkdev_probe(struct mmcsd_card *card) {
     static uint8_t devno;
     struct block_device *bdev;
     char name[] = {"mmcblk0"};
+    size_t size;
     char *p;
     int err;
 
@@ -266,18 +364,46 @@ int mmcsd_blkdev_probe(struct mmcsd_card *card) {
     if (card->blk_dev != NULL)
         return -EEXIST;
     
-    bdev = kzalloc(sizeof(*bdev) + sizeof(name) + 1, 0);
+#ifdef CONFIG_BLKQUEUE
+    size = sizeof(struct mmcsd_blk_queue);
+#else
+    size = sizeof(*bdev);
+#endif
+    bdev = kzalloc(size + sizeof(name) + 1, 0);
     if (bdev == NULL)
         return -ENOMEM;
     
     name[6] += devno;
-    p = (char *)(bdev + 1);
+    p = (char *)bdev + size;
     strcpy(p, name);
 
     bdev->private_data = card;
     bdev->name = p;
     bdev->request = mmcsd_blkdev_request;
     bdev->control = mmcsd_blkdev_control;
+    bdev->max_segs = UINT16_MAX;
+
+#ifdef CONFIG_BLKQUEUE
+    struct mmcsd_blk_queue *mq = (struct mmcsd_blk_queue *)bdev;
+    struct blkqueue_config cfg = {
+        .name = p,
+        .transfer = mmcsd_blkdev_queue_transfer,
+        .slots = &mq->slot,
+        .nr_slots = 1,
+        .max_blocks = rte_min(card->host->max_blk_count,
+            (uint32_t)CONFIG_MMCSD_BOUNCE_BLOCKS),
+        .stack = mq->stack,
+        .stack_size = sizeof(mq->stack),
+        .prio = CONFIG_MMCSD_QUEUE_PRIO
+    };
+
+    err = blkqueue_init(&mq->queue, (struct device *)bdev, &cfg);
+    if (err) {
+        kfree(bdev);
+        return err;
+    }
+#endif
+
     err = device_register((struct device *)bdev);
     if (!err) {
         pr_info("%s register device(%p) success\n", name, bdev);
@@ -286,6 +412,9 @@ int mmcsd_blkdev_probe(struct mmcsd_card *card) {
         return 0;
     }
     
+#ifdef CONFIG_BLKQUEUE
+    blkqueue_destroy(&mq->queue);
+#endif
     kfree(bdev);
     return err;
 }
@@ -295,6 +424,10 @@ int mmcsd_blkdev_remove(struct mmcsd_card *card) {
         return 0;
 
     device_unregister(card->blk_dev);
+#ifdef CONFIG_BLKQUEUE
+    blkqueue_destroy(&((struct mmcsd_blk_queue *)card->blk_dev)->queue);
+#endif
     kfree(card->blk_dev);
+    card->blk_dev = NULL;
     return 0;
 }